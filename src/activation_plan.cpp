@@ -0,0 +1,71 @@
+#include "activation_plan.h"
+#include "common.h"
+#include "data.h"
+#include "vertex.h"
+#include "dependency.h"
+
+#include <unordered_set>
+
+namespace gflow {
+
+std::unique_ptr<ActivationPlan> ActivationPlan::create(GraphData *const *targets, size_t target_num) {
+    std::unique_ptr<ActivationPlan> plan(new ActivationPlan());
+    std::unordered_set<GraphVertex *> visited;
+    // 用栈代替递归，很深的图也不会栈溢出
+    std::vector<GraphData *> stack(targets, targets + target_num);
+    while (!stack.empty()) {
+        GraphData *data = stack.back();
+        stack.pop_back();
+        GraphVertex *producer = data->get_producer();
+        if (producer == nullptr) {
+            continue;
+        }
+        plan->_datas.emplace_back(data);
+        if (!visited.insert(producer).second) {
+            continue;
+        }
+        plan->_vertexes.emplace_back(producer);
+        for (GraphDependency *dependency : producer->get_dependencys()) {
+            plan->_dependencys.emplace_back(dependency);
+            // 带条件的依赖先只激活条件，推测执行的同时激活数据
+            if (dependency->get_condition_data() != nullptr) {
+                stack.emplace_back(dependency->get_condition_data());
+                if (dependency->is_speculative()) {
+                    stack.emplace_back(dependency->get_depend_data());
+                }
+            } else {
+                stack.emplace_back(dependency->get_depend_data());
+            }
+        }
+    }
+    LOG(TRACE) << "ActivationPlan create target:" << (target_num > 0 ? targets[0]->get_name() : "")
+               << " target_num:" << target_num
+               << " vertex_size:" << plan->_vertexes.size()
+               << " dependency_size:" << plan->_dependencys.size();
+    return plan;
+}
+
+bool ActivationPlan::is_applicable() const {
+    for (GraphData *data : _datas) {
+        if (data->is_released()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void ActivationPlan::activate(ClosureContext *closure_context) const {
+    for (GraphVertex *vertex : _vertexes) {
+        vertex->set_closure_context(closure_context);
+        vertex->mark_activated();
+    }
+    // 和递归激活的顺序一致：先更新依赖计数(已经发布的外部输入会直接fire)，再加上vertex的等待计数
+    for (GraphDependency *dependency : _dependencys) {
+        dependency->activate_planned(closure_context);
+    }
+    for (GraphVertex *vertex : _vertexes) {
+        vertex->add_waiting_num(vertex->get_dependencys().size());
+    }
+}
+
+}  // namespace gflow
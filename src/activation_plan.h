@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+
+namespace gflow {
+
+class GraphData;
+class GraphVertex;
+class GraphDependency;
+class ClosureContext;
+
+// 目标data的激活计划：建图后计算一次需要激活的vertex和依赖，
+// run时按计划平铺地更新计数，不再递归遍历GraphData::activate -> GraphVertex::activate -> GraphDependency::activate。
+// 和递归激活一样，带条件的依赖只激活条件数据的上游(推测执行的依赖同时激活数据的上游)，条件成立后再动态激活数据的上游(execute_from_me)。
+// 计划假设图已经reset，计划中的data都还没有发布，否则需要回退到递归激活
+class ActivationPlan {
+   public:
+    // 禁止拷贝和移动
+    ActivationPlan(ActivationPlan &&) = delete;
+    ActivationPlan(const ActivationPlan &) = delete;
+    ActivationPlan &operator=(ActivationPlan &&) = delete;
+    ActivationPlan &operator=(const ActivationPlan &) = delete;
+
+    static std::unique_ptr<ActivationPlan> create(GraphData *target) {
+        return create(&target, 1);
+    }
+    // 多个目标的计划：激活所有目标上游的并集，共享的上游vertex只激活一次
+    static std::unique_ptr<ActivationPlan> create(GraphData *const *targets, size_t target_num);
+
+    // 计划中由vertex产出的data都还没有发布，计划才适用
+    bool is_applicable() const;
+    // 按计划激活，调用前需要确认is_applicable
+    void activate(ClosureContext *closure_context) const;
+    // 计划激活的vertex
+    const std::vector<GraphVertex *> &vertexes() const { return _vertexes; }
+
+   private:
+    ActivationPlan() = default;
+
+    std::vector<GraphVertex *> _vertexes;
+    std::vector<GraphDependency *> _dependencys;
+    // 计划中由vertex产出的data，包括目标data
+    std::vector<GraphData *> _datas;
+};
+
+}  // namespace gflow
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include <memory>
+#include <functional>
+#include <type_traits>
 #include <string_view>
 #include <iostream>
 #include "common.h"
@@ -39,6 +42,85 @@ public:
 template<class T>
 const ::std::string StaticTypeId<T>::TYPE_NAME = std::string(StaticTypeId<T>::name());
 
+inline void hash_combine(size_t* seed, size_t value) {
+    *seed ^= value + 0x9e3779b97f4a7c15ULL + (*seed << 6) + (*seed >> 2);
+}
+
+template<typename T, typename = void>
+struct IsStdHashable : std::false_type {};
+
+template<typename T>
+struct IsStdHashable<T, std::void_t<decltype(std::hash<T>()(std::declval<const T&>()))>> : std::true_type {};
+
+// 对象的hash，类型不支持hash时返回false。支持std::hash的类型和它们的vector
+template<typename T>
+bool any_hash_value(const T& value, size_t* seed) {
+    if constexpr (IsStdHashable<T>::value) {
+        hash_combine(seed, std::hash<T>()(value));
+        return true;
+    }
+    return false;
+}
+
+template<typename T>
+bool any_hash_value(const std::vector<T>& values, size_t* seed) {
+    hash_combine(seed, values.size());
+    for (const auto& value : values) {
+        if (!any_hash_value(value, seed)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template<typename T, typename = void>
+struct IsEqualityComparable : std::false_type {};
+
+template<typename T>
+struct IsEqualityComparable<T, std::void_t<decltype(std::declval<const T&>() == std::declval<const T&>())>>
+    : std::true_type {};
+
+// 对象是否相等，类型不支持比较时返回false。vector按元素比较
+template<typename T>
+bool any_equal_value(const T& left, const T& right) {
+    if constexpr (IsEqualityComparable<T>::value) {
+        return left == right;
+    }
+    return false;
+}
+
+template<typename T>
+bool any_equal_value(const std::vector<T>& left, const std::vector<T>& right) {
+    if (left.size() != right.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < left.size(); ++i) {
+        if (!any_equal_value(left[i], right[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// 对象占用内存的估计值
+template<typename T>
+size_t any_memory_size(const T&) {
+    return sizeof(T);
+}
+
+inline size_t any_memory_size(const std::string& value) {
+    return sizeof(std::string) + value.capacity();
+}
+
+template<typename T>
+size_t any_memory_size(const std::vector<T>& values) {
+    size_t size = sizeof(values) + (values.capacity() - values.size()) * sizeof(T);
+    for (const auto& value : values) {
+        size += any_memory_size(value);
+    }
+    return size;
+}
+
 class Any final {
 public:
     enum class Type {
@@ -150,6 +232,19 @@ public:
         rhs.set_pointer();    
     }
 
+    // 和other共享同一个对象，不拷贝(基本类型直接拷贝值)
+    Any& share(const Any& other) {
+        _empty = other._empty;
+        _type = other._type;
+        _instanse_type = other._instanse_type;
+        _holder = other._holder;
+        _pointer = other._pointer;
+        _primitive_value = other._primitive_value;
+        _const_ref = other._const_ref;
+        set_pointer();
+        return *this;
+    }
+
     void set_pointer() {
         if (_holder) {
             _pointer = _holder->get();
@@ -233,6 +328,93 @@ public:
         return !_empty;
     }
 
+    // 把对象的hash合并到seed，类型不支持hash或者是ref引用的对象时返回false
+    bool hash(size_t* seed) const {
+        if (_empty) {
+            hash_combine(seed, 0);
+            return true;
+        }
+        hash_combine(seed, std::hash<const void*>()(_instanse_type));
+        if (_holder) {
+            return _holder->hash(seed);
+        }
+        switch (_type) {
+            case Type::INT64:
+            case Type::UINT64:
+                hash_combine(seed, _primitive_value.uint64_v);
+                return true;
+            case Type::INT32:
+            case Type::UINT32:
+                hash_combine(seed, _primitive_value.uint32_v);
+                return true;
+            case Type::INT16:
+            case Type::UINT16:
+                hash_combine(seed, _primitive_value.uint16_v);
+                return true;
+            case Type::BOOLEAN:
+                hash_combine(seed, _primitive_value.bool_v);
+                return true;
+            case Type::DOUBLE:
+                hash_combine(seed, std::hash<double>()(_primitive_value.double_v));
+                return true;
+            case Type::FLOAT:
+                hash_combine(seed, std::hash<float>()(_primitive_value.float_v));
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    // 和other的值是否相等，类型不同、类型不支持比较或者是ref引用的对象时返回false
+    bool equals(const Any& other) const {
+        if (_empty || other._empty) {
+            return _empty && other._empty;
+        }
+        if (_instanse_type != other._instanse_type) {
+            return false;
+        }
+        if (_holder && other._holder) {
+            return _holder->equals(*other._holder);
+        }
+        if (_holder || other._holder) {
+            return false;
+        }
+        switch (_type) {
+            case Type::INT64:
+            case Type::UINT64:
+                return _primitive_value.uint64_v == other._primitive_value.uint64_v;
+            case Type::INT32:
+            case Type::UINT32:
+                return _primitive_value.uint32_v == other._primitive_value.uint32_v;
+            case Type::INT16:
+            case Type::UINT16:
+                return _primitive_value.uint16_v == other._primitive_value.uint16_v;
+            case Type::BOOLEAN:
+                return _primitive_value.bool_v == other._primitive_value.bool_v;
+            case Type::DOUBLE:
+                return _primitive_value.double_v == other._primitive_value.double_v;
+            case Type::FLOAT:
+                return _primitive_value.float_v == other._primitive_value.float_v;
+            default:
+                return false;
+        }
+    }
+
+    // 拷贝构造是否可用，不可拷贝的对象拷贝时会出错
+    bool is_copyable() const {
+        return !_holder || _holder->is_copyable();
+    }
+
+    // 是否独占持有的对象，基本类型、ref引用和share共享的对象返回false
+    bool is_unique_instance() const {
+        return _holder && _holder.use_count() == 1;
+    }
+
+    // 占用内存的估计值
+    size_t memory_size() const {
+        return sizeof(Any) + (_holder ? _holder->memory_size() : 0);
+    }
+
     Type type() const {
         return _type;
     }
@@ -247,6 +429,11 @@ private:
         virtual ~Holder() {};
         virtual void* get() = 0;
         virtual Holder* clone() const = 0;
+        virtual bool hash(size_t* seed) const = 0;
+        // 调用者保证other是同一类型
+        virtual bool equals(const Holder& other) const = 0;
+        virtual size_t memory_size() const = 0;
+        virtual bool is_copyable() const = 0;
     };
 
     template<class T>
@@ -269,6 +456,22 @@ private:
             return nullptr;
         }
 
+        virtual bool hash(size_t* seed) const {
+            return any_hash_value(*_p_ins, seed);
+        }
+
+        virtual bool equals(const Holder& other) const {
+            return any_equal_value(*_p_ins, *static_cast<const InstanceHolder&>(other)._p_ins);
+        }
+
+        virtual size_t memory_size() const {
+            return any_memory_size(*_p_ins);
+        }
+
+        virtual bool is_copyable() const {
+            return std::is_copy_constructible_v<T>;
+        }
+
     private:
         std::unique_ptr<T> _p_ins;
     };
@@ -5,9 +5,11 @@
 #include <mutex>
 #include <condition_variable>
 #include <future>
+#include <functional>
 
 #include "count_down_latch.h"
 #include "common.h"
+#include "concurrent/timer.h"
 
 // #include <bthread.h>
 // #include <bthread/mutex.h>
@@ -15,6 +17,17 @@
 
 namespace gflow {
 
+// 超过deadline时图的错误码
+constexpr static int32_t GraphTimeoutError = -110;
+
+class ClosureContext;
+
+// 当前线程上推迟的vertex结束计数，见ClosureContext::defer_finished
+struct DeferredFinish {
+    ClosureContext *closure_context = nullptr;
+    uint32_t num = 0;
+};
+
 class ClosureContext {
    public:
     // 禁止拷贝和移动
@@ -49,20 +62,116 @@ class ClosureContext {
     }
 
     void one_vertex_finished() {
+        DeferredFinish &deferred = deferred_finish();
+        if (deferred.closure_context == this) {
+            deferred.num++;
+            return;
+        }
         latch.count_down();
     }
 
+    // 融合的链在同一个任务里连续执行(见Graph::fuse_vertexes)，链上的vertex在当前线程结束时先累计，
+    // 链执行完由flush_finished一次扣减，整条链只加一次latch的锁
+    void defer_finished() {
+        DeferredFinish &deferred = deferred_finish();
+        if (deferred.closure_context != this) {
+            flush_deferred(deferred);
+            deferred.closure_context = this;
+        }
+    }
+
+    void flush_finished() {
+        DeferredFinish &deferred = deferred_finish();
+        if (deferred.closure_context == this) {
+            flush_deferred(deferred);
+        }
+    }
+
+    static DeferredFinish &deferred_finish() {
+        static thread_local DeferredFinish deferred;
+        return deferred;
+    }
+
     void add_wait_vertex_num(size_t num) {
         latch.add_count(num);
     }
 
+    // 设置图执行结束的回调，需要在图开始执行之前设置
+    void set_on_done(std::function<void(int32_t)> on_done) {
+        _on_done = std::move(on_done);
+        _has_on_done = static_cast<bool>(_on_done);
+    }
+
+    bool has_on_done() const {
+        return _has_on_done;
+    }
+
+    // 设置deadline，到期后以GraphTimeoutError结束，还没开始的vertex不再执行，
+    // 正在执行的processor可以通过cancelled()感知到并提前退出
+    void set_deadline(concurrent::TimerThread::Clock::time_point deadline) {
+        _timer_id = concurrent::TimerThread::instance().schedule(deadline, [this]() {
+            on_timeout();
+        });
+    }
+
+    // 执行中的任务数，vertex被调度时加1，执行结束后减1，之后不能再访问ClosureContext。
+    // 设置了on_done时，计数归零并且图已经结束，就在当前线程释放ClosureContext并回调on_done
+    void add_pending() {
+        _pending_num.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void done_pending() {
+        // 计数归零之后ClosureContext可能马上被析构，需要先读出来
+        bool has_on_done = _has_on_done;
+        if (_pending_num.fetch_sub(1, std::memory_order_acq_rel) != 1 || !has_on_done) {
+            return;
+        }
+        // 没有执行中的任务，但是还在等外部数据
+        if (!is_mark_finished() && latch.get_count() != 0) {
+            return;
+        }
+        bool expected = false;
+        if (!_is_done.compare_exchange_strong(expected, true, std::memory_order_acq_rel)) {
+            return;
+        }
+        auto on_done = std::move(_on_done);
+        int32_t error_code = _error_code;
+        LOG(TRACE) << this << " ClosureContext done error_code:" << error_code;
+        delete this;
+        on_done(error_code);
+    }
+
     ~ClosureContext() { 
 		LOG(TRACE) << this << " Destructor ~ClosureContext()"; 
+        if (_timer_id != concurrent::TimerThread::INVALID_TIMER_ID) {
+            concurrent::TimerThread::instance().cancel(_timer_id);
+        }
 		wait_finish();
+        // 出错或者超时后图提前结束，等还在执行的vertex退出
+        while (_pending_num.load(std::memory_order_acquire) != 0) {
+            std::this_thread::yield();
+        }
 	}
 
 	std::atomic<bool> is_delete{false};
    private:
+    static void flush_deferred(DeferredFinish &deferred) {
+        ClosureContext *closure_context = deferred.closure_context;
+        uint32_t num = deferred.num;
+        deferred = DeferredFinish();
+        if (closure_context != nullptr && num > 0) {
+            closure_context->latch.count_down(num);
+        }
+    }
+
+    void on_timeout() {
+        LOG(WARNING) << this << " ClosureContext timeout";
+        // 防止图已经没有执行中的任务时，没有人回调on_done
+        add_pending();
+        mark_finish(GraphTimeoutError);
+        done_pending();
+    }
+
 #ifdef USE_BTHREAD
     CountDownLatch<bthread::Mutex, bthread::ConditionVariable> latch;
 #else
@@ -70,6 +179,11 @@ class ClosureContext {
 #endif
     int32_t _error_code = 0;
     std::atomic<bool> _is_mark_finished{false};
+    std::function<void(int32_t)> _on_done;
+    bool _has_on_done = false;
+    std::atomic<int64_t> _pending_num{0};
+    concurrent::TimerThread::TimerId _timer_id = concurrent::TimerThread::INVALID_TIMER_ID;
+    std::atomic<bool> _is_done{false};
 };
 
 }  // namespace gflow
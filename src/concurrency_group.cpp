@@ -0,0 +1,74 @@
+#include "concurrency_group.h"
+#include "common.h"
+
+#include <iostream>
+
+namespace gflow {
+
+bool ConcurrencyGroup::acquire_or_enqueue(GraphVertex *vertex) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t running_num = _running_num.load(std::memory_order_relaxed);
+    if (running_num < _max_concurrency.load(std::memory_order_relaxed)) {
+        _running_num.store(running_num + 1, std::memory_order_relaxed);
+        return true;
+    }
+    _queue.emplace_back(vertex);
+    _queue_size.store(_queue.size(), std::memory_order_relaxed);
+    return false;
+}
+
+GraphVertex *ConcurrencyGroup::release() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t running_num = _running_num.load(std::memory_order_relaxed);
+    // 调小上限之后多出来的名额不再转给排队的vertex
+    if (_queue.empty() || running_num > _max_concurrency.load(std::memory_order_relaxed)) {
+        _running_num.store(running_num - 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    GraphVertex *vertex = _queue.front();
+    _queue.pop_front();
+    _queue_size.store(_queue.size(), std::memory_order_relaxed);
+    return vertex;
+}
+
+void ConcurrencyGroup::set_max_concurrency(size_t max_concurrency) {
+    if (max_concurrency == 0) {
+        LOG(WARNING) << "ConcurrencyGroup[" << _name << "] max_concurrency can't be 0, use 1";
+        max_concurrency = 1;
+    }
+    _max_concurrency.store(max_concurrency, std::memory_order_relaxed);
+}
+
+std::shared_ptr<ConcurrencyGroup> ConcurrencyGroupRegistry::get_or_create(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &group = _groups[name];
+    if (!group) {
+        group = std::make_shared<ConcurrencyGroup>(name);
+    }
+    return group;
+}
+
+std::shared_ptr<ConcurrencyGroup> ConcurrencyGroupRegistry::get(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iter = _groups.find(name);
+    if (iter == _groups.end()) {
+        return nullptr;
+    }
+    return iter->second;
+}
+
+void ConcurrencyGroupRegistry::set_max_concurrency(const std::string &name, size_t max_concurrency) {
+    get_or_create(name)->set_max_concurrency(max_concurrency);
+}
+
+std::vector<std::shared_ptr<ConcurrencyGroup>> ConcurrencyGroupRegistry::groups() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    std::vector<std::shared_ptr<ConcurrencyGroup>> groups;
+    groups.reserve(_groups.size());
+    for (auto &[name, group] : _groups) {
+        groups.emplace_back(group);
+    }
+    return groups;
+}
+
+}  // namespace gflow
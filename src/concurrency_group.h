@@ -0,0 +1,73 @@
+#pragma once
+
+#include <mutex>
+#include <deque>
+#include <atomic>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+namespace gflow {
+
+class GraphVertex;
+
+// 命名的并发组(bulkhead)：限制同一组processor同时占用的worker数，
+// 名额用完时ready的vertex在组内排队，不提交给executor，也不阻塞worker，有vertex执行完时再交给executor
+class ConcurrencyGroup {
+   public:
+    // 不限制并发
+    static constexpr size_t UNLIMITED = std::numeric_limits<size_t>::max();
+
+    explicit ConcurrencyGroup(std::string name, size_t max_concurrency = UNLIMITED)
+        : _name(std::move(name)), _max_concurrency(max_concurrency) {}
+    // 禁止拷贝和移动
+    ConcurrencyGroup(ConcurrencyGroup &&) = delete;
+    ConcurrencyGroup(const ConcurrencyGroup &) = delete;
+    ConcurrencyGroup &operator=(ConcurrencyGroup &&) = delete;
+    ConcurrencyGroup &operator=(const ConcurrencyGroup &) = delete;
+
+    // 占用一个名额返回true，名额用完时把vertex放入队列并返回false
+    bool acquire_or_enqueue(GraphVertex *vertex);
+    // 归还名额，队列不为空时名额直接转给队首的vertex并返回它，由调用方交给executor
+    GraphVertex *release();
+    // 调小时正在执行的不受影响，执行完之后才按新的上限调度
+    void set_max_concurrency(size_t max_concurrency);
+
+    const std::string &name() const { return _name; }
+    size_t max_concurrency() const { return _max_concurrency.load(std::memory_order_relaxed); }
+    size_t running_num() const { return _running_num.load(std::memory_order_relaxed); }
+    // 排队等待名额的vertex个数
+    size_t queue_size() const { return _queue_size.load(std::memory_order_relaxed); }
+
+   private:
+    std::string _name;
+    std::mutex _mutex;
+    std::deque<GraphVertex *> _queue;
+    std::atomic<size_t> _max_concurrency;
+    std::atomic<size_t> _running_num{0};
+    std::atomic<size_t> _queue_size{0};
+};
+
+// 全局的并发组，按名字创建，processor通过REGISTER_PROCESSOR_WITH_GROUP加入
+class ConcurrencyGroupRegistry {
+   public:
+    static ConcurrencyGroupRegistry &instance() {
+        static ConcurrencyGroupRegistry _instance;
+        return _instance;
+    }
+
+    // 不存在时创建一个不限制并发的组
+    std::shared_ptr<ConcurrencyGroup> get_or_create(const std::string &name);
+    // 不存在返回nullptr
+    std::shared_ptr<ConcurrencyGroup> get(const std::string &name);
+    void set_max_concurrency(const std::string &name, size_t max_concurrency);
+    std::vector<std::shared_ptr<ConcurrencyGroup>> groups();
+
+   private:
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::shared_ptr<ConcurrencyGroup>> _groups;
+};
+
+}  // namespace gflow
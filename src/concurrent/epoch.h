@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <limits>
+#include <cstdint>
+
+#include "concurrent_bounded_queue.h"
+
+namespace gflow::concurrent {
+
+// 基于epoch的回收(EBR)：读者在临界区内宣告自己看到的全局epoch，
+// 写者替换指针后推进epoch，所有活跃读者宣告的epoch都大于退役时的epoch，旧对象就不会再被新读者看到。
+// 临界区需要很短(只用来读指针并增加引用计数)，不能在里面阻塞
+//
+// 使用示例：
+// {
+//     EpochManager::Guard guard(manager);
+//     auto* p = ptr.load();       // p在guard析构前不会被回收
+// }
+// old = ptr.exchange(new_p);
+// uint64_t epoch = manager.advance();
+// ... manager.is_safe(epoch)时回收old ...
+class EpochManager {
+    struct Slot;
+
+public:
+    // 同时存在的线程数上限，退出的线程的槽位会被复用
+    static constexpr size_t MAX_THREAD_NUM = 256;
+    // 不在临界区
+    static constexpr uint64_t QUIESCENT = std::numeric_limits<uint64_t>::max();
+
+    class Guard {
+    public:
+        explicit Guard(EpochManager& manager) noexcept : _manager(manager), _slot(manager.enter()) {}
+        ~Guard() noexcept { _manager.exit(_slot); }
+
+        Guard(Guard const&) = delete;             // Copy construct
+        Guard(Guard&&) = delete;                  // Move construct
+        Guard& operator=(Guard const&) = delete;  // Copy assign
+        Guard& operator=(Guard &&) = delete;      // Move assign
+
+    private:
+        EpochManager& _manager;
+        Slot* _slot;
+    };
+
+    EpochManager() : _slots(new Slot[MAX_THREAD_NUM]) {}
+
+    EpochManager(EpochManager const&) = delete;             // Copy construct
+    EpochManager(EpochManager&&) = delete;                  // Move construct
+    EpochManager& operator=(EpochManager const&) = delete;  // Copy assign
+    EpochManager& operator=(EpochManager &&) = delete;      // Move assign
+
+    // 推进全局epoch，返回推进前的epoch，在这之前替换掉的对象以它作为退役epoch
+    uint64_t advance() noexcept {
+        return _epoch.fetch_add(1, std::memory_order_seq_cst);
+    }
+    // 退役epoch为retire_epoch的对象是否已经没有读者
+    bool is_safe(uint64_t retire_epoch) const noexcept {
+        if (_overflow_num.load(std::memory_order_seq_cst) > 0) {
+            return false;
+        }
+        return min_active_epoch() > retire_epoch;
+    }
+    // 所有在临界区的读者宣告的最小epoch，没有读者时返回QUIESCENT
+    uint64_t min_active_epoch() const noexcept {
+        uint64_t min_epoch = QUIESCENT;
+        for (size_t i = 0; i < MAX_THREAD_NUM; ++i) {
+            uint64_t epoch = _slots[i].epoch.load(std::memory_order_seq_cst);
+            if (epoch < min_epoch) {
+                min_epoch = epoch;
+            }
+        }
+        return min_epoch;
+    }
+    uint64_t epoch() const noexcept { return _epoch.load(std::memory_order_relaxed); }
+
+private:
+    // 每个线程独占一个槽位，只有嵌套的临界区会重复进入
+    struct alignas(CACHELINE_SIZE) Slot {
+        std::atomic<uint64_t> epoch{QUIESCENT};
+        uint32_t depth = 0;
+    };
+
+    // 槽位下标在所有EpochManager之间共用，线程退出时归还，之后创建的线程复用
+    class SlotIdxOwner {
+    public:
+        SlotIdxOwner() noexcept : idx(acquire()) {}
+        ~SlotIdxOwner() noexcept {
+            // 线程退出时不在临界区，槽位已经是QUIESCENT
+            if (idx < MAX_THREAD_NUM) {
+                used_slots()[idx].store(false, std::memory_order_release);
+            }
+        }
+
+        SlotIdxOwner(SlotIdxOwner const&) = delete;             // Copy construct
+        SlotIdxOwner(SlotIdxOwner&&) = delete;                  // Move construct
+        SlotIdxOwner& operator=(SlotIdxOwner const&) = delete;  // Copy assign
+        SlotIdxOwner& operator=(SlotIdxOwner &&) = delete;      // Move assign
+
+        // 同时存在的线程超过MAX_THREAD_NUM时为MAX_THREAD_NUM
+        const size_t idx;
+
+    private:
+        static size_t acquire() noexcept {
+            std::atomic<bool>* used = used_slots();
+            for (size_t i = 0; i < MAX_THREAD_NUM; ++i) {
+                if (!used[i].load(std::memory_order_relaxed)
+                        && !used[i].exchange(true, std::memory_order_acquire)) {
+                    return i;
+                }
+            }
+            return MAX_THREAD_NUM;
+        }
+        static std::atomic<bool>* used_slots() noexcept {
+            static std::atomic<bool> used[MAX_THREAD_NUM];
+            return used;
+        }
+    };
+
+    static size_t thread_slot_idx() noexcept {
+        thread_local SlotIdxOwner owner;
+        return owner.idx;
+    }
+
+    Slot* enter() noexcept {
+        size_t idx = thread_slot_idx();
+        if (idx >= MAX_THREAD_NUM) {
+            // 线程太多时没有槽位，退化成计数，有这样的读者时不回收
+            _overflow_num.fetch_add(1, std::memory_order_seq_cst);
+            return nullptr;
+        }
+        Slot* slot = &_slots[idx];
+        if (slot->depth++ == 0) {
+            slot->epoch.store(_epoch.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+        }
+        return slot;
+    }
+
+    void exit(Slot* slot) noexcept {
+        if (slot == nullptr) {
+            _overflow_num.fetch_sub(1, std::memory_order_seq_cst);
+            return;
+        }
+        if (--slot->depth == 0) {
+            slot->epoch.store(QUIESCENT, std::memory_order_release);
+        }
+    }
+
+    std::unique_ptr<Slot[]> _slots;
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> _epoch{0};
+    alignas(CACHELINE_SIZE) std::atomic<uint64_t> _overflow_num{0};
+};
+
+} // namespace
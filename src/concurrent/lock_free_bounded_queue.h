@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+#include <sys/types.h>
+
+#include "concurrent_bounded_queue.h"
+
+namespace gflow::concurrent {
+
+// 无锁有界队列(多生产者多消费者)，满了或者空了立即返回false，不阻塞。
+// 每个槽位带一个序号，生产者和消费者通过序号判断槽位是否可写/可读
+template <typename T>
+class LockFreeBoundedQueue {
+public:
+    explicit LockFreeBoundedQueue(size_t capacity) noexcept {
+        reset(capacity);
+    }
+
+    LockFreeBoundedQueue(LockFreeBoundedQueue const&) = delete;             // Copy construct
+    LockFreeBoundedQueue(LockFreeBoundedQueue&&) = delete;                  // Move construct
+    LockFreeBoundedQueue& operator=(LockFreeBoundedQueue const&) = delete;  // Copy assign
+    LockFreeBoundedQueue& operator=(LockFreeBoundedQueue &&) = delete;      // Move assign
+
+    // 清空并重新设置容量(向上取2的幂)，只能在没有并发读写的时候调用
+    void reset(size_t capacity) noexcept {
+        capacity = nextPowTwo(capacity < 2 ? size_t(2) : capacity);
+        if (capacity != _capacity) {
+            _cells.reset(new Cell[capacity]);
+            _capacity = capacity;
+        }
+        for (size_t i = 0; i < _capacity; ++i) {
+            _cells[i].sequence.store(i, std::memory_order_relaxed);
+            _cells[i].value = T();
+        }
+        _push_index.store(0, std::memory_order_relaxed);
+        _pop_index.store(0, std::memory_order_relaxed);
+    }
+
+    // 成功时value被移动到队列里，失败时value保持不变
+    bool try_push(T& value) noexcept {
+        size_t index = _push_index.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &_cells[index & (_capacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            ssize_t diff = (ssize_t)sequence - (ssize_t)index;
+            if (diff == 0) {
+                if (_push_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 满了
+                return false;
+            } else {
+                index = _push_index.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = std::move(value);
+        cell->sequence.store(index + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool try_pop(T& value) noexcept {
+        size_t index = _pop_index.load(std::memory_order_relaxed);
+        Cell* cell = nullptr;
+        while (true) {
+            cell = &_cells[index & (_capacity - 1)];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            ssize_t diff = (ssize_t)sequence - (ssize_t)(index + 1);
+            if (diff == 0) {
+                if (_pop_index.compare_exchange_weak(index, index + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // 空了
+                return false;
+            } else {
+                index = _pop_index.load(std::memory_order_relaxed);
+            }
+        }
+        value = std::move(cell->value);
+        cell->sequence.store(index + _capacity, std::memory_order_release);
+        return true;
+    }
+
+    // 并发读写时只是一个近似值
+    size_t size() const noexcept {
+        size_t push_index = _push_index.load(std::memory_order_relaxed);
+        size_t pop_index = _pop_index.load(std::memory_order_relaxed);
+        return push_index > pop_index ? push_index - pop_index : 0;
+    }
+    size_t capacity() const noexcept { return _capacity; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence{0};
+        T value;
+    };
+
+    std::unique_ptr<Cell[]> _cells;
+    size_t _capacity = 0;
+    alignas(CACHELINE_SIZE) std::atomic<size_t> _push_index{0};
+    alignas(CACHELINE_SIZE) std::atomic<size_t> _pop_index{0};
+};
+
+} // namespace
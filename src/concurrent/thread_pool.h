@@ -10,6 +10,7 @@
 #include <future>
 #include <functional>
 #include <stdexcept>
+#include <utility>
 
 #include "common.h"
 //#include "baidu/streaming_log.h"
@@ -77,9 +78,10 @@ inline ThreadPool::ThreadPool(uint32_t threads, uint32_t queue_size) noexcept
     }
 }
 
+// 把可调用对象和参数打包成无参任务，任务执行的结果通过返回的future获取
 template<class F, class... Args>
-inline auto ThreadPool::enqueue(F&& f, Args&&... args) noexcept
-        -> std::future<typename std::result_of_t<F(Args...)>>
+inline auto package_task(F&& f, Args&&... args)
+        -> std::pair<MoveOnlyFunction<void(void)>, std::future<typename std::result_of_t<F(Args...)>>>
 {
     using return_type = typename std::result_of_t<
             typename ::std::decay<F>::type(
@@ -115,8 +117,16 @@ inline auto ThreadPool::enqueue(F&& f, Args&&... args) noexcept
     // std::function<void(void)> function(std::move(binder));  // ERROR
     MoveOnlyFunction<void(void)> function(std::move(binder));
 
+    return {std::move(function), std::move(future)};
+}
+
+template<class F, class... Args>
+inline auto ThreadPool::enqueue(F&& f, Args&&... args) noexcept
+        -> std::future<typename std::result_of_t<F(Args...)>>
+{
+    auto [function, future] = package_task(std::forward<F>(f), std::forward<Args>(args)...);
     tasks.push(std::move(function));
-    return future;
+    return std::move(future);
 }
 
 inline int32_t ThreadPool::enqueue(MoveOnlyFunction<void(void)>&& function) noexcept 
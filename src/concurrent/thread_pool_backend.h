@@ -0,0 +1,15 @@
+#pragma once
+
+#include <stdint.h>
+
+namespace gflow::concurrent {
+
+// 异步任务使用的线程池后端
+enum class ThreadPoolBackend : int32_t {
+    // ThreadPool: 所有worker共享一个有界队列
+    SHARED_QUEUE = 0,
+    // WorkStealingThreadPool: 每个worker一个本地队列，空闲时从其他worker窃取
+    WORK_STEALING = 1,
+};
+
+} // namespace
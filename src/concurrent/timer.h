@@ -0,0 +1,133 @@
+#pragma once
+
+#include <map>
+#include <unordered_map>
+#include <thread>
+#include <mutex>
+#include <chrono>
+#include <condition_variable>
+
+#include "common.h"
+#include "move_only_function.h"
+
+namespace gflow::concurrent {
+
+// 所有定时任务共享的一个timer线程，任务在timer线程上执行，需要尽量轻量
+class TimerThread {
+public:
+    using Clock = std::chrono::steady_clock;
+    using TimerId = uint64_t;
+    // 无效的TimerId
+    static constexpr TimerId INVALID_TIMER_ID = 0;
+
+    TimerThread() : _thread([this] { run(); }) {}
+
+    TimerThread(TimerThread const&) = delete;             // Copy construct
+    TimerThread(TimerThread&&) = delete;                  // Move construct
+    TimerThread& operator=(TimerThread const&) = delete;  // Copy assign
+    TimerThread& operator=(TimerThread &&) = delete;      // Move assign
+
+    static TimerThread& instance() {
+        static TimerThread ins;
+        return ins;
+    }
+
+    ~TimerThread() noexcept {
+        stop_and_wait();
+    }
+
+    // 在deadline到达时执行task
+    TimerId schedule(Clock::time_point deadline, MoveOnlyFunction<void(void)>&& task) noexcept;
+    // 返回true表示取消成功，任务不会再执行；
+    // 返回false表示任务已经执行过，如果正在执行会等它执行完再返回(在任务自己里面取消除外)
+    bool cancel(TimerId timer_id) noexcept;
+    // 退出timer线程，还没到期的任务不再执行
+    void stop_and_wait() noexcept;
+
+private:
+    void run() noexcept;
+
+private:
+    std::mutex _mutex;
+    // 唤醒timer线程
+    std::condition_variable _cv;
+    // 等待正在执行的任务结束
+    std::condition_variable _done_cv;
+    std::map<std::pair<Clock::time_point, TimerId>, MoveOnlyFunction<void(void)>> _tasks;
+    std::unordered_map<TimerId, Clock::time_point> _deadlines;
+    TimerId _next_timer_id = INVALID_TIMER_ID + 1;
+    TimerId _running_timer_id = INVALID_TIMER_ID;
+    bool _is_stopped = false;
+    std::thread _thread;
+};
+
+inline TimerThread::TimerId TimerThread::schedule(Clock::time_point deadline,
+                MoveOnlyFunction<void(void)>&& task) noexcept {
+    std::lock_guard<std::mutex> lock(_mutex);
+    TimerId timer_id = _next_timer_id++;
+    bool is_earliest = _tasks.empty() || deadline < _tasks.begin()->first.first;
+    _tasks.emplace(std::make_pair(deadline, timer_id), std::move(task));
+    _deadlines.emplace(timer_id, deadline);
+    if (is_earliest) {
+        _cv.notify_one();
+    }
+    return timer_id;
+}
+
+inline bool TimerThread::cancel(TimerId timer_id) noexcept {
+    std::unique_lock<std::mutex> lock(_mutex);
+    auto iter = _deadlines.find(timer_id);
+    if (iter != _deadlines.end()) {
+        _tasks.erase(std::make_pair(iter->second, timer_id));
+        _deadlines.erase(iter);
+        return true;
+    }
+    if (std::this_thread::get_id() != _thread.get_id()) {
+        _done_cv.wait(lock, [this, timer_id] {
+            return _running_timer_id != timer_id;
+        });
+    }
+    return false;
+}
+
+inline void TimerThread::run() noexcept {
+    std::unique_lock<std::mutex> lock(_mutex);
+    while (!_is_stopped) {
+        if (_tasks.empty()) {
+            _cv.wait(lock);
+            continue;
+        }
+        auto iter = _tasks.begin();
+        if (iter->first.first > Clock::now()) {
+            _cv.wait_until(lock, iter->first.first);
+            continue;
+        }
+        TimerId timer_id = iter->first.second;
+        auto task = std::move(iter->second);
+        _tasks.erase(iter);
+        _deadlines.erase(timer_id);
+        _running_timer_id = timer_id;
+        lock.unlock();
+        task();
+        lock.lock();
+        _running_timer_id = INVALID_TIMER_ID;
+        _done_cv.notify_all();
+    }
+}
+
+inline void TimerThread::stop_and_wait() noexcept {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_is_stopped) {
+            return;
+        }
+        _is_stopped = true;
+        _cv.notify_one();
+    }
+    if (_thread.joinable()) {
+        _thread.join();
+    }
+    LOG(NOTICE) << "TimerThread stopped, left task_size:" << _tasks.size();
+}
+
+} // namespace
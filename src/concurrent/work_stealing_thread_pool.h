@@ -0,0 +1,368 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <future>
+
+#include "common.h"
+
+#include "thread_pool.h"
+#include "thread_pool_backend.h"
+
+namespace gflow::concurrent {
+
+// Chase-Lev工作窃取队列，容量固定(2的幂)
+// owner线程在bottom端push/pop(LIFO)，其他线程在top端steal(FIFO)
+template <typename T>
+class WorkStealingDeque {
+public:
+    explicit WorkStealingDeque(size_t capacity) noexcept;
+
+    // 禁止拷贝和移动
+    WorkStealingDeque(WorkStealingDeque const&) = delete;
+    WorkStealingDeque(WorkStealingDeque&&) = delete;
+    WorkStealingDeque& operator=(WorkStealingDeque const&) = delete;
+    WorkStealingDeque& operator=(WorkStealingDeque&&) = delete;
+
+    // 只能由owner线程调用，队列满了返回false
+    bool push(T* item) noexcept;
+    // 只能由owner线程调用，队列空返回nullptr
+    T* pop() noexcept;
+    // 任意线程调用，队列空或者和其他线程竞争失败返回nullptr
+    T* steal() noexcept;
+    size_t size() const noexcept;
+
+private:
+    alignas(64) std::atomic<int64_t> _top{0};
+    alignas(64) std::atomic<int64_t> _bottom{0};
+    int64_t _mask = 0;
+    std::unique_ptr<std::atomic<T*>[]> _buffer;
+};
+
+template <typename T>
+inline WorkStealingDeque<T>::WorkStealingDeque(size_t capacity) noexcept {
+    size_t real_capacity = 1;
+    while (real_capacity < capacity) {
+        real_capacity <<= 1;
+    }
+    _mask = real_capacity - 1;
+    _buffer.reset(new std::atomic<T*>[real_capacity]);
+}
+
+template <typename T>
+inline bool WorkStealingDeque<T>::push(T* item) noexcept {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_acquire);
+    if (bottom - top > _mask) {
+        return false;
+    }
+    _buffer[bottom & _mask].store(item, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    _bottom.store(bottom + 1, std::memory_order_relaxed);
+    return true;
+}
+
+template <typename T>
+inline T* WorkStealingDeque<T>::pop() noexcept {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed) - 1;
+    _bottom.store(bottom, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    if (top > bottom) {
+        // 队列为空
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    T* item = _buffer[bottom & _mask].load(std::memory_order_relaxed);
+    if (top == bottom) {
+        // 只剩最后一个元素，和steal竞争
+        if (!_top.compare_exchange_strong(top, top + 1,
+                    std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            item = nullptr;
+        }
+        _bottom.store(bottom + 1, std::memory_order_relaxed);
+    }
+    return item;
+}
+
+template <typename T>
+inline T* WorkStealingDeque<T>::steal() noexcept {
+    int64_t top = _top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int64_t bottom = _bottom.load(std::memory_order_acquire);
+    if (top >= bottom) {
+        return nullptr;
+    }
+    T* item = _buffer[top & _mask].load(std::memory_order_relaxed);
+    if (!_top.compare_exchange_strong(top, top + 1,
+                std::memory_order_seq_cst, std::memory_order_relaxed)) {
+        return nullptr;
+    }
+    return item;
+}
+
+template <typename T>
+inline size_t WorkStealingDeque<T>::size() const noexcept {
+    int64_t bottom = _bottom.load(std::memory_order_relaxed);
+    int64_t top = _top.load(std::memory_order_relaxed);
+    return bottom > top ? bottom - top : 0;
+}
+
+// 工作窃取线程池，接口和ThreadPool保持一致
+// worker线程里提交的任务进入自己的本地队列，后进先出，刚产生的数据还在cache里；
+// 外部线程提交的任务进入全局注入队列；
+// worker本地和全局队列都没有任务时，从其他worker的队列头部窃取最老的任务，
+// 仍然没有任务就休眠，直到有新任务提交。
+// 避免了所有worker争抢同一个队列的锁和cache line
+class WorkStealingThreadPool {
+private:
+    static constexpr size_t DEFAULT_WORKER_NUM = 30;
+    static constexpr size_t DEFAULT_DEQUE_CAPACITY = 4096;
+    // 休眠之前自旋重试的次数
+    static constexpr size_t SPIN_NUM = 8;
+public:
+    explicit WorkStealingThreadPool(uint32_t worker_num,
+                uint32_t deque_capacity = DEFAULT_DEQUE_CAPACITY) noexcept;
+
+    WorkStealingThreadPool(WorkStealingThreadPool const&) = delete;             // Copy construct
+    WorkStealingThreadPool(WorkStealingThreadPool&&) = delete;                  // Move construct
+    WorkStealingThreadPool& operator=(WorkStealingThreadPool const&) = delete;  // Copy assign
+    WorkStealingThreadPool& operator=(WorkStealingThreadPool &&) = delete;      // Move assign
+
+    static WorkStealingThreadPool& instance() {
+        static WorkStealingThreadPool ins(DEFAULT_WORKER_NUM, DEFAULT_DEQUE_CAPACITY);
+        return ins;
+    }
+
+    ~WorkStealingThreadPool() noexcept;
+
+    template<class F, class... Args>
+    auto enqueue(F&& f, Args&&... args) noexcept -> std::future<typename std::result_of_t<F(Args...)>>;
+    int32_t enqueue(MoveOnlyFunction<void(void)>&& function) noexcept;
+    size_t task_size() noexcept;
+    void stop_and_wait() noexcept;
+
+private:
+    using Task = MoveOnlyFunction<void(void)>;
+
+    struct Worker {
+        explicit Worker(size_t deque_capacity) noexcept : deque(deque_capacity) {}
+        WorkStealingDeque<Task> deque;
+        // 选择窃取对象的随机数状态，只有owner线程访问
+        uint32_t random_state = 0;
+    };
+
+    // 当前线程所属的线程池和worker下标
+    struct WorkerSlot {
+        const WorkStealingThreadPool* pool = nullptr;
+        size_t idx = 0;
+    };
+    static WorkerSlot& current_worker() noexcept {
+        static thread_local WorkerSlot slot;
+        return slot;
+    }
+
+    void worker_loop(size_t idx) noexcept;
+    Task* find_task(size_t idx) noexcept;
+    Task* pop_injection() noexcept;
+    void wake_one_if_idle() noexcept;
+
+private:
+    std::vector<std::unique_ptr<Worker>> _workers;
+    std::vector<std::thread> _threads;
+    // 外部线程提交任务的注入队列
+    std::mutex _injection_mutex;
+    std::deque<Task*> _injection;
+    std::atomic<size_t> _injection_size{0};
+    // 空闲worker的休眠和唤醒
+    std::mutex _park_mutex;
+    std::condition_variable _park_cv;
+    std::atomic<uint32_t> _idle_num{0};
+    std::atomic<uint64_t> _wake_epoch{0};
+    std::atomic<bool> _is_stopped{false};
+};
+
+inline WorkStealingThreadPool::WorkStealingThreadPool(uint32_t worker_num,
+                uint32_t deque_capacity) noexcept {
+    _workers.reserve(worker_num);
+    for (uint32_t i = 0; i < worker_num; ++i) {
+        _workers.emplace_back(std::make_unique<Worker>(deque_capacity));
+        _workers.back()->random_state = i * 2654435761u + 1;
+    }
+    // worker全部创建好之后再启动线程，窃取时会遍历_workers
+    for (uint32_t i = 0; i < worker_num; ++i) {
+        _threads.emplace_back([this, i] {
+            worker_loop(i);
+        });
+    }
+}
+
+inline void WorkStealingThreadPool::worker_loop(size_t idx) noexcept {
+    auto& slot = current_worker();
+    slot.pool = this;
+    slot.idx = idx;
+    while (true) {
+        Task* task = find_task(idx);
+        for (size_t i = 0; task == nullptr && i < SPIN_NUM; ++i) {
+            std::this_thread::yield();
+            task = find_task(idx);
+        }
+        if (task == nullptr) {
+            if (_is_stopped.load(std::memory_order_acquire)) {
+                // 优雅退出，所有任务处理完才退出
+                break;
+            }
+            // 先登记为空闲再检查一次队列，和wake_one_if_idle配合避免丢失唤醒
+            _idle_num.fetch_add(1, std::memory_order_seq_cst);
+            uint64_t epoch = _wake_epoch.load(std::memory_order_seq_cst);
+            task = find_task(idx);
+            if (task == nullptr) {
+                std::unique_lock<std::mutex> lock(_park_mutex);
+                _park_cv.wait(lock, [this, epoch] {
+                    return _wake_epoch.load(std::memory_order_relaxed) != epoch
+                            || _is_stopped.load(std::memory_order_relaxed);
+                });
+            }
+            _idle_num.fetch_sub(1, std::memory_order_relaxed);
+            if (task == nullptr) {
+                continue;
+            }
+        }
+        (*task)();
+        delete task;
+    }
+    slot.pool = nullptr;
+}
+
+inline WorkStealingThreadPool::Task* WorkStealingThreadPool::find_task(size_t idx) noexcept {
+    Worker& self = *_workers[idx];
+    Task* task = self.deque.pop();
+    if (task != nullptr) {
+        return task;
+    }
+    task = pop_injection();
+    if (task != nullptr) {
+        return task;
+    }
+    // 从随机位置开始轮询窃取，避免所有空闲worker盯着同一个victim
+    size_t worker_num = _workers.size();
+    self.random_state ^= self.random_state << 13;
+    self.random_state ^= self.random_state >> 17;
+    self.random_state ^= self.random_state << 5;
+    size_t start = self.random_state % worker_num;
+    for (size_t i = 0; i < worker_num; ++i) {
+        size_t victim = (start + i) % worker_num;
+        if (victim == idx) {
+            continue;
+        }
+        task = _workers[victim]->deque.steal();
+        if (task != nullptr) {
+            return task;
+        }
+    }
+    return nullptr;
+}
+
+inline WorkStealingThreadPool::Task* WorkStealingThreadPool::pop_injection() noexcept {
+    if (_injection_size.load(std::memory_order_seq_cst) == 0) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(_injection_mutex);
+    if (_injection.empty()) {
+        return nullptr;
+    }
+    Task* task = _injection.front();
+    _injection.pop_front();
+    _injection_size.fetch_sub(1, std::memory_order_relaxed);
+    return task;
+}
+
+inline void WorkStealingThreadPool::wake_one_if_idle() noexcept {
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (_idle_num.load(std::memory_order_seq_cst) == 0) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(_park_mutex);
+        _wake_epoch.fetch_add(1, std::memory_order_relaxed);
+    }
+    _park_cv.notify_one();
+}
+
+template<class F, class... Args>
+inline auto WorkStealingThreadPool::enqueue(F&& f, Args&&... args) noexcept
+        -> std::future<typename std::result_of_t<F(Args...)>>
+{
+    auto [function, future] = package_task(std::forward<F>(f), std::forward<Args>(args)...);
+    enqueue(std::move(function));
+    return std::move(future);
+}
+
+inline int32_t WorkStealingThreadPool::enqueue(MoveOnlyFunction<void(void)>&& function) noexcept
+{
+    auto* task = new Task(std::move(function));
+    auto& slot = current_worker();
+    if (slot.pool != this || !_workers[slot.idx]->deque.push(task)) {
+        // 外部线程提交，或者本地队列满了
+        std::lock_guard<std::mutex> lock(_injection_mutex);
+        _injection.emplace_back(task);
+        _injection_size.fetch_add(1, std::memory_order_seq_cst);
+    }
+    wake_one_if_idle();
+    return 0;
+}
+
+inline size_t WorkStealingThreadPool::task_size() noexcept
+{
+    size_t size = _injection_size.load(std::memory_order_relaxed);
+    for (auto& worker : _workers) {
+        size += worker->deque.size();
+    }
+    return size;
+}
+
+inline void WorkStealingThreadPool::stop_and_wait() noexcept
+{
+    bool expected = false;
+    if (!_is_stopped.compare_exchange_strong(expected,
+                                             true,
+                                             std::memory_order_seq_cst)) {
+        return;
+    }
+    LOG(NOTICE) << "WorkStealingThreadPool is going to stop...left task_size:" << task_size();
+    {
+        std::lock_guard<std::mutex> lock(_park_mutex);
+        _wake_epoch.fetch_add(1, std::memory_order_relaxed);
+    }
+    _park_cv.notify_all();
+    for (std::thread& thread : _threads) {
+        if (thread.joinable()) {
+            thread.join();
+        }
+    }
+    LOG(NOTICE) << "WorkStealingThreadPool stopped, left task_size:" << task_size();
+}
+
+inline WorkStealingThreadPool::~WorkStealingThreadPool() noexcept
+{
+    LOG(NOTICE) << "~WorkStealingThreadPool";
+    stop_and_wait();
+    // worker退出之后才提交的任务不会再执行
+    for (Task* task : _injection) {
+        delete task;
+    }
+    _injection.clear();
+}
+
+// 使用工作窃取线程池执行异步任务
+template <typename F, typename... Args>
+auto work_stealing_async(F &&f, Args &&...args) -> std::future<typename std::result_of_t<F(Args...)>> {
+    return WorkStealingThreadPool::instance().enqueue(std::forward<F>(f), std::forward<Args>(args)...);
+}
+
+} // namespace
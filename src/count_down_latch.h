@@ -11,6 +11,8 @@ public:
     CountDownLatch(uint32_t count);
     void await();
     void count_down();
+    // 一次扣减多个计数，不够时扣到0
+    void count_down(uint32_t num);
     uint32_t get_count(); 
     void add_count(uint32_t count);
     void notify_all();
@@ -19,6 +21,8 @@ private:
   C cv;
   M lock;
   uint32_t count = 0;
+  // notify_all之后不再等待计数归零
+  bool is_notified = false;
   
   CountDownLatch(const CountDownLatch& other) = delete;
   CountDownLatch& operator=(const CountDownLatch& opther) = delete;
@@ -9,10 +9,10 @@ inline CountDownLatch<M, C>::CountDownLatch(uint32_t count) {
 template<typename M, typename C>
 inline void CountDownLatch<M, C>::await() {
     std::unique_lock<M> lck(lock);
-    if (0 == count){
-        return;
+    // 用循环防止虚假唤醒
+    while (0 != count && !is_notified) {
+        cv.wait(lck);
     }
-    cv.wait(lck);  
 }
 
 template<typename M, typename C>
@@ -24,6 +24,7 @@ inline uint32_t CountDownLatch<M,C>::get_count() {
 template<typename M, typename C>
 inline void CountDownLatch<M,C>::notify_all() {
     std::unique_lock<M> lck(lock);
+    is_notified = true;
     cv.notify_all();
 }
 
@@ -45,4 +46,16 @@ inline void CountDownLatch<M, C>::count_down() {
     }
 }
 
+template<typename M, typename C>
+inline void CountDownLatch<M, C>::count_down(uint32_t num) {
+    std::unique_lock<M> lck(lock);
+    if (0 == count || 0 == num) {
+        return;
+    }
+    count = (num < count ? count - num : 0);
+    if (0 == count) {
+        cv.notify_all();
+    }
+}
+
 } // namespace
@@ -1,37 +1,143 @@
 #include "data.h"
 #include "vertex.h"
 #include "dependency.h"
+#include "graph_executor.h"
+#include "data_recycler.h"
+#include "closure.h"
 
 #include <future>
 
 namespace gflow {
 
 void GraphData::release() {
+    if (unlikely(_tls_batch_row >= 0 && _batch_size > 0)) {
+        _is_release_deferred = true;
+        return;
+    }
+    if (unlikely(is_in_attempt())) {
+        _attempts[_tls_attempt].is_released = true;
+        return;
+    }
     _is_released = true;
-    LOG(TRACE) << "GraphData[" << _name << "] is released."
-                << " downstream_num:" << _down_streams.size()
+    LOG(TRACE) << "GraphData[" << *_name << "] is released."
+                << " downstream_num:" << _consumer_num
                 << " is_condition:" << _is_condition;
+    // 惰性数据在生产者ready时已经通知过下游
+    if (_is_lazy_notified) {
+        return;
+    }
+    // 下游同时ready的vertex按优先级调度
+    ReadyBatch ready_batch;
     if (_is_condition) {
-        int condition_value = raw<int>();
-        for (GraphDependency *downstream : _down_streams) {
-            DCHECK(downstream);
-            downstream->fire_condition(condition_value);
+        // 批量执行时所有请求走同一个分支，各行不一致时结束执行。外部输入在Graph::run时检查
+        if (_batch_size > 0 && _producer != nullptr && !is_batch_condition_consistent()) {
+            LOG(WARNING) << "GraphData[" << *_name << "] condition differs between batch rows";
+            _producer->get_closure_context()->mark_finish(-1);
+            return;
+        }
+        int condition_value = _batch_size > 0 ? raw<int>(0) : raw<int>();
+        for (size_t i = 0; i < _consumer_num; ++i) {
+            DCHECK(_consumers[i]);
+            _consumers[i]->fire_condition(condition_value);
         }
     } else {
-        for (GraphDependency *downstream : _down_streams) {
-            DCHECK(downstream);
-            downstream->fire_data();
+        for (size_t i = 0; i < _consumer_num; ++i) {
+            DCHECK(_consumers[i]);
+            _consumers[i]->fire_data();
         }
     }
 }
 
+void GraphData::refire(GraphDependency *consumer) {
+    if (_is_condition) {
+        consumer->fire_condition(_batch_size > 0 ? raw<int>(0) : raw<int>());
+    } else {
+        consumer->fire_data();
+    }
+}
+
+void GraphData::notify_lazy() {
+    _is_lazy_notified = true;
+    ReadyBatch ready_batch;
+    for (size_t i = 0; i < _consumer_num; ++i) {
+        DCHECK(_consumers[i]);
+        _consumers[i]->fire_data();
+    }
+}
+
+bool GraphData::pull() {
+    if (!_is_lazy_notified) {
+        return true;
+    }
+    return _producer->pull();
+}
+
+void GraphData::consumer_finished() {
+    if (_recycler == nullptr
+            || _pending_consumer_num.fetch_sub(1, std::memory_order_acq_rel) != 1) {
+        return;
+    }
+    // 下游超时放弃时生产者可能还没有发布，这时不回收；批量执行的值按行保存，不回收
+    if (!_is_released || _batch_size > 0) {
+        return;
+    }
+    LOG(TRACE) << "GraphData[" << *_name << "] last consumer finished, recycle";
+    _is_recycled = true;
+    _recycler->recycle(_any_data);
+}
+
+void GraphData::reuse_value(const std::string *type) {
+    _recycler->reuse(type, _any_data);
+}
+
+Any& GraphData::any_data(size_t row) {
+    // 外部输入可以在批量执行的run之前按行设置
+    if (row >= _batch.size()) {
+        _batch.resize(row + 1);
+    }
+    return _batch[row];
+}
+
+void GraphData::set_batch_size(size_t batch_size) {
+    _batch_size = batch_size;
+    if (_batch.size() < batch_size) {
+        _batch.resize(batch_size);
+    }
+}
+
+bool GraphData::finish_attempt(int attempt, bool is_winner) {
+    Attempt &slot = _attempts[attempt];
+    bool is_released = slot.is_released;
+    slot.is_released = false;
+    if (is_winner && is_released) {
+        // 交换而不是拷贝，保留两边已经分配的空间
+        _any_data.swap(slot.value);
+    }
+    return is_released;
+}
+
+bool GraphData::is_batch_condition_consistent() {
+    for (size_t row = 1; row < _batch_size; ++row) {
+        if (raw<int>(row) != raw<int>(0)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool GraphData::take_deferred_release() {
+    bool is_release_deferred = _is_release_deferred;
+    _is_release_deferred = false;
+    return is_release_deferred;
+}
+
 void GraphData::activate(std::vector<GraphVertex *> &vertexs,
                          ClosureContext *closure_context) {
     if (_is_released) {
         return;
     }
     if (_producer) {
-        LOG(TRACE) << "GraphData[" << _name << "] activate start";
+        LOG(TRACE) << "GraphData[" << *_name << "] activate start";
         _producer->activate(vertexs, closure_context);
     } else {
         // LOG(TRACE) << "GraphData not activate without producer activate
@@ -41,6 +147,8 @@ void GraphData::activate(std::vector<GraphVertex *> &vertexs,
 
 void GraphData::add_downstream(GraphDependency *down_stream) {
     _down_streams.emplace_back(down_stream);
+    // 拓扑变化之后到下次build之前直接遍历_down_streams
+    set_consumers(_down_streams.data(), _down_streams.size());
 }
 
 void GraphData::set_producer(GraphVertex *producer) { _producer = producer; }
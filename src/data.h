@@ -2,12 +2,15 @@
 
 #include "any.h"
 #include <vector>
+#include <memory>
+#include <atomic>
 #include <iostream>
 //#include <base/logging.h>
 #include "check.h"
 
 namespace gflow {
 
+class DataRecycler;
 class GraphDependency;
 class GraphVertex;
 class ClosureContext;
@@ -36,15 +39,28 @@ private:
 
 class GraphData {
    public:
-    inline GraphData(std::string name) : _name(name){};
+    inline GraphData(std::string name) : _name(std::make_shared<const std::string>(std::move(name))){};
+    // 名字由GraphTemplate持有，多个图实例共享同一份
+    inline GraphData(std::shared_ptr<const std::string> name) : _name(std::move(name)){};
     // 禁止拷贝和移动
     inline GraphData(GraphData &&) = delete;
     inline GraphData(const GraphData &) = delete;
     inline GraphData &operator=(GraphData &&) = delete;
     inline GraphData &operator=(const GraphData &) = delete;
-    const std::string &get_name() { return _name; }
+    const std::string &get_name() { return *_name; }
+    const std::shared_ptr<const std::string>& get_shared_name() { return _name; }
+    GraphVertex *get_producer() { return _producer; }
     void add_downstream(GraphDependency *down_stream);
+    const std::vector<GraphDependency *>& get_down_streams() { return _down_streams; }
     void set_producer(GraphVertex *producer);
+    // 在图中的下标，见GraphTopology
+    uint32_t idx() const { return _idx; }
+    void set_idx(uint32_t idx) { _idx = idx; }
+    // 发布时遍历的下游，GraphTopology::build之后指向拓扑中的连续数组，否则指向_down_streams
+    void set_consumers(GraphDependency *const *consumers, size_t consumer_num) {
+        _consumers = consumers;
+        _consumer_num = consumer_num;
+    }
 
     template <typename T>
     void set_value(T&& value);
@@ -71,17 +87,90 @@ class GraphData {
         return _any_data;
     }
 
+    // 批量执行(Graph::set_batch_size之后run)时每个请求一行，按行读写
+    template <typename T>
+    void set_value(size_t row, T&& value);
+
+    template <typename T>
+    GraphData *make(size_t row);
+
+    template <typename T>
+    T &raw(size_t row);
+
+    template <typename T>
+    T* pointer(size_t row);
+
+    Any& any_data(size_t row);
+    size_t batch_size() { return _batch_size; }
+    // 由Graph在切换批量大小时设置，0表示普通执行
+    void set_batch_size(size_t batch_size);
+    // 逐行执行期间当前线程处理的行，不带行号的读写都作用在这一行上，发布推迟到所有行执行完
+    static void set_batch_row(int64_t row) { _tls_batch_row = row; }
+    // 返回逐行执行期间是否推迟过发布，并清除标记
+    bool take_deferred_release();
+    // 批量执行时条件data所有行的值是否一致，同一批请求只能走同一个分支
+    bool is_batch_condition_consistent();
+
+    // 对冲执行(见GraphVertex::hedge)时producer的每次执行写到独立的槽位，
+    // 执行期间的发布只做标记，由胜出的执行结束后统一发布
+    void set_attempt_num(size_t attempt_num) { _attempts.resize(attempt_num); }
+    // 当前线程接下来以第attempt次执行的身份读写producer产出的data，producer为nullptr时恢复
+    static void set_attempt(const GraphVertex *producer, int attempt) {
+        _tls_attempt_producer = producer;
+        _tls_attempt = attempt;
+    }
+    // 第attempt次执行结束，胜出时把它的结果换到当前值上。返回这次执行是否发布过，胜出时需要调用release
+    bool finish_attempt(int attempt, bool is_winner);
+
     // template <typename T>
     // const T* pointer();      
 
     void release();
     bool is_released() { return _is_released; }
+    // 增量执行时数据保留上一轮的值，给被重置的下游依赖重新通知一次发布
+    void refire(GraphDependency *consumer);
+    // 惰性vertex ready时调用：先通知下游依赖数据可用，真正的值在第一次pull时产出，之后的release不再通知下游。
+    // 条件数据需要值才能通知下游，不能推迟
+    void notify_lazy();
+    // 读取惰性数据之前调用，还没有产出时在当前线程执行生产者。返回数据是否可用，非惰性数据总是返回true
+    bool pull();
+    // 已经通知了下游，但生产者还没有被读取执行
+    bool is_lazy_pending() { return _is_lazy_notified && !_is_released; }
     void activate(std::vector<GraphVertex *> &vertexs,
                   ClosureContext *closure_context);
     bool is_condition() { return _is_condition; }
+    // 下游依赖超时放弃了这个数据
+    void add_abandoned() { _abandoned_num.fetch_add(1, std::memory_order_relaxed); }
+    // 所有下游都已经放弃，数据产出了也不会再被使用
+    bool is_abandoned() {
+        return _consumer_num != 0
+                && _abandoned_num.load(std::memory_order_relaxed) == (int32_t)_consumer_num;
+    }
     void set_is_condition(bool value) { _is_condition = value; }
+
+    // 中间数据的提前回收(见Graph::set_data_recycle)：build时设置回收池和使用者数(下游依赖数加上生产者)，
+    // recycler为nullptr表示不回收
+    void set_recycle(DataRecycler *recycler, int32_t consumer_num) {
+        _recycler = recycler;
+        _recycle_consumer_num = consumer_num;
+        _pending_consumer_num.store(consumer_num, std::memory_order_relaxed);
+    }
+    // 本轮执行中增加一个使用者，在下次reset之前不会被回收，例如run的目标
+    void retain() { _pending_consumer_num.fetch_add(1, std::memory_order_relaxed); }
+    // 增量执行时保留的data，只等待被重置的下游
+    void set_pending_consumer_num(int32_t num) { _pending_consumer_num.store(num, std::memory_order_relaxed); }
+    // 一个使用者(下游依赖的vertex或生产者)执行完，最后一个执行完时回收已经发布的值
+    void consumer_finished();
+    // 本轮的值已经被回收
+    bool is_recycled() { return _is_recycled; }
+
     void reset() {
         _is_released = false;
+        _is_release_deferred = false;
+        _is_lazy_notified = false;
+        _is_recycled = false;
+        _abandoned_num.store(0, std::memory_order_relaxed);
+        _pending_consumer_num.store(_recycle_consumer_num, std::memory_order_relaxed);
         // 保留之前分配的空间，不要重置any容器的值，否则会访问未分配存储的数据
         //_any_data.clear();
     }
@@ -91,12 +180,78 @@ class GraphData {
     }
 
    private:
+    // 当前读写的值，逐行执行时是当前行
+    Any& current() {
+        if (unlikely(_tls_batch_row >= 0 && _batch_size > 0)) {
+            return _batch[_tls_batch_row];
+        }
+        if (unlikely(is_in_attempt())) {
+            return _attempts[_tls_attempt].value;
+        }
+        return _any_data;
+    }
+    bool is_in_attempt() const {
+        return _tls_attempt_producer != nullptr && _tls_attempt_producer == _producer;
+    }
+
+    template <typename T>
+    static void make_value(Any& any);
+    void reuse_value(const std::string *type);
+
+    // 发布和读写时访问的字段放在前面，尽量落在同一条cache line上
     Any _any_data;
+    GraphDependency *const *_consumers = nullptr;
+    size_t _consumer_num = 0;
     GraphVertex *_producer = nullptr;
-    std::vector<GraphDependency *> _down_streams;
+    size_t _batch_size = 0;
     bool _is_released = false;
     bool _is_condition = false;
-    std::string _name;
+    bool _is_release_deferred = false;
+    bool _is_lazy_notified = false;
+    uint32_t _idx = 0;
+    std::atomic<int32_t> _abandoned_num{0};
+    DataRecycler *_recycler = nullptr;
+    int32_t _recycle_consumer_num = 0;
+    std::atomic<int32_t> _pending_consumer_num{0};
+    bool _is_recycled = false;
+
+    inline static thread_local int64_t _tls_batch_row = -1;
+    inline static thread_local const GraphVertex *_tls_attempt_producer = nullptr;
+    inline static thread_local int _tls_attempt = -1;
+
+    // 保留之前分配的行，和_any_data一样不随reset清空
+    std::vector<Any> _batch;
+    struct Attempt {
+        Any value;
+        bool is_released = false;
+    };
+    std::vector<Attempt> _attempts;
+    std::vector<GraphDependency *> _down_streams;
+    std::shared_ptr<const std::string> _name;
+};
+
+// LAZY_DEPEND_VAR的句柄，第一次访问时才让惰性数据的生产者执行
+template <typename T>
+class LazyData {
+   public:
+    LazyData() = default;
+    explicit LazyData(GraphData *data) : _data(data) {}
+
+    // 生产者执行失败时返回nullptr
+    T *get() {
+        if (_value == nullptr && _data != nullptr && _data->pull()) {
+            _value = _data->pointer<T>();
+        }
+        return _value;
+    }
+    T &operator*() { return *get(); }
+    T *operator->() { return get(); }
+    // 是否已经产出，不会触发执行
+    bool is_ready() { return _data != nullptr && _data->is_released(); }
+
+   private:
+    GraphData *_data = nullptr;
+    T *_value = nullptr;
 };
 
 }  // namespace
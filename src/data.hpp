@@ -1,15 +1,25 @@
 namespace gflow {
 
 template <typename T>
-GraphData *GraphData::make() {
-    //LOG(TRACE) << "GraphData make " << _name;
-    if (unlikely(_any_data.get<T>() == nullptr)) {
+void GraphData::make_value(Any& any) {
+    if (unlikely(any.get<T>() == nullptr)) {
         if constexpr (std::is_copy_constructible_v<T>) {
-            _any_data = Any(T());
+            any = Any(T());
         } else {
-            _any_data = Any(std::make_unique<T>());
+            any = Any(std::make_unique<T>());
         }
     }
+}
+
+template <typename T>
+GraphData *GraphData::make() {
+    //LOG(TRACE) << "GraphData make " << _name;
+    Any& any = current();
+    // 上一轮的值被回收了，先从回收池里取同类型的对象
+    if (unlikely(_recycler != nullptr) && &any == &_any_data && any.get<T>() == nullptr) {
+        reuse_value(&StaticTypeId<T>::TYPE_NAME);
+    }
+    make_value<T>(any);
     return this;
 }
 
@@ -22,16 +32,37 @@ T &GraphData::raw() {
 
 template <typename T>
 T GraphData::as() {
-    return _any_data.as<T>();
+    return current().as<T>();
 }
 
 template <typename T>
 T* GraphData::pointer() {
-    T* p = _any_data.get<T>();
+    T* p = current().get<T>();
     //LOG(TRACE) << "pointer:" << _name << " ptr:" << p;
     return p;
 }
 
+template <typename T>
+void GraphData::set_value(size_t row, T&& value) {
+    any_data(row) = Any(std::forward<T>(value));
+}
+
+template <typename T>
+GraphData *GraphData::make(size_t row) {
+    make_value<T>(any_data(row));
+    return this;
+}
+
+template <typename T>
+T &GraphData::raw(size_t row) {
+    return *pointer<T>(row);
+}
+
+template <typename T>
+T* GraphData::pointer(size_t row) {
+    return any_data(row).get<T>();
+}
+
 // template <typename T>
 // const T* GraphData::pointer() {
 //     return _any_data.get<T>();
@@ -41,7 +72,7 @@ template <typename T>
 void GraphData::set_value(T&& value) {
     // LOG(TRACE) << "raw:" << _name;
     //_any_data = std::move(value);
-    _any_data = Any(std::forward<T>(value));
+    current() = Any(std::forward<T>(value));
 }
 
 template <typename T>
@@ -0,0 +1,56 @@
+#include "data_recycler.h"
+
+namespace gflow {
+
+void DataRecycler::recycle(Any &any) {
+    if (_max_pooled == 0 || !any.is_unique_instance()) {
+        any.clear();
+        return;
+    }
+    Any value;
+    value.swap(any);
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto &values = _pool[&value.instance_type()];
+        if (values.size() < _max_pooled) {
+            values.emplace_back(std::move(value));
+            return;
+        }
+    }
+    // 超出上限的对象在锁外析构
+}
+
+bool DataRecycler::reuse(const std::string *type, Any &any) {
+    Any value;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _pool.find(type);
+        if (iter == _pool.end() || iter->second.empty()) {
+            return false;
+        }
+        value.swap(iter->second.back());
+        iter->second.pop_back();
+    }
+    any.swap(value);
+    return true;
+}
+
+size_t DataRecycler::size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t size = 0;
+    for (const auto &kv : _pool) {
+        size += kv.second.size();
+    }
+    return size;
+}
+
+void DataRecycler::clear() {
+    // 在锁外析构
+    std::unordered_map<const std::string *, std::vector<Any>> pool;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        pool.swap(_pool);
+    }
+}
+
+}  // namespace gflow
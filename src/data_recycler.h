@@ -0,0 +1,42 @@
+#pragma once
+
+#include <mutex>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "any.h"
+
+namespace gflow {
+
+// 图内中间数据的空闲池：最后一个下游执行完之后，中间data的对象按类型放回池子，
+// 之后同类型的data产出时(GraphData::make)直接复用，请求执行期间常驻的只有还在使用的中间数据。
+// 复用的对象保留之前的内容(容器的容量等)，和reset之后保留的值一样需要由processor覆盖。
+// 每种类型最多保留max_pooled个，超出的和不能复用的(基本类型、和其他data共享的对象)直接释放
+class DataRecycler {
+   public:
+    explicit DataRecycler(size_t max_pooled) : _max_pooled(max_pooled) {}
+    // 禁止拷贝和移动
+    DataRecycler(DataRecycler &&) = delete;
+    DataRecycler(const DataRecycler &) = delete;
+    DataRecycler &operator=(DataRecycler &&) = delete;
+    DataRecycler &operator=(const DataRecycler &) = delete;
+
+    // 回收any持有的对象，any被清空
+    void recycle(Any &any);
+    // 从池子里取出一个类型为type的对象放到any上，没有时返回false
+    bool reuse(const std::string *type, Any &any);
+
+    size_t max_pooled() const { return _max_pooled; }
+    // 池子中的对象总数
+    size_t size();
+    void clear();
+
+   private:
+    size_t _max_pooled = 0;
+    std::mutex _mutex;
+    // key是StaticTypeId<T>::TYPE_NAME的地址
+    std::unordered_map<const std::string *, std::vector<Any>> _pool;
+};
+
+}  // namespace gflow
@@ -2,21 +2,95 @@
 #include "graph.h"
 #include "vertex.h"
 #include "expr_processor.h"
+#include "closure.h"
+#include "concurrent/timer.h"
+
+#include <algorithm>
 
 namespace gflow {
 
 GraphDependency::GraphDependency(std::string name, Graph *graph,
                                  GraphVertex *vertex)
-    : _name(name),
-      _depend_data(graph->create_data(name)),
-      _graph(graph),
-      _attached_vertex(vertex) {
+    : GraphDependency(graph->create_data(name), graph, vertex) {
+}
+
+GraphDependency::GraphDependency(GraphData *data, Graph *graph,
+                                 GraphVertex *vertex)
+    : _depend_data(data),
+      _attached_vertex(vertex),
+      _graph(graph) {
     _depend_data->add_downstream(this);
 }
 
+const std::string& GraphDependency::get_name() {
+    return _depend_data->get_name();
+}
+
+void GraphDependency::set_condition_data(GraphData *condition_data) {
+    _condition_data = condition_data;
+    _condition_data->add_downstream(this);
+    _condition_data->set_is_condition(true);
+}
+
 void GraphDependency::reset() {
     _condition_ready = false;
+    _is_condition_false.store(false, std::memory_order_release);
     _expect_num.store(0, std::memory_order_release);
+    _timeout_state.store(TIMEOUT_STATE_WAITING, std::memory_order_release);
+    _timer_id.store(concurrent::TimerThread::INVALID_TIMER_ID, std::memory_order_release);
+    _timer_closure_context = nullptr;
+}
+
+GraphDependency *GraphDependency::timeout(int64_t timeout_ms) {
+    auto &optional_dependencys = _attached_vertex->get_optional_dependencys();
+    if (std::find(optional_dependencys.begin(), optional_dependencys.end(), this) == optional_dependencys.end()) {
+        LOG(WARNING) << "GraphDependency[" << get_name() << "] timeout only works on optional_depend";
+        return this;
+    }
+    _timeout_ms = timeout_ms;
+    return this;
+}
+
+void GraphDependency::start_timer(ClosureContext *closure_context) {
+    // 定时器没有结束之前ClosureContext不能释放
+    closure_context->add_pending();
+    _timer_closure_context = closure_context;
+    auto deadline = concurrent::TimerThread::Clock::now() + std::chrono::milliseconds(_timeout_ms);
+    _timer_id.store(concurrent::TimerThread::instance().schedule(deadline, [this, closure_context]() {
+        on_timeout(closure_context);
+    }), std::memory_order_release);
+}
+
+void GraphDependency::cancel_timer() {
+    uint64_t timer_id = _timer_id.load(std::memory_order_acquire);
+    if (timer_id == concurrent::TimerThread::INVALID_TIMER_ID) {
+        return;
+    }
+    // 取消失败说明定时器已经执行，由on_timeout负责done_pending
+    if (concurrent::TimerThread::instance().cancel(timer_id)) {
+        _timer_closure_context->done_pending();
+    }
+}
+
+void GraphDependency::on_timeout(ClosureContext *closure_context) {
+    int32_t expected = TIMEOUT_STATE_WAITING;
+    if (_timeout_state.compare_exchange_strong(expected, TIMEOUT_STATE_TIMEOUT,
+                                               std::memory_order_acq_rel)) {
+        LOG(NOTICE) << "GraphDependency[" << get_name() << "] timeout after " << _timeout_ms
+                    << "ms, attached_vertex[" << _attached_vertex->name() << "] continue without it";
+        _depend_data->add_abandoned();
+        fire_attached_vertex();
+    }
+    closure_context->done_pending();
+}
+
+GraphDependency *GraphDependency::speculate() {
+    if (_condition_data == nullptr) {
+        LOG(WARNING) << "GraphDependency[" << get_name() << "] speculate only works with when(condition)";
+        return this;
+    }
+    _is_speculative = true;
+    return this;
 }
 
 GraphDependency *GraphDependency::when(std::string condition) {
@@ -30,10 +104,10 @@ GraphDependency *GraphDependency::when(std::string condition) {
     auto processor = std::make_shared<ExpressionProcessor>();
     GraphVertex *expr_vertex =
         _graph->add_vertex(static_cast<std::shared_ptr<GraphProcessor>>(processor), vertex_name);
-    _condition_data = expr_vertex->emit(result_name);
-    _condition_data->add_downstream(this);
-    _condition_data->set_is_condition(true);
+    set_condition_data(expr_vertex->emit(result_name));
     processor->init(_condition_expr, result_name);
+    // 从GraphTemplate实例化时复用同一份已经解析好的表达式
+    expr_vertex->set_processor_creator(processor->creator());
 
     return this;
 }
@@ -49,6 +123,7 @@ void GraphDependency::execute_from_me() {
     LOG(TRACE) << ">>> GraphDependency execute_from_me activated vertexs size:"
                 << actived_vertexs.size();
 
+    ReadyBatch ready_batch;
     for (GraphVertex *vertex : actived_vertexs) {
         if (vertex->is_ready_before_run()) {
             LOG(TRACE) << "vertex[" << vertex->name() << "] is ready before run";
@@ -59,6 +134,11 @@ void GraphDependency::execute_from_me() {
 
 int32_t GraphDependency::fire_condition(bool condition_value) {
     _condition_ready = true;
+    if (_is_speculative && condition_value == false) {
+        // 推测执行的结果不再需要，在vertex执行之前标记
+        _is_condition_false.store(true, std::memory_order_release);
+        _depend_data->add_abandoned();
+    }
 
     int32_t current_expect_num = _expect_num.fetch_sub(1, std::memory_order_acq_rel) - 1;    
     LOG(TRACE) << "GraphDependency fire_condition value:" << condition_value << " current_expect_num: " << (current_expect_num + 1);
@@ -74,7 +154,7 @@ int32_t GraphDependency::fire_condition(bool condition_value) {
             LOG(TRACE) << "GraphDependency::fire_condition case2";
             return current_expect_num;
         }        
-    } else if (current_expect_num == 1) {
+    } else if (current_expect_num == 1 && !_is_speculative) {
         // 还差data没有出结果，从data那里继续激活和执行
         LOG(TRACE) << "GraphDependency::fire_condition case3";
         execute_from_me();
@@ -92,6 +172,20 @@ int32_t GraphDependency::fire_data() {
 }
 
 void GraphDependency::fire() {
+    if (_timeout_ms > 0) {
+        int32_t expected = TIMEOUT_STATE_WAITING;
+        if (!_timeout_state.compare_exchange_strong(expected, TIMEOUT_STATE_FIRED,
+                                                    std::memory_order_acq_rel)) {
+            // 已经超时，晚到的数据丢弃
+            LOG(TRACE) << "GraphDependency[" << get_name() << "] is timeout, discard late data";
+            return;
+        }
+        cancel_timer();
+    }
+    fire_attached_vertex();
+}
+
+void GraphDependency::fire_attached_vertex() {
     bool is_vertex_ready = _attached_vertex->decr_waiting_num();
 
     LOG(TRACE) << "GraphDependency fire(). attached_vertex[" << _attached_vertex->name() << "] " << noflush;
@@ -104,8 +198,23 @@ void GraphDependency::fire() {
     }
 }
 
+void GraphDependency::activate_planned(ClosureContext *closure_context) {
+    if (_timeout_ms > 0) {
+        start_timer(closure_context);
+    }
+    int32_t num = (_condition_data != nullptr ? 2 : 1);
+    int32_t current_expect_num = _expect_num.fetch_add(num, std::memory_order_acq_rel) + num;
+    // 数据在激活之前就已经发布了(外部输入)
+    if (current_expect_num == -1 || current_expect_num == 0) {
+        fire();
+    }
+}
+
 int32_t GraphDependency::activate(std::vector<GraphVertex *> &vertexs,
                                ClosureContext *closure_context) {
+    if (_timeout_ms > 0) {
+        start_timer(closure_context);
+    }
     int32_t num = (_condition_data != nullptr ? 2 : 1);
     int32_t current_expect_num = _expect_num.fetch_add(num, std::memory_order_acq_rel) + num;
     LOG(TRACE) << "GraphDependency::activate expect_num:" << current_expect_num << " " << _attached_vertex->name();
@@ -126,6 +235,9 @@ int32_t GraphDependency::activate(std::vector<GraphVertex *> &vertexs,
         }
     } else if (current_expect_num == 2) {
         _condition_data->activate(vertexs, closure_context);
+        if (_is_speculative) {
+            _depend_data->activate(vertexs, closure_context);
+        }
         LOG(TRACE) << "GraphDependency::activate branch 5 " << _attached_vertex->name();
     } else {
         LOG(WARNING) << "GraphDependency::activate invalid expect_num:" << current_expect_num;
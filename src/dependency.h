@@ -16,6 +16,8 @@ class GraphDependency {
    public:
     explicit GraphDependency(std::string name, Graph *graph,
                              GraphVertex *vertex);
+    explicit GraphDependency(GraphData *data, Graph *graph,
+                             GraphVertex *vertex);
     // 禁止拷贝和移动
     inline GraphDependency(GraphDependency &&) = delete;
     inline GraphDependency(const GraphDependency &) = delete;
@@ -26,6 +28,8 @@ class GraphDependency {
     //bool is_ready() { return _is_ready; }
     int32_t activate(std::vector<GraphVertex *> &vertexs,
                           ClosureContext *closure_context);
+    // ActivationPlan激活：上游由计划负责激活，这里只更新计数
+    void activate_planned(ClosureContext *closure_context);
     void reset();
     GraphDependency *when(std::string condition);
     void execute_from_me();
@@ -38,24 +42,69 @@ class GraphDependency {
     int32_t fire_data();
     void fire();
 
+    // 只能用于optional依赖：超过timeout_ms数据还没ready就不再等待，
+    // vertex照常执行，value()返回nullptr，晚到的数据被丢弃
+    GraphDependency *timeout(int64_t timeout_ms);
+    int64_t get_timeout() const { return _timeout_ms; }
+    bool is_timeout() const {
+        return _timeout_state.load(std::memory_order_acquire) == TIMEOUT_STATE_TIMEOUT;
+    }
+
+    // 只能用于带条件的依赖：不等条件结果，和条件并行执行数据的上游。
+    // 条件为false时结果被丢弃，value()返回nullptr，数据被标记为放弃，上游可以通过cancelled()提前退出
+    GraphDependency *speculate();
+    bool is_speculative() const { return _is_speculative; }
+    // 推测执行的条件依赖，条件为false时数据不可用
+    bool is_discarded() const {
+        return _is_speculative && _is_condition_false.load(std::memory_order_acquire);
+    }
+
+    // 下游通过pull读取数据(LAZY_DEPEND_VAR、value()、表达式的变量)，
+    // 惰性的上游只有在所有激活的下游依赖都这样读取时才推迟执行(见GraphVertex::set_lazy)
+    GraphDependency *lazy() {
+        _is_lazy = true;
+        return this;
+    }
+    bool is_lazy() const { return _is_lazy; }
+
     template<typename T>
     T *value();
 
-    std::string get_name() { return _name; }
+    const std::string& get_name();
     GraphVertex *get_attached_vertex() { return _attached_vertex; }
+    GraphData *get_depend_data() { return _depend_data; }
+    GraphData *get_condition_data() { return _condition_data; }
+    void set_condition_data(GraphData *condition_data);
 
    private:
+    void fire_attached_vertex();
+    void start_timer(ClosureContext *closure_context);
+    void cancel_timer();
+    void on_timeout(ClosureContext *closure_context);
+
+    static constexpr int32_t TIMEOUT_STATE_WAITING = 0;
+    static constexpr int32_t TIMEOUT_STATE_FIRED = 1;
+    static constexpr int32_t TIMEOUT_STATE_TIMEOUT = 2;
+
     GraphData *_depend_data = nullptr;
     //bool _is_ready = false;
 
    protected:
     GraphData *_condition_data = nullptr;
-    Graph *_graph = nullptr;
     GraphVertex *_attached_vertex = nullptr;
-    std::string _name;
-    std::string _condition_expr;
     std::atomic<int32_t> _expect_num{0};
     bool _condition_ready = false;
+    bool _is_speculative = false;
+    bool _is_lazy = false;
+    std::atomic<bool> _is_condition_false{false};
+    int64_t _timeout_ms = 0;
+    // 数据ready和超时只有一个生效
+    std::atomic<int32_t> _timeout_state{TIMEOUT_STATE_WAITING};
+    std::atomic<uint64_t> _timer_id{0};
+    ClosureContext *_timer_closure_context = nullptr;
+    // 只在建图时使用
+    Graph *_graph = nullptr;
+    std::string _condition_expr;
 };
 
 }  // namespace
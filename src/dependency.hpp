@@ -5,6 +5,9 @@ namespace gflow {
 template<typename T>
 T* GraphDependency::value() {
     DCHECK(_depend_data);
+    if (is_timeout() || is_discarded() || !_depend_data->pull()) {
+        return nullptr;
+    }
     return _depend_data->pointer<T>();
 }
 
@@ -63,6 +63,27 @@ class Expr {
         return true;
     }
 
+    // 使用已经解析好的ast求值，不再重复parse，ast只读，可以被多个线程共享
+    bool evaluate(const std::string& expr_string,
+                  std::unordered_map<std::string, int>* var_values,
+                  const client::ast::FinalResult& ast, int& result) {
+        client::vmachine vm;                // Our virtual machine
+        client::code_gen::program program;  // Our VM program
+        iterator_type iter = expr_string.begin();
+        iterator_type end = expr_string.end();
+        client::error_handler<iterator_type> error_handler(
+            iter, end);  // Our error handler
+        client::code_gen::compiler compile(program, error_handler,
+                                           var_values);  // Our compiler
+
+        if (!compile.start(ast)) {
+            return false;
+        }
+        vm.execute(program());
+        result = vm.get_result();
+        return true;
+    }
+
     bool parse(const std::string& expr_string, client::ast::FinalResult& ast) {
         iterator_type iter = expr_string.begin();
         iterator_type end = expr_string.end();
@@ -1,29 +1,50 @@
-
 #include "expr_processor.h"
 #include "vertex.h"
+#include "dependency.h"
+#include "graph_executor.h"
 
 namespace gflow {
 
 void ExpressionProcessor::init(std::string expr_string_,
-                               std::string result_name) {
-    expr_string = std::move(expr_string_);
-    _result_data = get_data(result_name)->make<int>();
-    //_result_data = get_data(result_name);
+                               std::string result_name_) {
+    auto compiled = std::make_shared<CompiledExpression>();
+    compiled->expr_string = std::move(expr_string_);
+    if (!expr.parse(compiled->expr_string, compiled->ast)) {
+        LOG(WARNING) << "expression parse failed expr:" << compiled->expr_string;
+        return;
+    }
+    if (!expr.var_analyze(compiled->ast, &compiled->varnames)) {
+        LOG(WARNING) << "expression var analyze failed expr:" << compiled->expr_string;
+        return;
+    }
+    init(std::move(compiled), std::move(result_name_));
+}
+
+void ExpressionProcessor::init(std::shared_ptr<const CompiledExpression> compiled,
+                               std::string result_name_) {
+    _compiled = std::move(compiled);
+    result_name = std::move(result_name_);
+}
+
+ProcessorCreator ExpressionProcessor::creator() const {
+    return [compiled = _compiled, result_name = result_name]() -> std::shared_ptr<GraphProcessor> {
+        auto processor = std::make_shared<ExpressionProcessor>();
+        processor->init(compiled, result_name);
+        return processor;
+    };
 }
 
 int ExpressionProcessor::setup() {
-    if (!expr.parse(expr_string, ast)) {
-        LOG(WARNING) << "expression parse failed expr:" << expr_string;
-        return -1;
-    }
-    if (!expr.var_analyze(ast, &varnames)) {
-        LOG(WARNING) << "expression var analyze failed expr:" << expr_string;
+    if (!_compiled) {
+        LOG(WARNING) << "expression is not compiled, result:" << result_name;
         return -1;
     }
+    _result_data = get_data(result_name)->make<int>();
     LOG(TRACE) << "ExpressionProcessor expr use variables:[" << noflush;
-    for (const std::string& var : varnames) {
+    for (const std::string& var : _compiled->varnames) {
         LOG(TRACE) << var << "," << noflush;
-        _vertex->depend(var);
+        // 变量在process时通过pull读取
+        _vertex->depend(var)->lazy();
     }
     LOG(TRACE) << "]";
     return 0;
@@ -31,20 +52,28 @@ int ExpressionProcessor::setup() {
 
 int ExpressionProcessor::process() {
     LOG(TRACE) << "ExpressionProcessor process()";
-    int& result = _result_data->raw<int>();
+    // 批量执行时每行的值需要单独创建
+    int& result = _result_data->make<int>()->raw<int>();
     std::unordered_map<std::string, int> variables;
-    for (const std::string& var : varnames) {
-        int var_value = get_data(var)->as<int>();
+    for (const std::string& var : _compiled->varnames) {
+        GraphData* data = get_data(var);
+        // 变量可能是惰性数据
+        if (!data->pull()) {
+            LOG(WARNING) << "expression pull variable failed var:" << var;
+            return -1;
+        }
+        int var_value = data->as<int>();
         variables.emplace(var, var_value);
     }
-    if (!expr.evaluate(expr_string, &variables, ast, result)) {
-        LOG(WARNING) << "expression evaluate failed expr:" << expr_string;
+    if (!expr.evaluate(_compiled->expr_string, &variables, _compiled->ast, result)) {
+        LOG(WARNING) << "expression evaluate failed expr:" << _compiled->expr_string;
         return -1;
     }
     LOG(TRACE) << "ExpressionProcessor process result["
                 << _result_data->get_name() << "] -> " << result;
+    InlineContinuation::TailScope tail_scope;
     _result_data->release();
     return 0;
 }
 
-}  // namespace;
\ No newline at end of file
+}  // namespace;
@@ -4,24 +4,33 @@
 #include "expr/expr.h"
 #include "processor.h"
 #include <vector>
+#include <memory>
 #include <unordered_map>
 #include "data.h"
 
 namespace gflow {
 
+// 解析和变量分析的结果，只读，可以在多个图实例的ExpressionProcessor之间共享
+struct CompiledExpression {
+    std::string expr_string;
+    client::ast::FinalResult ast;
+    std::vector<std::string> varnames;
+};
+
 class ExpressionProcessor : public GraphProcessor {
    public:
     void init(std::string expr_string_, std::string result_name);
+    void init(std::shared_ptr<const CompiledExpression> compiled, std::string result_name);
+    // 返回的creator创建的processor共享同一份CompiledExpression，不再重复解析表达式
+    ProcessorCreator creator() const;
     int setup();
     int process();
 
    private:
-    std::string expr_string;
-    client::ast::FinalResult ast;
+    std::shared_ptr<const CompiledExpression> _compiled;
     std::string result_name;
-    std::vector<std::string> varnames;
     gflow::Expr expr;
     GraphData* _result_data = nullptr;
 };
 
-}  // namespace gflow
\ No newline at end of file
+}  // namespace gflow
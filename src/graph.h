@@ -1,19 +1,30 @@
 #pragma once
 
 #include "vertex.h"
+#include "dependency.h"
 #include "data.h"
 #include "processor.h"
 #include "closure.h"
 #include "graph_executor.h"
+#include "activation_plan.h"
+#include "graph_topology.h"
+#include "data_recycler.h"
 
 #include <map>
 #include <vector>
 #include <string>
 #include <future>
 #include <mutex>
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <algorithm>
 
 namespace gflow {
 
+class GraphTemplate;
+class GraphPool;
+
 constexpr static int32_t BthreadExecutorType = 1;
 constexpr static int32_t AsyncExecutorType = 2;
 
@@ -44,17 +55,18 @@ class Graph {
             return nullptr;
         }
         GraphVertex* vertex = add_vertex(processor, processor_name);
+        vertex->set_processor_creator(ProcessorFactory::instance().get_creator(processor_name));
+        std::string group_name = ProcessorFactory::instance().get_group(processor_name);
+        if (!group_name.empty()) {
+            vertex->set_concurrency_group(group_name);
+        }
         LOG(TRACE) << "GraphVertex add_vertex create processor:" << processor_name << " ptr:" << processor << " vertex:" << vertex;
         return vertex;
     }
 
     GraphVertex *add_vertex(std::shared_ptr<GraphProcessor> processor, std::string processor_name) {
         auto *v = new GraphVertex(this, processor, processor_name);
-#ifdef USE_BTHREAD
-        v->set_executor(BthreadGraphExecutor::instance());
-#else
-        v->set_executor(AsyncGraphExecutor::instance());
-#endif
+        v->set_executor(_executor);
         _vertixes.emplace_back(v);
         return v;
     }
@@ -72,7 +84,9 @@ class Graph {
         auto iter = _global_data.find(data_name);
         if (iter == _global_data.end()) {
             auto *graph_data = new GraphData(data_name);
+            graph_data->set_batch_size(_batch_size);
             _global_data.emplace(data_name, graph_data);
+            _datas.emplace_back(graph_data);
             return graph_data;
         }
         return iter->second;
@@ -82,61 +96,469 @@ class Graph {
         for (auto vertex : _vertixes) {
             vertex->build();
         }
+        // vertex build时可能还会添加依赖(例如表达式的变量)，之后再生成拓扑
+        _topology.build(_vertixes, _datas);
+        update_priority();
+        fuse_vertexes();
+        setup_data_recycle();
+        // 没有下游的data一般是run的目标，预先计算好激活计划
+        _activation_plans.clear();
+        _multi_target_plans.clear();
+        for (GraphData *data : _datas) {
+            if (data->get_producer() != nullptr && data->get_down_streams().empty()) {
+                _activation_plans.emplace(data, ActivationPlan::create(data));
+            }
+        }
     }
 
-    ClosureContext* run(GraphData *data) {
-        //auto closure_context = std::make_unique<ClosureContext>();
-        auto* closure_context = _executor->create_closure_context();
-        // 让那些没有依赖的vertex先执行，因为只有是data的上游vertex才需要执行，
-        // 所以不能全局遍历所有vertex，需要先递归遍历一遍把data的上游vertex标记出来。
-        std::vector<GraphVertex *> actived_vertexs;
-        //data->activate(actived_vertexs, closure_context.get());
-        data->activate(actived_vertexs, closure_context);
-        closure_context->add_wait_vertex_num(actived_vertexs.size());
-        LOG(TRACE) << "--------------------- activate done begin execute -------------";    
-            
-        LOG(TRACE) << ">>> Graph run activated vertexs size:"
-                    << actived_vertexs.size() << " vertexes:[" << noflush;
-        for (GraphVertex *vertex : actived_vertexs) {
-            LOG(TRACE) << vertex->name() << "," << noflush;
+    // 返回目标data的激活计划，没有就创建一个。不能和run并发调用
+    const ActivationPlan *get_activation_plan(GraphData *data) {
+        auto iter = _activation_plans.find(data);
+        if (iter == _activation_plans.end()) {
+            iter = _activation_plans.emplace(data, ActivationPlan::create(data)).first;
         }
-        LOG(TRACE) << "]";
+        return iter->second.get();
+    }
+    // 多个目标data的激活计划，按目标集合缓存，没有目标时返回nullptr。不能和run并发调用
+    const ActivationPlan *get_activation_plan(std::vector<GraphData *> datas) {
+        if (datas.empty()) {
+            LOG(WARNING) << "Graph get_activation_plan with empty targets";
+            return nullptr;
+        }
+        std::sort(datas.begin(), datas.end());
+        datas.erase(std::unique(datas.begin(), datas.end()), datas.end());
+        if (datas.size() == 1) {
+            return get_activation_plan(datas[0]);
+        }
+        auto iter = _multi_target_plans.find(datas);
+        if (iter == _multi_target_plans.end()) {
+            auto plan = ActivationPlan::create(datas.data(), datas.size());
+            iter = _multi_target_plans.emplace(std::move(datas), std::move(plan)).first;
+        }
+        return iter->second.get();
+    }
 
-        for (GraphVertex *vertex : actived_vertexs) {
-            if (vertex->is_ready_before_run()) {
-                LOG(TRACE)
-                    << "vertex[" << vertex->name() << "] is ready before run";
-                vertex->execute();
+    // 按关键路径计算vertex的调度优先级：自身的预估耗时加上到下游终点的最长路径耗时。
+    // build时计算一次，运行一段时间后可以再调用，用实测耗时重新计算，不能和run并发调用
+    void update_priority() {
+        if (_topology.vertex_size() != _vertixes.size()) {
+            _topology.build(_vertixes, _datas);
+        }
+        // -1表示还没有计算
+        std::vector<int64_t> priorities(_vertixes.size(), -1);
+        std::function<int64_t(uint32_t)> longest_path = [&](uint32_t vertex_idx) -> int64_t {
+            if (priorities[vertex_idx] >= 0) {
+                return priorities[vertex_idx];
             }
+            // 先占位，有环时不会无限递归
+            priorities[vertex_idx] = 0;
+            int64_t max_downstream_path = 0;
+            for (uint32_t downstream_idx : _topology.downstreams(vertex_idx)) {
+                max_downstream_path = std::max(max_downstream_path, longest_path(downstream_idx));
+            }
+            int64_t priority = _topology.vertex(vertex_idx)->estimated_cost() + max_downstream_path;
+            priorities[vertex_idx] = priority;
+            return priority;
+        };
+        for (uint32_t i = 0; i < _vertixes.size(); ++i) {
+            _vertixes[i]->set_priority(longest_path(i));
         }
+    }
+
+    // timeout大于0时，超时后以GraphTimeoutError结束
+    ClosureContext* run(GraphData *data, std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+        //auto closure_context = std::make_unique<ClosureContext>();
+        auto* closure_context = _executor->create_closure_context();
+        set_timeout(closure_context, timeout);
+        launch(get_activation_plan(data), &data, 1, closure_context);
         //return std::move(closure_context);
         return closure_context;
     }
 
+    // 一次激活多个目标data，共享的上游只激活、执行一次，所有激活的vertex执行完才结束。
+    // 没有目标时返回以-1结束的ClosureContext
+    ClosureContext* run(const std::vector<GraphData *> &datas,
+                        std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+        auto* closure_context = _executor->create_closure_context();
+        set_timeout(closure_context, timeout);
+        const ActivationPlan *plan = get_activation_plan(datas);
+        if (plan == nullptr) {
+            closure_context->mark_finish(-1);
+            return closure_context;
+        }
+        launch(plan, datas.data(), datas.size(), closure_context);
+        return closure_context;
+    }
+
+    // 非阻塞执行，调用线程不等待图执行结束。
+    // 执行完最后一个vertex的线程上回调on_done(error_code)，回调时图已经不再被访问，可以reset复用或者析构。
+    // 图依赖的外部输入需要在调用之前发布
+    void run(GraphData *data, std::function<void(int32_t)> on_done,
+             std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+        auto* closure_context = _executor->create_closure_context();
+        closure_context->set_on_done(std::move(on_done));
+        set_timeout(closure_context, timeout);
+        // 调用线程本身也算一个执行中的任务，保证调度完所有vertex之前不会回调
+        closure_context->add_pending();
+        launch(get_activation_plan(data), &data, 1, closure_context);
+        closure_context->done_pending();
+    }
+
+    // 多个目标data的非阻塞执行，没有目标时以-1回调
+    void run(const std::vector<GraphData *> &datas, std::function<void(int32_t)> on_done,
+             std::chrono::milliseconds timeout = std::chrono::milliseconds::zero()) {
+        auto* closure_context = _executor->create_closure_context();
+        closure_context->set_on_done(std::move(on_done));
+        set_timeout(closure_context, timeout);
+        closure_context->add_pending();
+        const ActivationPlan *plan = get_activation_plan(datas);
+        if (plan == nullptr) {
+            closure_context->mark_finish(-1);
+        } else {
+            launch(plan, datas.data(), datas.size(), closure_context);
+        }
+        closure_context->done_pending();
+    }
+
+    // 切换图使用的executor，例如AsyncGraphExecutor::instance(ThreadPoolBackend::WORK_STEALING)
+    void set_executor(GraphExecutor* executor) {
+        _executor = executor;
+        for (auto vertex : _vertixes) {
+            vertex->set_executor(executor);
+        }
+    }
+    GraphExecutor* get_executor() const {
+        return _executor;
+    }
+
+    // 批量执行：设置之后每次run一次处理batch_size个请求，0表示普通执行。
+    // 外部输入按行设置(GraphData::set_value(row, value))后发布，结果按行读取(GraphData::raw<T>(row))。
+    // processor默认逐行调用process，重写process_batch可以一次处理整批。
+    // 同一批请求只能走同一个分支，条件data各行的值不一致时执行以-1结束。需要在图没有执行时调用
+    void set_batch_size(size_t batch_size) {
+        if (_batch_size == batch_size) {
+            return;
+        }
+        _batch_size = batch_size;
+        for (GraphData *data : _datas) {
+            data->set_batch_size(batch_size);
+        }
+    }
+    size_t batch_size() const {
+        return _batch_size;
+    }
+
+    // 检测单生产者单消费者的链：vertex产出的data只被同一个下游vertex依赖、下游也只依赖这个vertex的产出
+    // (或者外部输入)时，把下游融合到它后面。整条链在一个调度任务里连续执行：上游结束时让下游ready的话，
+    // 下游不经过dispatch和executor，直接在同一个任务里接着执行，链上只占一个执行中的任务计数，
+    // latch在链结束时一次扣减，见InlineContinuation::claim_fused。下游照常通过依赖计数ready，
+    // 数据发布的语义不变；下游没有其他的上游可以并行，融合不会损失并行度。build时调用
+    void fuse_vertexes() {
+        size_t fused_num = 0;
+        for (GraphVertex *vertex : _vertixes) {
+            vertex->set_fused_next(nullptr);
+        }
+        for (uint32_t i = 0; i < _vertixes.size(); ++i) {
+            GraphVertex *vertex = _vertixes[i];
+            if (!_vertex_fusion || _topology.emits(i).empty()) {
+                continue;
+            }
+            GraphVertex *next = nullptr;
+            bool is_linear = true;
+            for (uint32_t data_idx : _topology.emits(i)) {
+                auto consumers = _topology.consumers(data_idx);
+                for (GraphDependency *dependency : consumers) {
+                    if (next != nullptr && next != dependency->get_attached_vertex()) {
+                        is_linear = false;
+                    }
+                    next = dependency->get_attached_vertex();
+                }
+                if (consumers.empty()) {
+                    is_linear = false;
+                }
+            }
+            if (is_linear && next != nullptr && next != vertex) {
+                // 下游的其他依赖(包括条件)有别的生产者时，等哪个上游最后结束就由谁接着执行，不融合
+                for (GraphDependency *dependency : next->get_dependencys()) {
+                    GraphData *condition_data = dependency->get_condition_data();
+                    if (!is_produced_by(dependency->get_depend_data(), vertex)
+                            || (condition_data != nullptr && !is_produced_by(condition_data, vertex))) {
+                        is_linear = false;
+                    }
+                }
+            }
+            if (is_linear && next != nullptr && next != vertex) {
+                vertex->set_fused_next(next);
+                fused_num++;
+            }
+        }
+        LOG(TRACE) << "Graph fuse vertexes fused_num:" << fused_num;
+    }
+    // 默认关闭，需要在build之前设置
+    void set_vertex_fusion(bool enable) {
+        _vertex_fusion = enable;
+    }
+    bool is_vertex_fusion() const {
+        return _vertex_fusion;
+    }
+
+    // 开启后vertex结束时第一个ready的后继直接在当前worker线程执行，见InlineContinuation
+    void set_inline_continuation(bool enable) {
+        _inline_continuation = enable;
+    }
+    bool is_inline_continuation() const {
+        return _inline_continuation;
+    }
+
+    // 中间数据的提前回收：build时统计每个中间data(有生产者也有下游)的下游依赖数，
+    // 执行时下游vertex执行完就减一，最后一个下游执行完时把值回收到图的DataRecycler，
+    // 之后同类型的data产出时复用，每个执行中的请求常驻的只有还会被读取的中间数据，而不是所有中间数据的总和。
+    // * run的目标和外部输入不回收，其他中间data在run结束后不一定还能读取，需要读取时在run之前调用GraphData::retain
+    // * 本轮没有激活的下游不会执行完，它依赖的data保留到reset
+    // * 生产者执行完(流式输出关闭、结果写入缓存)之前不回收，惰性vertex没有被读取时它产出的data保留到reset
+    // * 对冲执行的vertex依赖和产出的data都保留到reset
+    // * max_pooled_per_type为0时不放回池子，直接释放
+    // 默认关闭，需要在build之前设置
+    void set_data_recycle(bool enable, size_t max_pooled_per_type = 4) {
+        _data_recycle = enable;
+        _data_recycle_pool_size = max_pooled_per_type;
+    }
+    bool is_data_recycle() const {
+        return _data_recycle;
+    }
+    size_t get_data_recycle_pool_size() const {
+        return _data_recycle_pool_size;
+    }
+    // 没有开启时返回nullptr
+    DataRecycler *get_data_recycler() const {
+        return _data_recycler.get();
+    }
+
+    // build时生成的紧凑拓扑
+    const GraphTopology& get_topology() const {
+        return _topology;
+    }
+
+    // 从GraphTemplate创建的图实例返回对应的模板，否则返回nullptr
+    const std::shared_ptr<const GraphTemplate>& get_template() const {
+        return _template;
+    }
+
     void reset() {
         for (auto vertex : _vertixes) {
             vertex->reset();
         }
-        for (auto& [name, data] : _global_data) {
+        for (GraphData *data : _datas) {
             data->reset();
         }
     }
 
+    // 增量执行：只重置dirty_datas和它们传递的下游，其余data保留上一轮的值，视为已经发布，
+    // 下一次run只激活、执行被重置的vertex。dirty的外部输入需要在run之前重新发布，
+    // dirty的中间data会连同它的生产者一起重新计算。
+    // 没有执行完(有产出还没有发布或者没有产出)的vertex也会被重置。需要在build之后、图没有执行时调用
+    void reset_incremental(const std::vector<GraphData *> &dirty_datas) {
+        std::vector<char> is_dirty_vertex(_vertixes.size(), 0);
+        std::vector<char> is_dirty_data(_datas.size(), 0);
+        std::vector<GraphVertex *> stack;
+        auto mark_data = [&](GraphData *data) {
+            if (is_dirty_data[data->idx()]) {
+                return;
+            }
+            is_dirty_data[data->idx()] = 1;
+            for (GraphDependency *dependency : data->get_down_streams()) {
+                stack.emplace_back(dependency->get_attached_vertex());
+            }
+        };
+        for (GraphData *data : dirty_datas) {
+            mark_data(data);
+            if (data->get_producer() != nullptr) {
+                stack.emplace_back(data->get_producer());
+            }
+        }
+        for (GraphVertex *vertex : _vertixes) {
+            const auto &emits = vertex->get_emits();
+            // 已经被提前回收的data也要重新产出
+            if (emits.empty() || std::any_of(emits.begin(), emits.end(), [](GraphData *data) {
+                    return !data->is_released() || data->is_recycled();
+                })) {
+                stack.emplace_back(vertex);
+            }
+        }
+        while (!stack.empty()) {
+            GraphVertex *vertex = stack.back();
+            stack.pop_back();
+            if (is_dirty_vertex[vertex->idx()]) {
+                continue;
+            }
+            is_dirty_vertex[vertex->idx()] = 1;
+            for (GraphData *data : vertex->get_emits()) {
+                mark_data(data);
+            }
+        }
+        size_t reset_vertex_num = 0;
+        for (GraphVertex *vertex : _vertixes) {
+            if (is_dirty_vertex[vertex->idx()]) {
+                vertex->reset();
+                ++reset_vertex_num;
+            }
+        }
+        for (GraphData *data : _datas) {
+            if (is_dirty_data[data->idx()]) {
+                data->reset();
+                continue;
+            }
+            // 保留的data对被重置的下游依赖重新发布一次，和run之前发布的外部输入一样
+            if (data->is_released()) {
+                int32_t dirty_consumer_num = 0;
+                for (GraphDependency *dependency : data->get_down_streams()) {
+                    if (is_dirty_vertex[dependency->get_attached_vertex()->idx()]) {
+                        data->refire(dependency);
+                        ++dirty_consumer_num;
+                    }
+                }
+                if (_data_recycle) {
+                    data->set_pending_consumer_num(dirty_consumer_num);
+                }
+            }
+        }
+        LOG(TRACE) << "Graph reset_incremental dirty_data_num:" << dirty_datas.size()
+                   << " reset_vertex_num:" << reset_vertex_num << "/" << _vertixes.size();
+    }
+
     ~Graph() {
         for (auto vertex : _vertixes) {
             vertex->reset();
             delete vertex;
         }
-        for (auto& [name, data] : _global_data) {
+        for (GraphData *data : _datas) {
             data->reset();
             delete data;
-        }        
+        }
     }
 
    private:
+    void set_timeout(ClosureContext *closure_context, std::chrono::milliseconds timeout) {
+        if (timeout > std::chrono::milliseconds::zero()) {
+            closure_context->set_deadline(std::chrono::steady_clock::now() + timeout);
+        }
+    }
+
+    // data由vertex产出，或者是外部输入
+    static bool is_produced_by(GraphData *data, GraphVertex *vertex) {
+        return data->get_producer() == nullptr || data->get_producer() == vertex;
+    }
+
+    // 统计中间data的下游依赖数，build时调用
+    void setup_data_recycle() {
+        if (!_data_recycle) {
+            _data_recycler.reset();
+            for (GraphData *data : _datas) {
+                data->set_recycle(nullptr, 0);
+            }
+            return;
+        }
+        if (!_data_recycler || _data_recycler->max_pooled() != _data_recycle_pool_size) {
+            _data_recycler = std::make_unique<DataRecycler>(_data_recycle_pool_size);
+        }
+        size_t recycle_data_num = 0;
+        for (uint32_t i = 0; i < _datas.size(); ++i) {
+            GraphData *data = _datas[i];
+            int32_t consumer_num = 0;
+            for (GraphDependency *dependency : _topology.consumers(i)) {
+                consumer_num += (dependency->get_depend_data() == data ? 1 : 0);
+            }
+            // 条件data只用来选择分支，值很小，不回收
+            if (data->get_producer() == nullptr || data->is_condition() || consumer_num == 0) {
+                data->set_recycle(nullptr, 0);
+                continue;
+            }
+            // 生产者执行完时也减一
+            data->set_recycle(_data_recycler.get(), consumer_num + 1);
+            ++recycle_data_num;
+        }
+        LOG(TRACE) << "Graph setup data recycle recycle_data_num:" << recycle_data_num;
+    }
+
+    void launch(const ActivationPlan *plan, GraphData *const *datas, size_t data_num,
+                ClosureContext *closure_context) {
+        // 让那些没有依赖的vertex先执行，因为只有是data的上游vertex才需要执行，
+        // 所以不能全局遍历所有vertex，需要先把data的上游vertex标记出来。
+        // 优先使用预先计算好的激活计划，计划中的data已经被提前发布时才递归遍历
+        std::vector<GraphVertex *> dynamic_vertexs;
+        const std::vector<GraphVertex *> *actived_vertexs = &dynamic_vertexs;
+        // 批量执行时提前发布的条件各行不一致，不执行
+        if (_batch_size > 0) {
+            for (GraphData *data : _datas) {
+                if (data->get_producer() == nullptr && data->is_condition() && data->is_released()
+                        && !data->is_batch_condition_consistent()) {
+                    LOG(WARNING) << "Graph run condition:" << data->get_name() << " differs between batch rows";
+                    closure_context->mark_finish(-1);
+                    return;
+                }
+            }
+        }
+        // 目标data在run结束后还要读取，不回收
+        if (_data_recycle) {
+            for (size_t i = 0; i < data_num; ++i) {
+                datas[i]->retain();
+            }
+        }
+        if (plan->is_applicable()) {
+            actived_vertexs = &plan->vertexes();
+            closure_context->add_wait_vertex_num(actived_vertexs->size());
+            plan->activate(closure_context);
+        } else {
+            LOG(TRACE) << "Graph run activation plan not applicable, activate recursively";
+            //data->activate(actived_vertexs, closure_context.get());
+            // 多个目标共享的上游vertex只会被激活一次
+            for (size_t i = 0; i < data_num; ++i) {
+                datas[i]->activate(dynamic_vertexs, closure_context);
+            }
+            closure_context->add_wait_vertex_num(dynamic_vertexs.size());
+        }
+        LOG(TRACE) << "--------------------- activate done begin execute -------------";    
+            
+        LOG(TRACE) << ">>> Graph run activated vertexs size:"
+                    << actived_vertexs->size() << " vertexes:[" << noflush;
+        for (GraphVertex *vertex : *actived_vertexs) {
+            LOG(TRACE) << vertex->name() << "," << noflush;
+        }
+        LOG(TRACE) << "]";
+
+        // 没有依赖的vertex按优先级调度
+        ReadyBatch ready_batch;
+        for (GraphVertex *vertex : *actived_vertexs) {
+            if (vertex->is_ready_before_run()) {
+                LOG(TRACE)
+                    << "vertex[" << vertex->name() << "] is ready before run";
+                vertex->execute();
+            }
+        }
+    }
+
+    friend class GraphTemplate;
+    friend class GraphPool;
+
     std::vector<GraphVertex *> _vertixes;
+    // 按名字查找data，只在建图和get_data时使用
     std::unordered_map<std::string, GraphData *> _global_data;
+    // 按创建顺序保存的data，reset等遍历不经过unordered_map
+    std::vector<GraphData *> _datas;
+    GraphTopology _topology;
     GraphExecutor* _executor = nullptr;
+    std::unordered_map<GraphData *, std::unique_ptr<ActivationPlan>> _activation_plans;
+    // key是排序去重后的目标data
+    std::map<std::vector<GraphData *>, std::unique_ptr<ActivationPlan>> _multi_target_plans;
+    std::shared_ptr<const GraphTemplate> _template;
+    // 在GraphPool中的下标
+    uint32_t _pool_idx = 0;
+    size_t _batch_size = 0;
+    bool _inline_continuation = false;
+    bool _vertex_fusion = false;
+    bool _data_recycle = false;
+    size_t _data_recycle_pool_size = 4;
+    std::unique_ptr<DataRecycler> _data_recycler;
     std::mutex _mutex;
 };
 
@@ -4,14 +4,149 @@
 #include <future>
 #include <mutex>
 #include <assert.h>
+#include <vector>
+#include <algorithm>
 
 #include "graph_executor.h"
 #include "closure.h"
 #include "vertex.h"
 #include "concurrent/thread_pool.h"
+#include "concurrent/work_stealing_thread_pool.h"
 
 namespace gflow {
 
+namespace {
+
+struct ContinuationState {
+    // 当前线程正在执行的vertex，用来判断是否在worker上，以及后继是否和它融合
+    GraphVertex* running = nullptr;
+    // 已经接管、等待在本线程执行的后继vertex
+    GraphVertex* next = nullptr;
+    // next是融合的后继，没有经过调度，和running共用一个执行中的任务计数
+    bool next_is_fused = false;
+    bool in_tail = false;
+};
+
+thread_local ContinuationState tls_continuation;
+
+struct ReadyBatchState {
+    // ReadyBatch嵌套的层数，只有最外层负责调度
+    int32_t depth = 0;
+    std::vector<GraphVertex*> vertexes;
+};
+
+thread_local ReadyBatchState tls_ready_batch;
+
+}  // namespace
+
+ReadyBatch::ReadyBatch() {
+    tls_ready_batch.depth++;
+}
+
+ReadyBatch::~ReadyBatch() {
+    auto& state = tls_ready_batch;
+    if (--state.depth > 0) {
+        return;
+    }
+    if (state.vertexes.empty()) {
+        return;
+    }
+    // 换出来再调度，调度过程中如果又产生了新的batch不会互相影响
+    std::vector<GraphVertex*> vertexes;
+    vertexes.swap(state.vertexes);
+    if (vertexes.size() > 1) {
+        std::sort(vertexes.begin(), vertexes.end(), [](GraphVertex* a, GraphVertex* b) {
+            return a->priority() > b->priority();
+        });
+    }
+    for (GraphVertex* vertex : vertexes) {
+        vertex->dispatch();
+    }
+    // 复用vector的内存
+    vertexes.clear();
+    if (state.vertexes.capacity() == 0) {
+        state.vertexes.swap(vertexes);
+    }
+}
+
+bool ReadyBatch::collect(GraphVertex* vertex) {
+    auto& state = tls_ready_batch;
+    if (state.depth == 0) {
+        return false;
+    }
+    state.vertexes.emplace_back(vertex);
+    return true;
+}
+
+void InlineContinuation::run(GraphVertex* vertex) {
+    auto& state = tls_continuation;
+    GraphVertex* prev_running = state.running;
+    // 嵌套执行时外层推迟的计数留给外层
+    DeferredFinish prev_deferred = ClosureContext::deferred_finish();
+    ClosureContext::deferred_finish() = DeferredFinish();
+    while (vertex != nullptr) {
+        state.running = vertex;
+        // 执行结束后ClosureContext可能被释放，需要提前取出来
+        ClosureContext* closure_context = vertex->get_closure_context();
+        if (vertex->fused_next() != nullptr) {
+            closure_context->defer_finished();
+        }
+        vertex->run();
+        vertex->release_concurrency();
+        // 融合的链整条只在结束时扣减一次latch、归还一次任务计数。
+        // done_pending里回调的on_done也可能接管后继，之后才能取state.next
+        bool is_fused = state.next_is_fused;
+        if (!is_fused) {
+            closure_context->flush_finished();
+            closure_context->done_pending();
+        }
+        vertex = state.next;
+        state.next = nullptr;
+        state.next_is_fused = false;
+        if (vertex != nullptr) {
+            LOG(TRACE) << "InlineContinuation run vertex[" << vertex->name() << "] inline"
+                       << (is_fused ? " fused" : "");
+        }
+    }
+    state.running = prev_running;
+    ClosureContext::deferred_finish() = prev_deferred;
+}
+
+bool InlineContinuation::offer(GraphVertex* vertex) {
+    auto& state = tls_continuation;
+    if (state.running == nullptr || !state.in_tail || state.next != nullptr) {
+        return false;
+    }
+    if (!vertex->is_inline_continuation()) {
+        return false;
+    }
+    state.next = vertex;
+    return true;
+}
+
+bool InlineContinuation::claim_fused(GraphVertex* vertex) {
+    auto& state = tls_continuation;
+    if (state.running == nullptr || state.running->fused_next() != vertex
+            || !state.in_tail || state.next != nullptr) {
+        return false;
+    }
+    // 并发组的名额需要经过调度申请
+    if (vertex->get_concurrency_group()) {
+        return false;
+    }
+    state.next = vertex;
+    state.next_is_fused = true;
+    return true;
+}
+
+InlineContinuation::TailScope::TailScope() : _prev_in_tail(tls_continuation.in_tail) {
+    tls_continuation.in_tail = true;
+}
+
+InlineContinuation::TailScope::~TailScope() {
+    tls_continuation.in_tail = _prev_in_tail;
+}
+
 inline void* run_vertex(void* args) {
     auto* params = reinterpret_cast<Params*>(args);
     GraphVertex* vertex = params->vertex;
@@ -19,8 +154,8 @@ inline void* run_vertex(void* args) {
     assert(closure_context != nullptr);
     assert(closure_context == vertex->get_closure_context());
     assert(closure_context->is_delete.load() == false);
-    vertex->run();
     delete params;
+    InlineContinuation::run(vertex);
     return NULL;
 }
 
@@ -28,6 +163,18 @@ ClosureContext* GraphExecutor::create_closure_context() {
     return new ClosureContext();
 }
 
+int32_t GraphExecutor::submit(std::function<void()> task) {
+    gflow::concurrent::thread_pool_async(std::move(task));
+    return 0;
+}
+
+inline void* run_task(void* args) {
+    auto* task = reinterpret_cast<std::function<void()>*>(args);
+    (*task)();
+    delete task;
+    return NULL;
+}
+
 int32_t BthreadGraphExecutor::execute(GraphVertex* vertex,
                 ClosureContext* closure_context) {
     auto* params = new Params(vertex, closure_context);
@@ -41,10 +188,28 @@ int32_t BthreadGraphExecutor::execute(GraphVertex* vertex,
     return 0;
 }
 
+int32_t BthreadGraphExecutor::submit(std::function<void()> task) {
+    auto* args = new std::function<void()>(std::move(task));
+    bthread_t th;
+    if (bthread_start_background(&th, NULL, run_task, args) != 0) {
+        LOG(WARNING) << "bthread start to run task failed";
+        delete args;
+        return -1;
+    }
+    return 0;
+}
+
 int32_t AsyncGraphExecutor::execute(GraphVertex* vertex,
                 ClosureContext* closure_context) {
     auto* params = new Params(vertex, closure_context);
 
+    if (_backend == ThreadPoolBackend::WORK_STEALING) {
+        // worker线程里ready的vertex进入本地队列，由其他空闲worker窃取
+        gflow::concurrent::WorkStealingThreadPool::instance().enqueue([params]() {
+            run_vertex(params);
+        });
+        return 0;
+    }
     gflow::concurrent::thread_pool_async(run_vertex, params);
     // std::async(std::launch::async, run_vertex, params);
 
@@ -60,4 +225,13 @@ int32_t AsyncGraphExecutor::execute(GraphVertex* vertex,
     return 0;
 }
 
+int32_t AsyncGraphExecutor::submit(std::function<void()> task) {
+    if (_backend == ThreadPoolBackend::WORK_STEALING) {
+        gflow::concurrent::WorkStealingThreadPool::instance().enqueue(std::move(task));
+        return 0;
+    }
+    gflow::concurrent::thread_pool_async(std::move(task));
+    return 0;
+}
+
 }  // namespace gflow
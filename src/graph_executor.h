@@ -3,6 +3,9 @@
 #include <tuple>
 #include <future>
 #include <mutex>
+#include <functional>
+
+#include "concurrent/thread_pool_backend.h"
 
 // #include <bthread.h>
 // #include <bthread/mutex.h>
@@ -23,6 +26,49 @@ struct Params {
 
 inline void* run_vertex(void* args);
 
+// 续体执行(continuation)：vertex结束时发布数据使得后继vertex ready，
+// 第一个ready的后继直接在当前worker线程上接着执行，其余的才交给executor调度。
+// 长链路不再经过任务队列，上游刚写完的数据也还在同一个核的cache里。
+// 只有图开启了inline continuation才生效，见Graph::set_inline_continuation。融合的链不受这个开关影响
+class InlineContinuation {
+   public:
+    // 执行vertex，然后依次执行过程中接管下来的后继vertex
+    static void run(GraphVertex* vertex);
+    // vertex ready准备调度时调用，返回true表示已经被当前线程接管，不需要再调度
+    static bool offer(GraphVertex* vertex);
+    // 融合的后继(见Graph::fuse_vertexes)ready时调用，返回true表示已经被当前线程接管，
+    // 不经过调度，直接在上游的任务里接着执行
+    static bool claim_fused(GraphVertex* vertex);
+
+    // processor的结束阶段(发布EMIT的数据)，只有在这个作用域里ready的vertex才会被接管。
+    // process中途发布的数据(例如RELEASE一个channel)仍然正常调度，保证上下游可以并发执行
+    class TailScope {
+       public:
+        TailScope();
+        ~TailScope();
+        TailScope(const TailScope&) = delete;
+        TailScope& operator=(const TailScope&) = delete;
+
+       private:
+        bool _prev_in_tail = false;
+    };
+};
+
+// 同一批ready的vertex按优先级调度
+// 作用域内变为ready的vertex先收集起来，离开最外层作用域时按优先级从高到低调度：
+// 关键路径上的vertex最先入队，开启inline continuation时由当前线程直接接着执行。
+// 在GraphData::release和Graph::run等一次可能让多个vertex ready的地方使用
+class ReadyBatch {
+   public:
+    ReadyBatch();
+    ~ReadyBatch();
+    ReadyBatch(const ReadyBatch&) = delete;
+    ReadyBatch& operator=(const ReadyBatch&) = delete;
+
+    // 返回true表示vertex已经被收集，离开作用域时统一调度
+    static bool collect(GraphVertex* vertex);
+};
+
 class GraphExecutor {
    public:
     GraphExecutor() = default;
@@ -35,6 +81,8 @@ class GraphExecutor {
 
     virtual int32_t execute(GraphVertex* vertex,
                             ClosureContext* closure_context) = 0;
+    // 在executor的线程上执行一个普通任务(例如流水线stage的处理)，默认提交到共享队列的线程池
+    virtual int32_t submit(std::function<void()> task);
 };
 
 class BthreadGraphExecutor : public GraphExecutor {
@@ -45,16 +93,34 @@ class BthreadGraphExecutor : public GraphExecutor {
     }
     int32_t execute(GraphVertex* vertex,
                     ClosureContext* closure_context) override;
+    int32_t submit(std::function<void()> task) override;
 };
 
 class AsyncGraphExecutor : public GraphExecutor {
    public:
+    using ThreadPoolBackend = concurrent::ThreadPoolBackend;
+
+    explicit AsyncGraphExecutor(ThreadPoolBackend backend = ThreadPoolBackend::SHARED_QUEUE)
+            : _backend(backend) {}
+
     static GraphExecutor* instance() {
         static AsyncGraphExecutor ins;
         return &ins;
     }
+    // 按线程池后端选择executor，配合Graph::set_executor使用
+    static GraphExecutor* instance(ThreadPoolBackend backend) {
+        if (backend == ThreadPoolBackend::WORK_STEALING) {
+            static AsyncGraphExecutor work_stealing_ins(ThreadPoolBackend::WORK_STEALING);
+            return &work_stealing_ins;
+        }
+        return instance();
+    }
     int32_t execute(GraphVertex* vertex,
                     ClosureContext* closure_context) override;
+    int32_t submit(std::function<void()> task) override;
+
+   private:
+    ThreadPoolBackend _backend = ThreadPoolBackend::SHARED_QUEUE;
 };
 
 }  // namespace gflow
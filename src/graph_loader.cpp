@@ -0,0 +1,473 @@
+#include "graph_loader.h"
+#include "graph.h"
+#include "expr/expr.h"
+
+#include "rexpr/ast.hpp"
+#include "rexpr/config.hpp"
+#include "rexpr/rexpr.hpp"
+
+#include <set>
+#include <sstream>
+#include <fstream>
+#include <cstdlib>
+#include <stdexcept>
+
+namespace gflow {
+
+namespace {
+
+namespace x3 = boost::spirit::x3;
+using rexpr::ast::Rexpr;
+using rexpr::ast::RexpValue;
+
+struct DependConfig {
+    std::string var_name;
+    std::string data_name;
+    std::string condition;
+    bool is_speculative = false;
+    bool is_optional = false;
+    int64_t timeout_ms = 0;
+};
+
+struct VertexConfig {
+    std::string name;
+    std::string processor;
+    std::vector<DependConfig> depends;
+    // var name -> data name
+    std::vector<std::pair<std::string, std::string>> emits;
+    GraphLoader::VertexOption option;
+    bool has_option = false;
+};
+
+struct GraphConfig {
+    std::set<std::string> inputs;
+    bool inline_continuation = false;
+    bool vertex_fusion = false;
+    bool data_recycle = false;
+    std::vector<VertexConfig> vertexes;
+};
+
+const std::string *as_string(const RexpValue &value) {
+    return boost::get<std::string>(&value.get());
+}
+
+const Rexpr *as_object(const RexpValue &value) {
+    auto *object = boost::get<x3::forward_ast<Rexpr>>(&value.get());
+    return object == nullptr ? nullptr : &object->get();
+}
+
+bool parse_rexpr(const std::string &content, Rexpr *ast) {
+    using rexpr::parser::IteratorType;
+    IteratorType iter = content.begin();
+    IteratorType const end = content.end();
+    std::stringstream error_out;
+    rexpr::parser::ErrorHandlerType error_handler(iter, end, error_out);
+    auto const parser = x3::with<rexpr::parser::error_handler_tag>(std::ref(error_handler))[rexpr::rexpr()];
+    bool success = x3::phrase_parse(iter, end, parser, x3::ascii::space, *ast);
+    if (success && iter != end) {
+        error_handler(iter, "Error! Expecting end of input here: ");
+        success = false;
+    }
+    if (!success) {
+        LOG(WARNING) << "GraphLoader parse failed: " << error_out.str();
+    }
+    return success;
+}
+
+// 检查object只包含允许的字段
+bool check_keys(const Rexpr &object, const std::set<std::string> &keys, const std::string &where) {
+    for (auto &[key, value] : object.entries) {
+        if (keys.count(key) == 0) {
+            LOG(WARNING) << "GraphLoader unknown key[" << key << "] in " << where;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool parse_bool(const std::string &text, bool *value, const std::string &where) {
+    if (text == "true" || text == "false") {
+        *value = (text == "true");
+        return true;
+    }
+    LOG(WARNING) << "GraphLoader " << where << " expect true or false, got:" << text;
+    return false;
+}
+
+// 字符串的字段，不存在时不修改value
+bool get_string(const Rexpr &object, const std::string &key, std::string *value, const std::string &where) {
+    auto iter = object.entries.find(key);
+    if (iter == object.entries.end()) {
+        return true;
+    }
+    const std::string *text = as_string(iter->second);
+    if (text == nullptr) {
+        LOG(WARNING) << "GraphLoader " << where << "." << key << " should be a string";
+        return false;
+    }
+    *value = *text;
+    return true;
+}
+
+// 值都是字符串的object，不存在时返回空
+bool get_string_map(const Rexpr &object, const std::string &key,
+                    std::map<std::string, std::string> *values, const std::string &where) {
+    auto iter = object.entries.find(key);
+    if (iter == object.entries.end()) {
+        return true;
+    }
+    const Rexpr *map_object = as_object(iter->second);
+    if (map_object == nullptr) {
+        LOG(WARNING) << "GraphLoader " << where << "." << key << " should be an object";
+        return false;
+    }
+    for (auto &[name, value] : map_object->entries) {
+        const std::string *text = as_string(value);
+        if (text == nullptr) {
+            LOG(WARNING) << "GraphLoader " << where << "." << key << "." << name << " should be a string";
+            return false;
+        }
+        values->emplace(name, *text);
+    }
+    return true;
+}
+
+bool parse_depend(const std::string &var_name, const RexpValue &value, const std::string &where,
+                  DependConfig *depend) {
+    depend->var_name = var_name;
+    if (const std::string *data_name = as_string(value)) {
+        depend->data_name = *data_name;
+        return true;
+    }
+    const Rexpr &object = *as_object(value);
+    std::string speculate = "false";
+    std::string optional = "false";
+    std::string timeout_ms = "0";
+    if (!check_keys(object, {"data", "when", "speculate", "optional", "timeout_ms"}, where)
+            || !get_string(object, "data", &depend->data_name, where)
+            || !get_string(object, "when", &depend->condition, where)
+            || !get_string(object, "speculate", &speculate, where)
+            || !get_string(object, "optional", &optional, where)
+            || !get_string(object, "timeout_ms", &timeout_ms, where)
+            || !parse_bool(speculate, &depend->is_speculative, where + ".speculate")
+            || !parse_bool(optional, &depend->is_optional, where + ".optional")) {
+        return false;
+    }
+    if (depend->data_name.empty()) {
+        LOG(WARNING) << "GraphLoader " << where << " missing data";
+        return false;
+    }
+    char *end = nullptr;
+    depend->timeout_ms = std::strtoll(timeout_ms.c_str(), &end, 10);
+    if (timeout_ms.empty() || *end != '\0' || depend->timeout_ms < 0) {
+        LOG(WARNING) << "GraphLoader " << where << ".timeout_ms invalid:" << timeout_ms;
+        return false;
+    }
+    if (depend->is_speculative && depend->condition.empty()) {
+        LOG(WARNING) << "GraphLoader " << where << " speculate only works with when";
+        return false;
+    }
+    if (depend->timeout_ms > 0 && !depend->is_optional) {
+        LOG(WARNING) << "GraphLoader " << where << " timeout_ms only works with optional";
+        return false;
+    }
+    return true;
+}
+
+bool parse_vertex(const std::string &name, const Rexpr &object, VertexConfig *vertex) {
+    std::string where = "vertex[" + name + "]";
+    vertex->name = name;
+    std::map<std::string, std::string> emits;
+    if (!check_keys(object, {"processor", "depends", "emits", "option"}, where)
+            || !get_string(object, "processor", &vertex->processor, where)
+            || !get_string_map(object, "emits", &emits, where)
+            || !get_string_map(object, "option", &vertex->option, where)) {
+        return false;
+    }
+    if (vertex->processor.empty()) {
+        LOG(WARNING) << "GraphLoader " << where << " missing processor";
+        return false;
+    }
+    if (!ProcessorFactory::instance().get_creator(vertex->processor)) {
+        LOG(WARNING) << "GraphLoader " << where << " unknown processor:" << vertex->processor;
+        return false;
+    }
+    vertex->has_option = object.entries.count("option") > 0;
+    vertex->emits.assign(emits.begin(), emits.end());
+    auto iter = object.entries.find("depends");
+    if (iter != object.entries.end()) {
+        const Rexpr *depends = as_object(iter->second);
+        if (depends == nullptr) {
+            LOG(WARNING) << "GraphLoader " << where << ".depends should be an object";
+            return false;
+        }
+        for (auto &[var_name, value] : depends->entries) {
+            DependConfig depend;
+            if (!parse_depend(var_name, value, where + ".depends." + var_name, &depend)) {
+                return false;
+            }
+            vertex->depends.emplace_back(std::move(depend));
+        }
+    }
+    // 绑定的变量名不能重复
+    for (auto &[var_name, data_name] : vertex->emits) {
+        for (auto &depend : vertex->depends) {
+            if (depend.var_name == var_name) {
+                LOG(WARNING) << "GraphLoader " << where << " duplicated var name:" << var_name;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+bool parse_graph(const Rexpr &root, GraphConfig *graph) {
+    std::map<std::string, std::string> inputs;
+    std::map<std::string, std::string> options;
+    if (!check_keys(root, {"inputs", "options", "vertexes"}, "graph")
+            || !get_string_map(root, "inputs", &inputs, "graph")
+            || !get_string_map(root, "options", &options, "graph")) {
+        return false;
+    }
+    for (auto &[name, description] : inputs) {
+        graph->inputs.emplace(name);
+    }
+    for (auto &[key, value] : options) {
+        bool *option = nullptr;
+        if (key == "inline_continuation") {
+            option = &graph->inline_continuation;
+        } else if (key == "vertex_fusion") {
+            option = &graph->vertex_fusion;
+        } else if (key == "data_recycle") {
+            option = &graph->data_recycle;
+        } else {
+            LOG(WARNING) << "GraphLoader unknown graph option:" << key;
+            return false;
+        }
+        if (!parse_bool(value, option, "graph.options." + key)) {
+            return false;
+        }
+    }
+    auto iter = root.entries.find("vertexes");
+    const Rexpr *vertexes = iter == root.entries.end() ? nullptr : as_object(iter->second);
+    if (vertexes == nullptr || vertexes->entries.empty()) {
+        LOG(WARNING) << "GraphLoader graph.vertexes should be a non-empty object";
+        return false;
+    }
+    for (auto &[name, value] : vertexes->entries) {
+        const Rexpr *object = as_object(value);
+        if (object == nullptr) {
+            LOG(WARNING) << "GraphLoader vertex[" << name << "] should be an object";
+            return false;
+        }
+        VertexConfig vertex;
+        if (!parse_vertex(name, *object, &vertex)) {
+            return false;
+        }
+        graph->vertexes.emplace_back(std::move(vertex));
+    }
+    return true;
+}
+
+// 检查data的来源、条件表达式和环
+bool validate(const GraphConfig &graph) {
+    // data name -> 生产者在vertexes中的下标
+    std::unordered_map<std::string, size_t> producers;
+    for (size_t i = 0; i < graph.vertexes.size(); ++i) {
+        for (auto &[var_name, data_name] : graph.vertexes[i].emits) {
+            if (graph.inputs.count(data_name)) {
+                LOG(WARNING) << "GraphLoader data[" << data_name << "] is an input, can't be emitted by vertex["
+                             << graph.vertexes[i].name << "]";
+                return false;
+            }
+            auto [iter, inserted] = producers.emplace(data_name, i);
+            if (!inserted) {
+                LOG(WARNING) << "GraphLoader data[" << data_name << "] emitted by both vertex["
+                             << graph.vertexes[iter->second].name << "] and vertex["
+                             << graph.vertexes[i].name << "]";
+                return false;
+            }
+        }
+    }
+    // 上游vertex的下标，外部输入返回false
+    std::vector<std::vector<size_t>> downstreams(graph.vertexes.size());
+    std::vector<size_t> upstream_num(graph.vertexes.size(), 0);
+    auto add_edge = [&](const std::string &data_name, size_t vertex_idx, const std::string &where) {
+        auto iter = producers.find(data_name);
+        if (iter == producers.end()) {
+            if (graph.inputs.count(data_name) == 0) {
+                LOG(WARNING) << "GraphLoader " << where << " depends on data[" << data_name
+                             << "] which is neither emitted nor an input";
+                return false;
+            }
+            return true;
+        }
+        downstreams[iter->second].emplace_back(vertex_idx);
+        upstream_num[vertex_idx]++;
+        return true;
+    };
+    for (size_t i = 0; i < graph.vertexes.size(); ++i) {
+        std::string where = "vertex[" + graph.vertexes[i].name + "]";
+        for (const DependConfig &depend : graph.vertexes[i].depends) {
+            if (!add_edge(depend.data_name, i, where)) {
+                return false;
+            }
+            if (depend.condition.empty()) {
+                continue;
+            }
+            Expr expr;
+            client::ast::FinalResult ast;
+            std::vector<std::string> var_names;
+            if (!expr.parse(depend.condition, ast) || !expr.var_analyze(ast, &var_names)) {
+                LOG(WARNING) << "GraphLoader " << where << " invalid condition:" << depend.condition;
+                return false;
+            }
+            for (const std::string &var_name : var_names) {
+                if (!add_edge(var_name, i, where + " condition")) {
+                    return false;
+                }
+            }
+        }
+    }
+    // 拓扑排序，剩下的vertex在环上
+    std::vector<size_t> ready;
+    for (size_t i = 0; i < graph.vertexes.size(); ++i) {
+        if (upstream_num[i] == 0) {
+            ready.emplace_back(i);
+        }
+    }
+    size_t sorted_num = 0;
+    while (!ready.empty()) {
+        size_t vertex_idx = ready.back();
+        ready.pop_back();
+        sorted_num++;
+        for (size_t downstream : downstreams[vertex_idx]) {
+            if (--upstream_num[downstream] == 0) {
+                ready.emplace_back(downstream);
+            }
+        }
+    }
+    if (sorted_num != graph.vertexes.size()) {
+        for (size_t i = 0; i < graph.vertexes.size(); ++i) {
+            if (upstream_num[i] != 0) {
+                LOG(WARNING) << "GraphLoader vertex[" << graph.vertexes[i].name << "] is in a cycle";
+                break;
+            }
+        }
+        return false;
+    }
+    return true;
+}
+
+}  // namespace
+
+std::shared_ptr<const GraphTemplate> GraphLoader::compile(const std::string &content) {
+    Rexpr root;
+    GraphConfig config;
+    if (!parse_rexpr(content, &root) || !parse_graph(root, &config) || !validate(config)) {
+        return nullptr;
+    }
+    Graph prototype;
+    prototype.set_inline_continuation(config.inline_continuation);
+    prototype.set_vertex_fusion(config.vertex_fusion);
+    prototype.set_data_recycle(config.data_recycle);
+    for (const std::string &input : config.inputs) {
+        prototype.create_data(input);
+    }
+    for (const VertexConfig &vertex_config : config.vertexes) {
+        GraphVertex *vertex = prototype.add_vertex(vertex_config.processor);
+        for (const DependConfig &depend : vertex_config.depends) {
+            GraphDependency *dependency = depend.is_optional
+                                            ? vertex->optional_depend_and_bind(depend.data_name, depend.var_name)
+                                            : vertex->depend_and_bind(depend.data_name, depend.var_name);
+            if (depend.timeout_ms > 0) {
+                dependency->timeout(depend.timeout_ms);
+            }
+            if (!depend.condition.empty()) {
+                dependency->when(depend.condition);
+            }
+            if (depend.is_speculative) {
+                dependency->speculate();
+            }
+        }
+        for (auto &[var_name, data_name] : vertex_config.emits) {
+            vertex->emit_and_bind(data_name, var_name);
+        }
+        if (vertex_config.has_option) {
+            vertex->set_option(VertexOption(vertex_config.option));
+        }
+    }
+    // processor在setup时按变量名查找绑定的data，配置里的变量名和processor声明的不一致时抛出异常
+    try {
+        prototype.build();
+    } catch (const std::exception &e) {
+        LOG(WARNING) << "GraphLoader build graph failed:" << e.what();
+        return nullptr;
+    }
+    auto tpl = GraphTemplate::compile(prototype);
+    if (tpl == nullptr) {
+        LOG(WARNING) << "GraphLoader compile graph template failed";
+        return nullptr;
+    }
+    LOG(TRACE) << "GraphLoader compile done vertex_size:" << tpl->vertex_size();
+    return tpl;
+}
+
+std::shared_ptr<const GraphTemplate> GraphLoader::load(const std::string &content) {
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        auto iter = _templates.find(content);
+        if (iter != _templates.end()) {
+            if (auto tpl = iter->second.lock()) {
+                return tpl;
+            }
+        }
+    }
+    // 编译不持有锁，并发加载同一份配置时以先写入缓存的为准
+    auto tpl = compile(content);
+    if (tpl == nullptr) {
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    // 顺便清理已经没有人使用的模板，热更新替换掉的旧配置不会一直留在缓存里
+    for (auto iter = _templates.begin(); iter != _templates.end();) {
+        if (iter->second.expired() && iter->first != content) {
+            iter = _templates.erase(iter);
+        } else {
+            ++iter;
+        }
+    }
+    auto &cached = _templates[content];
+    if (auto existed = cached.lock()) {
+        return existed;
+    }
+    cached = tpl;
+    return tpl;
+}
+
+std::shared_ptr<const GraphTemplate> GraphLoader::load_file(const std::string &path) {
+    std::ifstream in(path);
+    if (!in) {
+        LOG(WARNING) << "GraphLoader open file failed:" << path;
+        return nullptr;
+    }
+    std::stringstream content;
+    content << in.rdbuf();
+    return load(content.str());
+}
+
+size_t GraphLoader::cache_size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    size_t size = 0;
+    for (const auto &kv : _templates) {
+        size += kv.second.expired() ? 0 : 1;
+    }
+    return size;
+}
+
+void GraphLoader::clear() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _templates.clear();
+}
+
+}  // namespace gflow
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <unordered_map>
+
+#include "graph_template.h"
+
+namespace gflow {
+
+// 从rexpr格式的配置加载图，编译成GraphTemplate。
+// 解析、校验和编译的结果按配置内容缓存，同一份配置创建再多的图也只解析一次，
+// 条件表达式也只在编译时解析一次，实例共享解析好的表达式。
+//
+// 配置格式：
+// {
+//     "inputs" = {                    // 外部输入的data，值只是说明。rexpr的字符串只支持ascii
+//         "REQUEST" = "request"
+//     }
+//     "options" = {                   // 可选，图的选项
+//         "inline_continuation" = "true"
+//         "vertex_fusion" = "true"   // 默认关闭，见Graph::fuse_vertexes
+//         "data_recycle" = "true"     // 见Graph::set_data_recycle
+//     }
+//     "vertexes" = {                  // key是vertex在配置里的名字，只用于报错
+//         "recall" = {
+//             "processor" = "RecallProcessor"       // REGISTER_PROCESSOR注册的名字
+//             "depends" = {                         // key是processor里的变量名，值是data名
+//                 "request" = "REQUEST"
+//                 "user" = {                        // 也可以是详细的依赖配置
+//                     "data" = "USER"
+//                     "when" = "FLAG == 1"          // 条件表达式，见GraphDependency::when
+//                     "speculate" = "true"          // 需要when
+//                     "optional" = "true"           // optional依赖通过get_optional_dependencys访问
+//                     "timeout_ms" = "30"           // 需要optional
+//                 }
+//             }
+//             "emits" = {                           // key是变量名，值是data名
+//                 "mids" = "RECALL_RESULT"
+//             }
+//             "option" = {                          // 以std::map<std::string, std::string>设置为vertex的option
+//                 "limit" = "100"
+//             }
+//         }
+//     }
+// }
+//
+// 校验失败(语法错误、未知的字段或者processor、data有多个生产者、依赖的data没有生产者也不是输入、
+// 条件表达式错误、vertex之间有环、变量名和processor声明的不一致)时打印原因并返回nullptr
+class GraphLoader {
+   public:
+    using VertexOption = std::map<std::string, std::string>;
+
+    static GraphLoader &instance() {
+        static GraphLoader _instance;
+        return _instance;
+    }
+
+    GraphLoader() = default;
+    // 禁止拷贝和移动
+    GraphLoader(GraphLoader &&) = delete;
+    GraphLoader(const GraphLoader &) = delete;
+    GraphLoader &operator=(GraphLoader &&) = delete;
+    GraphLoader &operator=(const GraphLoader &) = delete;
+
+    // 内容相同的配置返回同一个模板。缓存不持有模板，没有人使用之后下次加载重新编译
+    std::shared_ptr<const GraphTemplate> load(const std::string &content);
+    // 读取文件后按内容加载，文件修改之后会重新编译
+    std::shared_ptr<const GraphTemplate> load_file(const std::string &path);
+    // 缓存中还在使用的模板个数
+    size_t cache_size();
+    void clear();
+
+   private:
+    // 不使用缓存，解析、校验并编译
+    static std::shared_ptr<const GraphTemplate> compile(const std::string &content);
+
+    std::mutex _mutex;
+    // 弱引用，模板的生命周期由使用者(例如VersionedGraph的各个版本)决定
+    std::unordered_map<std::string, std::weak_ptr<const GraphTemplate>> _templates;
+};
+
+}  // namespace gflow
@@ -0,0 +1,215 @@
+#include "graph_pool.h"
+
+#include <mutex>
+#include <unordered_set>
+
+namespace gflow {
+
+namespace {
+
+// 存活的池子，线程退出时需要清空它们里面这个线程的本地缓存
+struct PoolRegistry {
+    std::mutex mutex;
+    std::unordered_set<GraphPool *> pools;
+    // 本地缓存的下标是否被存活的线程占用
+    std::atomic<bool> used_idx[GraphPool::MAX_THREAD_CACHE_NUM] = {};
+};
+
+// 线程退出时可能已经在析构静态对象，不释放
+PoolRegistry &pool_registry() {
+    static PoolRegistry *registry = new PoolRegistry;
+    return *registry;
+}
+
+// 栈顶由(版本号 << 32 | (下标 + 1))组成，0表示空栈
+inline uint64_t make_head(uint64_t version, uint32_t idx) {
+    return (version << 32) | (static_cast<uint64_t>(idx) + 1);
+}
+
+inline uint32_t head_idx(uint64_t head) {
+    return static_cast<uint32_t>(head) - 1;
+}
+
+inline bool head_is_empty(uint64_t head) {
+    return static_cast<uint32_t>(head) == 0;
+}
+
+}  // namespace
+
+// 每个线程占用一个下标，用来定位自己在各个GraphPool里的本地缓存，线程退出时归还
+class GraphPool::ThreadCacheIdxOwner {
+   public:
+    ThreadCacheIdxOwner() : idx(acquire_idx()) {}
+    ~ThreadCacheIdxOwner() {
+        if (idx < MAX_THREAD_CACHE_NUM) {
+            // 先把缓存的实例还回去，再让别的线程复用下标
+            flush_thread_caches(idx);
+            pool_registry().used_idx[idx].store(false, std::memory_order_release);
+        }
+    }
+    // 禁止拷贝和移动
+    ThreadCacheIdxOwner(ThreadCacheIdxOwner &&) = delete;
+    ThreadCacheIdxOwner(const ThreadCacheIdxOwner &) = delete;
+    ThreadCacheIdxOwner &operator=(ThreadCacheIdxOwner &&) = delete;
+    ThreadCacheIdxOwner &operator=(const ThreadCacheIdxOwner &) = delete;
+
+    // 没有空闲的下标时为MAX_THREAD_CACHE_NUM
+    const size_t idx;
+
+   private:
+    static size_t acquire_idx() {
+        auto &used_idx = pool_registry().used_idx;
+        for (size_t i = 0; i < MAX_THREAD_CACHE_NUM; ++i) {
+            if (!used_idx[i].load(std::memory_order_relaxed)
+                    && !used_idx[i].exchange(true, std::memory_order_acquire)) {
+                return i;
+            }
+        }
+        return MAX_THREAD_CACHE_NUM;
+    }
+};
+
+GraphPool::GraphPool(std::shared_ptr<const GraphTemplate> graph_template, size_t initial_size)
+    : _template(std::move(graph_template)),
+      _thread_caches(new ThreadCache[MAX_THREAD_CACHE_NUM]) {
+    for (size_t i = 0; i < initial_size; ++i) {
+        push(create_instance());
+    }
+    PoolRegistry &registry = pool_registry();
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    registry.pools.insert(this);
+}
+
+GraphPool::~GraphPool() {
+    {
+        PoolRegistry &registry = pool_registry();
+        std::lock_guard<std::mutex> lock(registry.mutex);
+        registry.pools.erase(this);
+    }
+    uint32_t size = _size.load(std::memory_order_acquire);
+    for (uint32_t idx = 0; idx < size; ++idx) {
+        delete node(idx).graph;
+    }
+    for (auto &segment : _segments) {
+        delete[] segment.load(std::memory_order_relaxed);
+    }
+}
+
+uint32_t GraphPool::create_instance() {
+    GraphInstance *graph = _template->create_instance();
+    uint32_t idx = _size.fetch_add(1, std::memory_order_acq_rel);
+    size_t segment_idx = idx / SEGMENT_SIZE;
+    if (segment_idx >= MAX_SEGMENT_NUM) {
+        LOG(FATAL) << "GraphPool too many instances size:" << idx;
+        ::abort();
+    }
+    if (_segments[segment_idx].load(std::memory_order_acquire) == nullptr) {
+        Node *expected = nullptr;
+        Node *segment = new Node[SEGMENT_SIZE];
+        if (!_segments[segment_idx].compare_exchange_strong(expected, segment,
+                                                            std::memory_order_acq_rel)) {
+            delete[] segment;
+        }
+    }
+    graph->_pool_idx = idx;
+    node(idx).graph = graph;
+    LOG(TRACE) << "GraphPool create instance idx:" << idx;
+    return idx;
+}
+
+void GraphPool::push(uint32_t idx) {
+    Node &n = node(idx);
+    uint64_t head = _head.load(std::memory_order_relaxed);
+    while (true) {
+        n.next.store(head_is_empty(head) ? INVALID_IDX : head_idx(head), std::memory_order_relaxed);
+        if (_head.compare_exchange_weak(head, make_head((head >> 32) + 1, idx),
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+            return;
+        }
+    }
+}
+
+uint32_t GraphPool::pop() {
+    uint64_t head = _head.load(std::memory_order_acquire);
+    while (!head_is_empty(head)) {
+        uint32_t next = node(head_idx(head)).next.load(std::memory_order_relaxed);
+        uint64_t new_head = (next == INVALID_IDX) ? ((head >> 32) + 1) << 32
+                                                  : make_head((head >> 32) + 1, next);
+        if (_head.compare_exchange_weak(head, new_head,
+                                        std::memory_order_acquire,
+                                        std::memory_order_acquire)) {
+            return head_idx(head);
+        }
+    }
+    return INVALID_IDX;
+}
+
+GraphPool::ThreadCache *GraphPool::thread_cache() {
+    thread_local ThreadCacheIdxOwner owner;
+    if (owner.idx >= MAX_THREAD_CACHE_NUM) {
+        return nullptr;
+    }
+    return &_thread_caches[owner.idx];
+}
+
+void GraphPool::flush_thread_caches(size_t cache_idx) {
+    PoolRegistry &registry = pool_registry();
+    // 持有锁期间池子不会析构
+    std::lock_guard<std::mutex> lock(registry.mutex);
+    for (GraphPool *pool : registry.pools) {
+        ThreadCache &cache = pool->_thread_caches[cache_idx];
+        while (cache.size > 0) {
+            pool->push(cache.slots[--cache.size]);
+        }
+    }
+}
+
+GraphInstance *GraphPool::acquire() {
+    ThreadCache *cache = thread_cache();
+    if (likely(cache != nullptr)) {
+        cache->acquire_num.store(cache->acquire_num.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+        if (cache->size > 0) {
+            cache->hit_num.store(cache->hit_num.load(std::memory_order_relaxed) + 1,
+                                 std::memory_order_relaxed);
+            return node(cache->slots[--cache->size]).graph;
+        }
+    } else {
+        _uncached_acquire_num.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint32_t idx = pop();
+    if (unlikely(idx == INVALID_IDX)) {
+        _miss_num.fetch_add(1, std::memory_order_relaxed);
+        idx = create_instance();
+    }
+    return node(idx).graph;
+}
+
+void GraphPool::release(GraphInstance *graph) {
+    DCHECK(graph != nullptr && graph->get_template() == _template);
+    // 在归还的时候reset，下一次acquire不需要再做任何准备工作
+    graph->reset();
+    uint32_t idx = graph->_pool_idx;
+    ThreadCache *cache = thread_cache();
+    if (likely(cache != nullptr) && cache->size < THREAD_CACHE_SIZE) {
+        cache->slots[cache->size++] = idx;
+        return;
+    }
+    push(idx);
+}
+
+GraphPool::Stats GraphPool::stats() {
+    Stats stats;
+    for (size_t i = 0; i < MAX_THREAD_CACHE_NUM; ++i) {
+        stats.acquire_num += _thread_caches[i].acquire_num.load(std::memory_order_relaxed);
+        stats.thread_cache_hit_num += _thread_caches[i].hit_num.load(std::memory_order_relaxed);
+    }
+    stats.acquire_num += _uncached_acquire_num.load(std::memory_order_relaxed);
+    stats.miss_num = _miss_num.load(std::memory_order_relaxed);
+    stats.size = _size.load(std::memory_order_relaxed);
+    return stats;
+}
+
+}  // namespace gflow
@@ -0,0 +1,95 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <vector>
+
+#include "graph.h"
+#include "graph_template.h"
+#include "concurrent/concurrent_bounded_queue.h"
+
+namespace gflow {
+
+// 从同一个GraphTemplate预先创建好的图实例池
+// * 空闲实例放在无锁的freelist(带版本号的Treiber栈，避免ABA问题)
+// * 每个线程有一个小的本地缓存，大部分acquire/release不需要碰共享的栈顶。
+//   线程退出时本地缓存里的实例放回共享的栈，缓存的下标给之后创建的线程复用
+// * 实例在归还时reset，acquire拿到的总是可以直接run的实例
+// * 突发流量下实例不够用时按需创建(记一次miss)，之后常驻在池子里
+//
+// 使用示例：
+// GraphPool pool(tpl, 100);
+// GraphInstance* g = pool.acquire();
+// ... g->run(data) ...
+// pool.release(g);
+class GraphPool {
+   public:
+    static constexpr size_t THREAD_CACHE_SIZE = 7;
+    // 同时存在的线程数超过上限时，多出来的线程不使用本地缓存
+    static constexpr size_t MAX_THREAD_CACHE_NUM = 256;
+
+    struct Stats {
+        uint64_t acquire_num = 0;
+        // freelist为空，新创建实例的次数
+        uint64_t miss_num = 0;
+        // 直接从线程本地缓存拿到实例的次数
+        uint64_t thread_cache_hit_num = 0;
+        // 池子创建过的实例总数
+        size_t size = 0;
+    };
+
+    GraphPool(std::shared_ptr<const GraphTemplate> graph_template, size_t initial_size);
+    // 禁止拷贝和移动
+    inline GraphPool(GraphPool &&) = delete;
+    inline GraphPool(const GraphPool &) = delete;
+    inline GraphPool &operator=(GraphPool &&) = delete;
+    inline GraphPool &operator=(const GraphPool &) = delete;
+    // 调用者需要保证所有实例都已经归还
+    ~GraphPool();
+
+    GraphInstance *acquire();
+    // graph必须来自同一个池子，并且已经执行结束
+    void release(GraphInstance *graph);
+
+    Stats stats();
+    const std::shared_ptr<const GraphTemplate> &get_template() const { return _template; }
+
+   private:
+    static constexpr size_t SEGMENT_SIZE = 256;
+    static constexpr size_t MAX_SEGMENT_NUM = 4096;
+    static constexpr uint32_t INVALID_IDX = UINT32_MAX;
+
+    struct Node {
+        GraphInstance *graph = nullptr;
+        std::atomic<uint32_t> next{INVALID_IDX};
+    };
+
+    // 只被所属线程读写，统计数据用relaxed原子变量，方便别的线程读取
+    struct alignas(concurrent::CACHELINE_SIZE) ThreadCache {
+        uint32_t size = 0;
+        uint32_t slots[THREAD_CACHE_SIZE];
+        std::atomic<uint64_t> acquire_num{0};
+        std::atomic<uint64_t> hit_num{0};
+    };
+
+    Node &node(uint32_t idx) {
+        return _segments[idx / SEGMENT_SIZE].load(std::memory_order_acquire)[idx % SEGMENT_SIZE];
+    }
+    uint32_t create_instance();
+    void push(uint32_t idx);
+    uint32_t pop();
+    ThreadCache *thread_cache();
+    // 线程退出时调用，把所有池子里下标为cache_idx的本地缓存放回共享的栈
+    class ThreadCacheIdxOwner;
+    static void flush_thread_caches(size_t cache_idx);
+
+    std::shared_ptr<const GraphTemplate> _template;
+    std::atomic<Node *> _segments[MAX_SEGMENT_NUM] = {};
+    std::unique_ptr<ThreadCache[]> _thread_caches;
+    alignas(concurrent::CACHELINE_SIZE) std::atomic<uint64_t> _head{0};
+    alignas(concurrent::CACHELINE_SIZE) std::atomic<uint32_t> _size{0};
+    std::atomic<uint64_t> _miss_num{0};
+    std::atomic<uint64_t> _uncached_acquire_num{0};
+};
+
+}  // namespace gflow
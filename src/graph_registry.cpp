@@ -0,0 +1,151 @@
+#include "graph_registry.h"
+#include "graph_loader.h"
+
+namespace gflow {
+
+using concurrent::EpochManager;
+
+GraphHandle &GraphHandle::operator=(GraphHandle &&other) noexcept {
+    if (this != &other) {
+        reset();
+        _owner = other._owner;
+        _version = other._version;
+        _graph = other._graph;
+        other._owner = nullptr;
+        other._version = nullptr;
+        other._graph = nullptr;
+    }
+    return *this;
+}
+
+void GraphHandle::reset() {
+    if (_graph == nullptr) {
+        return;
+    }
+    _version->pool.release(_graph);
+    _graph = nullptr;
+    GraphVersion *version = _version;
+    _version = nullptr;
+    // 计数减到0之后版本随时可能被其他线程回收，不能再访问，只比较指针判断是否已经退役。
+    // 比较之后才退役的版本由发布时的回收处理；地址被新版本复用时只是推迟到下一次回收
+    if (version->active_num.fetch_sub(1, std::memory_order_seq_cst) == 1
+            && _owner->_current.load(std::memory_order_seq_cst) != version) {
+        _owner->release();
+    }
+}
+
+VersionedGraph::~VersionedGraph() {
+    delete _current.load(std::memory_order_relaxed);
+    for (GraphVersion *version : _retired) {
+        delete version;
+    }
+}
+
+uint64_t VersionedGraph::publish(std::shared_ptr<const GraphTemplate> graph_template, size_t pool_size) {
+    if (graph_template == nullptr) {
+        LOG(WARNING) << "VersionedGraph publish empty template name:" << _name;
+        return 0;
+    }
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto *version = new GraphVersion(_next_version++, std::move(graph_template), pool_size);
+    GraphVersion *old = _current.exchange(version, std::memory_order_seq_cst);
+    if (old != nullptr) {
+        // 推进epoch之后进入临界区的读者只能看到新版本
+        old->retire_epoch.store(_epoch_manager.advance(), std::memory_order_release);
+        _retired.emplace_back(old);
+    }
+    size_t reclaim_num = reclaim_locked();
+    LOG(NOTICE) << "VersionedGraph publish name:" << _name << " version:" << version->version
+                << " pool_size:" << pool_size << " reclaim_num:" << reclaim_num
+                << " retired_size:" << _retired.size();
+    return version->version;
+}
+
+GraphHandle VersionedGraph::acquire() {
+    GraphVersion *version = nullptr;
+    {
+        EpochManager::Guard guard(_epoch_manager);
+        version = _current.load(std::memory_order_seq_cst);
+        if (version == nullptr) {
+            return GraphHandle();
+        }
+        version->active_num.fetch_add(1, std::memory_order_seq_cst);
+    }
+    return GraphHandle(this, version, version->pool.acquire());
+}
+
+size_t VersionedGraph::reclaim() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return reclaim_locked();
+}
+
+size_t VersionedGraph::reclaim_locked() {
+    size_t reclaim_num = 0;
+    for (size_t i = 0; i < _retired.size();) {
+        GraphVersion *version = _retired[i];
+        // 先确认不会再有读者拿到这个版本，再检查引用计数，反过来的话临界区里的读者可能在检查之后才增加计数
+        if (_epoch_manager.is_safe(version->retire_epoch.load(std::memory_order_acquire))
+                && version->active_num.load(std::memory_order_seq_cst) == 0) {
+            LOG(TRACE) << "VersionedGraph reclaim name:" << _name << " version:" << version->version;
+            delete version;
+            _retired[i] = _retired.back();
+            _retired.pop_back();
+            ++reclaim_num;
+        } else {
+            ++i;
+        }
+    }
+    return reclaim_num;
+}
+
+void VersionedGraph::release() {
+    reclaim();
+}
+
+uint64_t VersionedGraph::version() const {
+    EpochManager::Guard guard(_epoch_manager);
+    GraphVersion *version = _current.load(std::memory_order_seq_cst);
+    return version == nullptr ? 0 : version->version;
+}
+
+std::shared_ptr<const GraphTemplate> VersionedGraph::get_template() const {
+    EpochManager::Guard guard(_epoch_manager);
+    GraphVersion *version = _current.load(std::memory_order_seq_cst);
+    return version == nullptr ? nullptr : version->pool.get_template();
+}
+
+size_t VersionedGraph::retired_size() {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _retired.size();
+}
+
+VersionedGraph *GraphRegistry::get_or_create(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto &graph = _graphs[name];
+    if (graph == nullptr) {
+        graph.reset(new VersionedGraph(name));
+    }
+    return graph.get();
+}
+
+VersionedGraph *GraphRegistry::get(const std::string &name) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    auto iter = _graphs.find(name);
+    return iter == _graphs.end() ? nullptr : iter->second.get();
+}
+
+uint64_t GraphRegistry::reload(const std::string &name, const std::string &content, size_t pool_size) {
+    auto graph_template = GraphLoader::instance().load(content);
+    if (graph_template == nullptr) {
+        LOG(WARNING) << "GraphRegistry reload failed name:" << name;
+        return 0;
+    }
+    VersionedGraph *graph = get_or_create(name);
+    // 相同的配置从GraphLoader拿到同一个模板
+    if (graph->get_template() == graph_template) {
+        return graph->version();
+    }
+    return graph->publish(std::move(graph_template), pool_size);
+}
+
+}  // namespace gflow
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+#include <unordered_map>
+
+#include "graph_pool.h"
+#include "graph_template.h"
+#include "concurrent/epoch.h"
+
+namespace gflow {
+
+class VersionedGraph;
+
+// 某个版本的图：编译好的模板和预先创建好实例的池子，发布时创建，请求路径上不再建池
+struct GraphVersion {
+    GraphVersion(uint64_t version, std::shared_ptr<const GraphTemplate> graph_template, size_t pool_size)
+        : version(version), pool(std::move(graph_template), pool_size) {}
+
+    uint64_t version = 0;
+    GraphPool pool;
+    // 正在使用这个版本的请求数
+    std::atomic<uint64_t> active_num{0};
+    // 被新版本替换的epoch，还是当前版本时为QUIESCENT
+    std::atomic<uint64_t> retire_epoch{concurrent::EpochManager::QUIESCENT};
+};
+
+// 请求持有的图实例，析构时把实例还给所属版本的池子。
+// 析构前图必须已经执行结束；持有期间图的版本不会被回收，即使已经发布了新版本
+class GraphHandle {
+   public:
+    GraphHandle() = default;
+    GraphHandle(VersionedGraph *owner, GraphVersion *version, GraphInstance *graph)
+        : _owner(owner), _version(version), _graph(graph) {}
+    ~GraphHandle() { reset(); }
+
+    GraphHandle(GraphHandle &&other) noexcept { *this = std::move(other); }
+    GraphHandle &operator=(GraphHandle &&other) noexcept;
+    // 禁止拷贝
+    GraphHandle(const GraphHandle &) = delete;
+    GraphHandle &operator=(const GraphHandle &) = delete;
+
+    GraphInstance *get() const { return _graph; }
+    GraphInstance *operator->() const { return _graph; }
+    explicit operator bool() const { return _graph != nullptr; }
+    // 没有实例时返回0
+    uint64_t version() const { return _version == nullptr ? 0 : _version->version; }
+    // 归还实例
+    void reset();
+
+   private:
+    VersionedGraph *_owner = nullptr;
+    GraphVersion *_version = nullptr;
+    GraphInstance *_graph = nullptr;
+};
+
+// 一个可以热更新的图：当前版本通过原子指针替换(RCU)。
+// * acquire只在很短的epoch临界区里读取当前版本并增加引用计数，不加锁，发布新版本时也不会停顿
+// * 正在执行的请求继续使用旧版本直到结束，新请求拿到新版本
+// * 被替换的版本在epoch推进之后(不会再有读者看到它)并且没有请求在使用时回收，
+//   回收发生在发布新版本、最后一个使用退役版本的请求结束或者调用reclaim时
+class VersionedGraph {
+   public:
+    explicit VersionedGraph(std::string name) : _name(std::move(name)) {}
+    // 禁止拷贝和移动
+    VersionedGraph(VersionedGraph &&) = delete;
+    VersionedGraph(const VersionedGraph &) = delete;
+    VersionedGraph &operator=(VersionedGraph &&) = delete;
+    VersionedGraph &operator=(const VersionedGraph &) = delete;
+    // 调用者需要保证所有GraphHandle都已经释放
+    ~VersionedGraph();
+
+    // 发布新版本，在调用线程上预先创建pool_size个实例，返回新的版本号，模板为空时返回0
+    uint64_t publish(std::shared_ptr<const GraphTemplate> graph_template, size_t pool_size);
+    // 还没有发布过版本时返回空的GraphHandle
+    GraphHandle acquire();
+    // 回收已经没有读者的退役版本，返回回收的个数
+    size_t reclaim();
+
+    const std::string &name() const { return _name; }
+    // 当前版本号，还没有发布过时为0
+    uint64_t version() const;
+    std::shared_ptr<const GraphTemplate> get_template() const;
+    // 已经被替换但还没有回收的版本数
+    size_t retired_size();
+
+   private:
+    friend class GraphHandle;
+
+    // 最后一个使用退役版本的请求结束时调用
+    void release();
+    size_t reclaim_locked();
+
+    std::string _name;
+    std::atomic<GraphVersion *> _current{nullptr};
+    mutable concurrent::EpochManager _epoch_manager;
+    // 保护发布和回收
+    std::mutex _mutex;
+    uint64_t _next_version = 1;
+    std::vector<GraphVersion *> _retired;
+};
+
+// 全局的热更新图，按名字创建，VersionedGraph创建后不会删除，调用方可以缓存指针避免每次查找
+//
+// 使用示例：
+// auto* graph = GraphRegistry::instance().get_or_create("recall");
+// graph->publish(GraphLoader::instance().load(content), 100);
+// ...
+// GraphHandle g = graph->acquire();
+// auto* closure_context = g->run(g->get_data("RESULT"));
+// closure_context->wait_finish();
+class GraphRegistry {
+   public:
+    static GraphRegistry &instance() {
+        static GraphRegistry _instance;
+        return _instance;
+    }
+
+    VersionedGraph *get_or_create(const std::string &name);
+    // 不存在返回nullptr
+    VersionedGraph *get(const std::string &name);
+    // 通过GraphLoader加载配置并发布，配置没有变化时不发布新版本，返回当前版本号，加载失败返回0
+    uint64_t reload(const std::string &name, const std::string &content, size_t pool_size);
+
+   private:
+    std::mutex _mutex;
+    std::unordered_map<std::string, std::unique_ptr<VersionedGraph>> _graphs;
+};
+
+}  // namespace gflow
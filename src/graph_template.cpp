@@ -0,0 +1,127 @@
+#include "graph_template.h"
+#include "graph.h"
+#include "dependency.h"
+#include "data.h"
+
+#include <algorithm>
+
+namespace gflow {
+
+uint32_t GraphTemplate::ensure_data_idx(GraphData *data) {
+    auto iter = _data_idx_map.find(data->get_name());
+    if (iter != _data_idx_map.end()) {
+        return iter->second;
+    }
+    uint32_t idx = _data_names.size();
+    _data_names.emplace_back(data->get_shared_name());
+    _data_idx_map.emplace(data->get_name(), idx);
+    return idx;
+}
+
+int32_t GraphTemplate::data_idx(const std::string &data_name) const {
+    auto iter = _data_idx_map.find(data_name);
+    if (iter == _data_idx_map.end()) {
+        return -1;
+    }
+    return iter->second;
+}
+
+std::shared_ptr<GraphTemplate> GraphTemplate::compile(Graph &graph) {
+    auto tpl = std::make_shared<GraphTemplate>();
+    tpl->_inline_continuation = graph.is_inline_continuation();
+    tpl->_vertex_fusion = graph.is_vertex_fusion();
+    tpl->_data_recycle = graph.is_data_recycle();
+    tpl->_data_recycle_pool_size = graph.get_data_recycle_pool_size();
+    tpl->_executor = graph._executor;
+    tpl->_vertexes.reserve(graph._vertixes.size());
+    for (GraphVertex *vertex : graph._vertixes) {
+        if (!vertex->_meta->processor_creator) {
+            LOG(WARNING) << "GraphTemplate compile failed, processor of vertex["
+                         << vertex->name() << "] can't be recreated";
+            return nullptr;
+        }
+        VertexSpec spec;
+        spec.meta = vertex->_meta;
+        for (GraphData *data : vertex->_emits) {
+            spec.emits.emplace_back(tpl->ensure_data_idx(data));
+        }
+        size_t declared_num = vertex->_declared_dependency_num < 0
+                                ? vertex->_dependencys.size()
+                                : vertex->_declared_dependency_num;
+        auto &optionals = vertex->_optional_dependencys;
+        for (size_t i = 0; i < declared_num; ++i) {
+            GraphDependency *dependency = vertex->_dependencys[i];
+            DependencySpec dep_spec;
+            dep_spec.data_idx = tpl->ensure_data_idx(dependency->get_depend_data());
+            if (dependency->get_condition_data() != nullptr) {
+                dep_spec.condition_data_idx = tpl->ensure_data_idx(dependency->get_condition_data());
+            }
+            dep_spec.is_optional =
+                std::find(optionals.begin(), optionals.end(), dependency) != optionals.end();
+            dep_spec.timeout_ms = dependency->get_timeout();
+            dep_spec.is_speculative = dependency->is_speculative();
+            dep_spec.is_lazy = dependency->is_lazy();
+            spec.dependencys.emplace_back(dep_spec);
+        }
+        tpl->_vertexes.emplace_back(std::move(spec));
+    }
+    // 没有被任何vertex引用的data(例如外部输入)也保留下来
+    for (GraphData *data : graph._datas) {
+        tpl->ensure_data_idx(data);
+    }
+    LOG(TRACE) << "GraphTemplate compile done vertex_size:" << tpl->vertex_size()
+               << " data_size:" << tpl->data_size();
+    return tpl;
+}
+
+GraphInstance *GraphTemplate::create_instance() const {
+    auto *g = new Graph();
+    g->_template = shared_from_this();
+    g->set_inline_continuation(_inline_continuation);
+    g->set_vertex_fusion(_vertex_fusion);
+    g->set_data_recycle(_data_recycle, _data_recycle_pool_size);
+    g->set_executor(_executor);
+
+    std::vector<GraphData *> datas;
+    datas.reserve(_data_names.size());
+    for (auto &name : _data_names) {
+        auto *data = new GraphData(name);
+        g->_global_data.emplace(*name, data);
+        g->_datas.emplace_back(data);
+        datas.emplace_back(data);
+    }
+
+    g->_vertixes.reserve(_vertexes.size());
+    for (const VertexSpec &spec : _vertexes) {
+        auto *vertex = new GraphVertex(g, spec.meta->processor_creator(), spec.meta);
+        vertex->set_executor(g->_executor);
+        for (uint32_t data_idx : spec.emits) {
+            datas[data_idx]->set_producer(vertex);
+            vertex->_emits.emplace_back(datas[data_idx]);
+        }
+        for (const DependencySpec &dep_spec : spec.dependencys) {
+            auto *dependency = new GraphDependency(datas[dep_spec.data_idx], g, vertex);
+            if (dep_spec.condition_data_idx >= 0) {
+                dependency->set_condition_data(datas[dep_spec.condition_data_idx]);
+                if (dep_spec.is_speculative) {
+                    dependency->speculate();
+                }
+            }
+            if (dep_spec.is_lazy) {
+                dependency->lazy();
+            }
+            vertex->_dependencys.emplace_back(dependency);
+            if (dep_spec.is_optional) {
+                vertex->_optional_dependencys.emplace_back(dependency);
+                if (dep_spec.timeout_ms > 0) {
+                    dependency->timeout(dep_spec.timeout_ms);
+                }
+            }
+        }
+        g->_vertixes.emplace_back(vertex);
+    }
+    g->build();
+    return g;
+}
+
+}  // namespace gflow
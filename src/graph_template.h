@@ -0,0 +1,85 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+
+#include "vertex.h"
+
+namespace gflow {
+
+class Graph;
+
+// 图实例就是一个普通的Graph对象，区别在于它的名字、option、绑定关系、条件表达式等
+// 只读的元数据都与GraphTemplate共享，自己只保存每次请求相关的状态:
+// waiting/expect计数、data的存储空间、closure以及绑定了这些data的processor
+using GraphInstance = Graph;
+
+// 编译好的只读图模板，保存拓扑结构、processor的创建方式以及data绑定关系。
+// 一个模板可以创建任意多个图实例，多个请求并发执行时不再需要各自完整地建一遍图。
+//
+// 使用示例：
+// Graph prototype;
+// prototype.add_vertex("QqProcessor")->emit("QQ_RESULT");
+// ...
+// prototype.build();
+// auto tpl = GraphTemplate::compile(prototype);
+// GraphInstance* g = tpl->create_instance();
+class GraphTemplate : public std::enable_shared_from_this<GraphTemplate> {
+   public:
+    struct DependencySpec {
+        uint32_t data_idx = 0;
+        // 没有条件表达式时为-1
+        int32_t condition_data_idx = -1;
+        bool is_optional = false;
+        // optional依赖的超时时间，0表示不超时
+        int64_t timeout_ms = 0;
+        // 条件依赖是否和条件并行执行数据的上游
+        bool is_speculative = false;
+        // 下游是否通过pull读取数据
+        bool is_lazy = false;
+    };
+
+    struct VertexSpec {
+        std::shared_ptr<VertexMeta> meta;
+        // 只包含build之前声明的依赖，build阶段processor添加的依赖由processor在实例上重新添加
+        std::vector<DependencySpec> dependencys;
+        std::vector<uint32_t> emits;
+    };
+
+    GraphTemplate() = default;
+    // 禁止拷贝和移动
+    inline GraphTemplate(GraphTemplate &&) = delete;
+    inline GraphTemplate(const GraphTemplate &) = delete;
+    inline GraphTemplate &operator=(GraphTemplate &&) = delete;
+    inline GraphTemplate &operator=(const GraphTemplate &) = delete;
+
+    // 从一个建好的图编译出模板，原来的图仍然可以继续使用。
+    // 所有vertex的processor都必须可以重新创建(通过名字注册或者条件表达式)，否则返回nullptr
+    static std::shared_ptr<GraphTemplate> compile(Graph &graph);
+
+    // 创建一个已经build好的图实例，由调用方负责delete
+    GraphInstance *create_instance() const;
+
+    size_t vertex_size() const { return _vertexes.size(); }
+    size_t data_size() const { return _data_names.size(); }
+    const std::vector<VertexSpec> &vertexes() const { return _vertexes; }
+    const std::string &data_name(uint32_t data_idx) const { return *_data_names[data_idx]; }
+    // 找不到返回-1
+    int32_t data_idx(const std::string &data_name) const;
+
+   private:
+    uint32_t ensure_data_idx(GraphData *data);
+
+    std::vector<std::shared_ptr<const std::string>> _data_names;
+    std::unordered_map<std::string, uint32_t> _data_idx_map;
+    std::vector<VertexSpec> _vertexes;
+    bool _inline_continuation = false;
+    bool _vertex_fusion = false;
+    bool _data_recycle = false;
+    size_t _data_recycle_pool_size = 4;
+    GraphExecutor *_executor = nullptr;
+};
+
+}  // namespace gflow
@@ -0,0 +1,54 @@
+#include "graph_topology.h"
+#include "data.h"
+#include "vertex.h"
+#include "dependency.h"
+
+namespace gflow {
+
+void GraphTopology::build(const std::vector<GraphVertex *> &vertexes, const std::vector<GraphData *> &datas) {
+    _vertexes = vertexes;
+    _datas = datas;
+    for (uint32_t i = 0; i < _vertexes.size(); ++i) {
+        _vertexes[i]->set_idx(i);
+    }
+    for (uint32_t i = 0; i < _datas.size(); ++i) {
+        _datas[i]->set_idx(i);
+    }
+
+    _consumer_offsets.assign(1, 0);
+    _consumers.clear();
+    for (GraphData *data : _datas) {
+        for (GraphDependency *dependency : data->get_down_streams()) {
+            _consumers.emplace_back(dependency);
+        }
+        _consumer_offsets.emplace_back(_consumers.size());
+    }
+
+    _emit_offsets.assign(1, 0);
+    _emits.clear();
+    _downstream_offsets.assign(1, 0);
+    _downstreams.clear();
+    std::vector<uint32_t> visited(_vertexes.size(), UINT32_MAX);
+    for (uint32_t i = 0; i < _vertexes.size(); ++i) {
+        for (GraphData *data : _vertexes[i]->get_emits()) {
+            _emits.emplace_back(data->idx());
+            for (GraphDependency *dependency : consumers(data->idx())) {
+                uint32_t downstream_idx = dependency->get_attached_vertex()->idx();
+                if (visited[downstream_idx] != i) {
+                    visited[downstream_idx] = i;
+                    _downstreams.emplace_back(downstream_idx);
+                }
+            }
+        }
+        _emit_offsets.emplace_back(_emits.size());
+        _downstream_offsets.emplace_back(_downstreams.size());
+    }
+
+    // 数组不再变化之后，data发布时直接遍历这里的下游
+    for (uint32_t i = 0; i < _datas.size(); ++i) {
+        ArrayRange<GraphDependency *> data_consumers = consumers(i);
+        _datas[i]->set_consumers(data_consumers.begin(), data_consumers.size());
+    }
+}
+
+}  // namespace gflow
@@ -0,0 +1,81 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+namespace gflow {
+
+class GraphData;
+class GraphVertex;
+class GraphDependency;
+
+// 连续数组中的一段，只读
+template <typename T>
+class ArrayRange {
+   public:
+    ArrayRange() = default;
+    ArrayRange(const T *begin, const T *end) : _begin(begin), _end(end) {}
+    const T *begin() const { return _begin; }
+    const T *end() const { return _end; }
+    size_t size() const { return _end - _begin; }
+    bool empty() const { return _begin == _end; }
+    const T &operator[](size_t idx) const { return _begin[idx]; }
+
+   private:
+    const T *_begin = nullptr;
+    const T *_end = nullptr;
+};
+
+// build时生成的紧凑拓扑(CSR)：vertex和data按下标编号，邻接关系按下标顺序存放在几个连续的数组里。
+// 发布数据、计算优先级等遍历只在这几个数组上顺序访问，不再经过各个对象里单独分配的vector。
+// 建图接口(depend/emit)仍然修改对象上的vector，修改之后需要重新build
+class GraphTopology {
+   public:
+    GraphTopology() = default;
+    // 禁止拷贝和移动，data上保存了指向数组的指针
+    GraphTopology(GraphTopology &&) = delete;
+    GraphTopology(const GraphTopology &) = delete;
+    GraphTopology &operator=(GraphTopology &&) = delete;
+    GraphTopology &operator=(const GraphTopology &) = delete;
+
+    // 按vertex和data的顺序编号，并把data的下游指向生成的数组
+    void build(const std::vector<GraphVertex *> &vertexes, const std::vector<GraphData *> &datas);
+
+    size_t vertex_size() const { return _vertexes.size(); }
+    size_t data_size() const { return _datas.size(); }
+    GraphVertex *vertex(uint32_t vertex_idx) const { return _vertexes[vertex_idx]; }
+    GraphData *data(uint32_t data_idx) const { return _datas[data_idx]; }
+
+    // 依赖data(数据或者条件)的所有GraphDependency
+    ArrayRange<GraphDependency *> consumers(uint32_t data_idx) const {
+        return range(_consumers, _consumer_offsets, data_idx);
+    }
+    // vertex产出的data的下标
+    ArrayRange<uint32_t> emits(uint32_t vertex_idx) const {
+        return range(_emits, _emit_offsets, vertex_idx);
+    }
+    // 依赖vertex产出的data(数据或者条件)的下游vertex下标，已经去重
+    ArrayRange<uint32_t> downstreams(uint32_t vertex_idx) const {
+        return range(_downstreams, _downstream_offsets, vertex_idx);
+    }
+
+   private:
+    template <typename T>
+    static ArrayRange<T> range(const std::vector<T> &values, const std::vector<uint32_t> &offsets,
+                               uint32_t idx) {
+        return ArrayRange<T>(values.data() + offsets[idx], values.data() + offsets[idx + 1]);
+    }
+
+    std::vector<GraphVertex *> _vertexes;
+    std::vector<GraphData *> _datas;
+    // 第i个data的下游是_consumers[_consumer_offsets[i], _consumer_offsets[i + 1])，下同
+    std::vector<uint32_t> _consumer_offsets;
+    std::vector<GraphDependency *> _consumers;
+    std::vector<uint32_t> _emit_offsets;
+    std::vector<uint32_t> _emits;
+    std::vector<uint32_t> _downstream_offsets;
+    std::vector<uint32_t> _downstreams;
+};
+
+}  // namespace gflow
@@ -0,0 +1,47 @@
+#include "hedge.h"
+#include "common.h"
+
+#include <algorithm>
+
+namespace gflow {
+
+HedgePolicy::HedgePolicy(HedgeOption option) : _option(option) {
+    if (_option.window_size == 0) {
+        _option.window_size = 1;
+    }
+    _option.percentile = std::clamp(_option.percentile, 0.0, 1.0);
+    _latencys.reserve(_option.window_size);
+}
+
+void HedgePolicy::add_latency(int64_t cost_ns) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (_latencys.size() < _option.window_size) {
+        _latencys.emplace_back(cost_ns);
+    } else {
+        _latencys[_next_idx] = cost_ns;
+    }
+    _next_idx = (_next_idx + 1) % _option.window_size;
+}
+
+int64_t HedgePolicy::delay_ns() const {
+    std::vector<int64_t> latencys;
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_latencys.empty() || _latencys.size() < _option.min_sample_num) {
+            return 0;
+        }
+        latencys = _latencys;
+    }
+    size_t idx = std::min(latencys.size() - 1, static_cast<size_t>(_option.percentile * latencys.size()));
+    std::nth_element(latencys.begin(), latencys.begin() + idx, latencys.end());
+    return std::max(latencys[idx], _option.min_delay_us * 1000);
+}
+
+HedgePolicy::Stats HedgePolicy::stats() const {
+    Stats stats;
+    stats.hedge_num = _hedge_num.load(std::memory_order_relaxed);
+    stats.hedge_win_num = _hedge_win_num.load(std::memory_order_relaxed);
+    return stats;
+}
+
+}  // namespace gflow
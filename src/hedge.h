@@ -0,0 +1,56 @@
+#pragma once
+
+#include <mutex>
+#include <atomic>
+#include <vector>
+
+namespace gflow {
+
+struct HedgeOption {
+    // 用最近执行耗时的这个分位数作为发起对冲的等待时间
+    double percentile = 0.95;
+    // 保留最近多少次的耗时
+    size_t window_size = 128;
+    // 耗时样本不够时不对冲
+    size_t min_sample_num = 16;
+    // 等待时间的下限(微秒)，避免对本来就很快的vertex发起对冲
+    int64_t min_delay_us = 1000;
+};
+
+// vertex的对冲策略：执行超过最近耗时的分位数还没有结束时，再发起一次相同的执行，先成功的发布数据。
+// 同一个GraphTemplate创建的所有图实例共享耗时统计
+class HedgePolicy {
+   public:
+    struct Stats {
+        // 发起对冲的次数
+        uint64_t hedge_num = 0;
+        // 对冲的执行先结束的次数
+        uint64_t hedge_win_num = 0;
+    };
+
+    explicit HedgePolicy(HedgeOption option);
+    // 禁止拷贝和移动
+    HedgePolicy(HedgePolicy &&) = delete;
+    HedgePolicy(const HedgePolicy &) = delete;
+    HedgePolicy &operator=(HedgePolicy &&) = delete;
+    HedgePolicy &operator=(const HedgePolicy &) = delete;
+
+    // 记录一次成功执行的耗时
+    void add_latency(int64_t cost_ns);
+    // 发起对冲前等待的时间(纳秒)，样本不够时返回0表示不对冲
+    int64_t delay_ns() const;
+    void add_hedge() { _hedge_num.fetch_add(1, std::memory_order_relaxed); }
+    void add_hedge_win() { _hedge_win_num.fetch_add(1, std::memory_order_relaxed); }
+    Stats stats() const;
+
+   private:
+    HedgeOption _option;
+    mutable std::mutex _mutex;
+    // 环形缓冲区，_next_idx是下一个写入的位置
+    std::vector<int64_t> _latencys;
+    size_t _next_idx = 0;
+    std::atomic<uint64_t> _hedge_num{0};
+    std::atomic<uint64_t> _hedge_win_num{0};
+};
+
+}  // namespace gflow
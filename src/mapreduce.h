@@ -9,6 +9,7 @@
 //#include <base/logging.h>
 
 #include "concurrent/thread_pool.h"
+#include "concurrent/work_stealing_thread_pool.h"
 
 // #include <baidu/feed/mlarch/babylon/bthread_executor.h>
 // #include <baidu/feed/mlarch/babylon/executor.h>
@@ -18,6 +19,8 @@
 // using baidu::feed::mlarch::babylon::bthread_async;
 
 using gflow::concurrent::thread_pool_async;
+using gflow::concurrent::work_stealing_async;
+using gflow::concurrent::ThreadPoolBackend;
 
 namespace gflow {
 
@@ -56,7 +59,9 @@ public:
 #ifdef USE_BTHREAD
                     auto future = bthread_async(_parallel_map_callback, std::move(batch));
 #else
-                    auto future = thread_pool_async(_parallel_map_callback, std::move(batch));
+                    auto future = _backend == ThreadPoolBackend::WORK_STEALING
+                            ? work_stealing_async(_parallel_map_callback, std::move(batch))
+                            : thread_pool_async(_parallel_map_callback, std::move(batch));
 #endif
                     futures.emplace_back(std::move(future));
                 }
@@ -120,8 +125,14 @@ public:
         _channel = &queue; 
         return *this;
     }
+    // parallel_map使用的线程池，默认是共享队列的ThreadPool
+    MapReducer& backend(ThreadPoolBackend backend) {
+        _backend = backend;
+        return *this;
+    }
 private:
     size_t _batch_size = 0;
+    ThreadPoolBackend _backend = ThreadPoolBackend::SHARED_QUEUE;
     CHANNEL<InputType>* _channel = nullptr;
     std::function<OutputBatchPtr(InputBatchPtr)> _parallel_map_callback;
     std::function<OutputBatchPtr(InputBatchPtr)> _map_callback;
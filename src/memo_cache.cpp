@@ -0,0 +1,122 @@
+#include "memo_cache.h"
+#include "common.h"
+
+namespace gflow {
+
+MemoCache::MemoCache(MemoCacheOption option) : _option(option) {
+    if (_option.shard_num == 0) {
+        _option.shard_num = 1;
+    }
+    _shard_memory_bytes = _option.max_memory_bytes / _option.shard_num;
+    _shards.reset(new Shard[_option.shard_num]);
+}
+
+bool MemoCache::is_same_inputs(const Entry &entry, const Inputs &inputs) {
+    if (entry.inputs.size() != inputs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < inputs.size(); ++i) {
+        if (inputs[i] == nullptr || entry.is_missing[i]) {
+            if (inputs[i] != nullptr || !entry.is_missing[i]) {
+                return false;
+            }
+            continue;
+        }
+        if (!entry.inputs[i].equals(*inputs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+std::shared_ptr<const MemoCache::Value> MemoCache::lookup(uint64_t key, const Inputs &inputs) {
+    Shard &shard = get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.index.find(key);
+    // hash冲突的输入当作没有命中
+    if (iter == shard.index.end() || !is_same_inputs(*iter->second, inputs)) {
+        _miss_num.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    if (_option.ttl.count() > 0 && iter->second->expire_time <= Clock::now()) {
+        erase(shard, iter->second);
+        _eviction_num.fetch_add(1, std::memory_order_relaxed);
+        _miss_num.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    shard.lru.splice(shard.lru.begin(), shard.lru, iter->second);
+    _hit_num.fetch_add(1, std::memory_order_relaxed);
+    return iter->second->value;
+}
+
+void MemoCache::insert(uint64_t key, const Inputs &inputs, Value value) {
+    Entry entry;
+    entry.key = key;
+    entry.memory_bytes = sizeof(Entry);
+    entry.inputs.reserve(inputs.size());
+    entry.is_missing.reserve(inputs.size());
+    for (const Any *input : inputs) {
+        entry.is_missing.emplace_back(input == nullptr);
+        if (input == nullptr) {
+            entry.inputs.emplace_back();
+        } else {
+            entry.inputs.emplace_back(*input);
+        }
+        entry.memory_bytes += entry.inputs.back().memory_size();
+    }
+    for (const Any &any : value) {
+        entry.memory_bytes += any.memory_size();
+    }
+    if (entry.memory_bytes > _shard_memory_bytes) {
+        LOG(TRACE) << "MemoCache skip too large value, memory_bytes:" << entry.memory_bytes;
+        return;
+    }
+    entry.value = std::make_shared<const Value>(std::move(value));
+    entry.expire_time = Clock::now() + _option.ttl;
+
+    Shard &shard = get_shard(key);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto iter = shard.index.find(key);
+    if (iter != shard.index.end()) {
+        erase(shard, iter->second);
+    }
+    shard.memory_bytes += entry.memory_bytes;
+    shard.lru.emplace_front(std::move(entry));
+    shard.index.emplace(key, shard.lru.begin());
+    while (shard.memory_bytes > _shard_memory_bytes) {
+        erase(shard, std::prev(shard.lru.end()));
+        _eviction_num.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MemoCache::erase(Shard &shard, std::list<Entry>::iterator iter) {
+    shard.memory_bytes -= iter->memory_bytes;
+    shard.index.erase(iter->key);
+    shard.lru.erase(iter);
+}
+
+MemoCache::Stats MemoCache::stats() const {
+    Stats stats;
+    stats.hit_num = _hit_num.load(std::memory_order_relaxed);
+    stats.miss_num = _miss_num.load(std::memory_order_relaxed);
+    stats.eviction_num = _eviction_num.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < _option.shard_num; ++i) {
+        Shard &shard = _shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        stats.entry_num += shard.lru.size();
+        stats.memory_bytes += shard.memory_bytes;
+    }
+    return stats;
+}
+
+void MemoCache::clear() {
+    for (size_t i = 0; i < _option.shard_num; ++i) {
+        Shard &shard = _shards[i];
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        shard.lru.clear();
+        shard.index.clear();
+        shard.memory_bytes = 0;
+    }
+}
+
+}  // namespace gflow
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <list>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include "any.h"
+
+namespace gflow {
+
+struct MemoCacheOption {
+    // 分片个数，每个分片一把锁
+    size_t shard_num = 16;
+    // 所有分片加起来的内存上限(估计值)
+    size_t max_memory_bytes = 64 * 1024 * 1024;
+    // 过期时间，0表示不过期
+    std::chrono::milliseconds ttl{0};
+};
+
+// 纯函数vertex的跨请求结果缓存：key是依赖数据的hash，value是vertex产出的所有data。
+// 每个结果同时保存依赖数据的拷贝，命中时逐个比较，hash冲突时不会返回别的输入的结果。
+// 分片的LRU，超过内存上限时淘汰最久没有使用的结果
+class MemoCache {
+   public:
+    using Clock = std::chrono::steady_clock;
+    using Value = std::vector<Any>;
+    // 依赖数据，没有等到的依赖(超时、条件不成立)为nullptr
+    using Inputs = std::vector<const Any *>;
+
+    struct Stats {
+        uint64_t hit_num = 0;
+        uint64_t miss_num = 0;
+        // 超过内存上限或者过期被淘汰的个数
+        uint64_t eviction_num = 0;
+        uint64_t entry_num = 0;
+        uint64_t memory_bytes = 0;
+    };
+
+    explicit MemoCache(MemoCacheOption option);
+    // 禁止拷贝和移动
+    MemoCache(MemoCache &&) = delete;
+    MemoCache(const MemoCache &) = delete;
+    MemoCache &operator=(MemoCache &&) = delete;
+    MemoCache &operator=(const MemoCache &) = delete;
+
+    // 没有命中、已经过期或者依赖数据不相等返回nullptr
+    std::shared_ptr<const Value> lookup(uint64_t key, const Inputs &inputs);
+    // 拷贝inputs指向的数据保存在结果里，调用者保证它们可以拷贝
+    void insert(uint64_t key, const Inputs &inputs, Value value);
+    Stats stats() const;
+    void clear();
+
+   private:
+    struct Entry {
+        uint64_t key = 0;
+        // 依赖数据的拷贝，没有等到的依赖is_missing为true
+        Value inputs;
+        std::vector<bool> is_missing;
+        std::shared_ptr<const Value> value;
+        size_t memory_bytes = 0;
+        Clock::time_point expire_time;
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        // 头部是最近使用的
+        std::list<Entry> lru;
+        std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+        size_t memory_bytes = 0;
+    };
+
+    Shard &get_shard(uint64_t key) { return _shards[key % _option.shard_num]; }
+    static bool is_same_inputs(const Entry &entry, const Inputs &inputs);
+    // 调用时持有分片的锁
+    void erase(Shard &shard, std::list<Entry>::iterator iter);
+
+    MemoCacheOption _option;
+    size_t _shard_memory_bytes = 0;
+    std::unique_ptr<Shard[]> _shards;
+    std::atomic<uint64_t> _hit_num{0};
+    std::atomic<uint64_t> _miss_num{0};
+    std::atomic<uint64_t> _eviction_num{0};
+};
+
+}  // namespace gflow
@@ -2,6 +2,8 @@
 #include "dependency.h"
 #include "data.h"
 #include "processor.h"
+#include "graph_executor.h"
+#include "closure.h"
 
 namespace gflow {
 
@@ -9,6 +11,15 @@ GraphData *GraphProcessor::get_data(std::string name) {
     return _vertex->get_data(name);
 }
 
+int GraphProcessor::process_batch(size_t batch_size) {
+    return _vertex->process_by_row(batch_size);
+}
+
+bool GraphProcessor::cancelled() {
+    return _vertex->get_closure_context()->is_mark_finished() || _vertex->is_abandoned()
+            || _vertex->is_hedge_settled();
+}
+
 int GraphFunction::setup() {
     if (__auto_setup_data() != 0) {
         return -1;
@@ -21,6 +32,11 @@ int GraphFunction::process() {
         return -1;
     }
     auto ret = (*this)(); // 调用operator()
+    // 出错时不发布数据，vertex可能按ErrorPolicy重试或者降级
+    if (ret != 0 && ret != ASYNC_PROCESSING) {
+        return ret;
+    }
+    InlineContinuation::TailScope tail_scope;
     __auto_release_data();
     return ret;
 }
@@ -18,6 +18,8 @@ using ProcessorCreator = std::function<GraphProcessorPtr()>;
 class ProcessorFactory {
 private:
     std::unordered_map<std::string, ProcessorCreator> _creator_map;
+    // processor所属的并发组，key是processor name
+    std::unordered_map<std::string, std::string> _group_map;
 public:
     void add_creator(const std::string name, ProcessorCreator creator) {
         _creator_map.emplace(name, creator);
@@ -32,6 +34,27 @@ public:
         return creator();
     }
 
+    ProcessorCreator get_creator(const std::string name) {
+        auto iter = _creator_map.find(name);
+        if (iter == _creator_map.end()) {
+            return nullptr;
+        }
+        return iter->second;
+    }
+
+    void set_group(const std::string name, const std::string group_name) {
+        _group_map[name] = group_name;
+    }
+
+    // 没有加入并发组返回空字符串
+    std::string get_group(const std::string name) {
+        auto iter = _group_map.find(name);
+        if (iter == _group_map.end()) {
+            return "";
+        }
+        return iter->second;
+    }
+
     static ProcessorFactory& instance() {
         static ProcessorFactory _instance;
         return _instance;
@@ -43,6 +66,10 @@ public:
     ProcessorRegister(const std::string name, ProcessorCreator creator) {
         ProcessorFactory::instance().add_creator(name, creator);
     }
+    ProcessorRegister(const std::string name, ProcessorCreator creator, const std::string group_name) {
+        ProcessorFactory::instance().add_creator(name, creator);
+        ProcessorFactory::instance().set_group(name, group_name);
+    }
 };
 
 #define REGISTER_PROCESSOR(PROCESSOR) \
@@ -52,6 +79,15 @@ public:
         return std::make_shared<PROCESSOR>(); \
     }); \
 
+// 注册processor并加入并发组，同一组的vertex同时占用的worker数受ConcurrencyGroup限制，
+// 上限通过ConcurrencyGroupRegistry::instance().set_max_concurrency(group, num)设置
+#define REGISTER_PROCESSOR_WITH_GROUP(PROCESSOR, GROUP) \
+    using gflow::ProcessorRegister; \
+    using gflow::GraphProcessor; \
+    static ProcessorRegister PROCESSOR##ProcessorRegister(#PROCESSOR, []() -> std::shared_ptr<GraphProcessor> { \
+        return std::make_shared<PROCESSOR>(); \
+    }, GROUP); \
+
 class GraphProcessor {
    public:
     GraphProcessor() = default;
@@ -62,11 +98,18 @@ class GraphProcessor {
     inline GraphProcessor &operator=(const GraphProcessor &) = delete;
 
     virtual ~GraphProcessor() {}
+    // process返回这个值表示还没有执行完，结束时调用vertex().finish_async(error_code)
+    static constexpr int ASYNC_PROCESSING = 0x7fffffff;
     virtual int process() = 0;
     virtual int setup() { return 0; }
+    // 批量执行(Graph::set_batch_size之后run)时调用，一次处理batch_size个请求，按行读写data(GraphData::raw<T>(row)等)。
+    // 默认逐行调用process
+    virtual int process_batch(size_t batch_size);
     GraphData *get_data(std::string name);
     void set_vertex(GraphVertex *vertex) { _vertex = vertex; }
     GraphVertex& vertex() { return *_vertex; }
+    // 图已经超时或者出错，或者结果已经被下游放弃，耗时长的processor可以在循环里检查并提前退出
+    bool cancelled();
 
    protected:
     GraphVertex *_vertex = nullptr;
@@ -0,0 +1,118 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+
+#include "concurrent/lock_free_bounded_queue.h"
+
+// 流水线模式下连接两个stage的流，底层是无锁有界队列，读写都不阻塞。
+// 生产者写满时记录等待标记，消费者取走元素后通知生产者继续；
+// 生产者写入和close时通知消费者，消费者由StreamStageBase调度到线程池上处理，不会有线程阻塞等待
+
+namespace gflow {
+
+// stage在流上注册的监听者，流有新元素或者有空位时被通知
+class StreamListener {
+public:
+    virtual ~StreamListener() {}
+    virtual void notify() = 0;
+};
+
+constexpr size_t DEFAULT_STREAM_CAPACITY = 1024;
+
+template <typename T>
+class Stream {
+public:
+    Stream() : _queue(DEFAULT_STREAM_CAPACITY) {}
+    Stream(Stream const&) = delete;             // Copy construct
+    Stream(Stream&&) = delete;                  // Move construct
+    Stream& operator=(Stream const&) = delete;  // Copy assign
+    Stream& operator=(Stream &&) = delete;      // Move assign
+
+    // 开始新的一轮，只能在没有读写的时候调用(生产者发布数据之前)
+    void reset(size_t capacity = DEFAULT_STREAM_CAPACITY) noexcept {
+        _queue.reset(capacity);
+        _is_closed.store(false, std::memory_order_relaxed);
+        _is_abandoned.store(false, std::memory_order_relaxed);
+        _is_producer_waiting.store(false, std::memory_order_relaxed);
+        _consumer.store(nullptr, std::memory_order_relaxed);
+        _producer.store(nullptr, std::memory_order_relaxed);
+    }
+
+    // 成功时item被移动到流里。返回false表示流满了，item保持不变，消费者取走元素后会通知生产者。
+    // 下游已经放弃时直接丢弃
+    bool try_push(T& item) noexcept {
+        if (is_abandoned()) {
+            return true;
+        }
+        if (!_queue.try_push(item)) {
+            _is_producer_waiting.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            // 设置等待标记之后再试一次，避免消费者在标记之前取走了元素而漏掉通知
+            if (!_queue.try_push(item)) {
+                return false;
+            }
+        }
+        notify(_consumer);
+        return true;
+    }
+
+    // 普通vertex作为生产者时使用，流满了就让出cpu等待
+    void push(T item) noexcept {
+        while (!try_push(item)) {
+            std::this_thread::yield();
+        }
+    }
+
+    bool try_pop(T& item) noexcept {
+        if (!_queue.try_pop(item)) {
+            return false;
+        }
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_is_producer_waiting.load(std::memory_order_relaxed)
+                && _is_producer_waiting.exchange(false, std::memory_order_relaxed)) {
+            notify(_producer);
+        }
+        return true;
+    }
+
+    // 生产者结束，close之前写入的元素仍然可以读到
+    void close() noexcept {
+        _is_closed.store(true, std::memory_order_release);
+        notify(_consumer);
+    }
+    bool is_closed() const noexcept { return _is_closed.load(std::memory_order_acquire); }
+
+    // 消费者提前结束，生产者不用再继续写
+    void abandon() noexcept {
+        _is_abandoned.store(true, std::memory_order_release);
+        notify(_producer);
+    }
+    bool is_abandoned() const noexcept { return _is_abandoned.load(std::memory_order_acquire); }
+
+    void set_consumer(StreamListener* consumer) noexcept {
+        _consumer.store(consumer, std::memory_order_release);
+    }
+    void set_producer(StreamListener* producer) noexcept {
+        _producer.store(producer, std::memory_order_release);
+    }
+
+    size_t size() const noexcept { return _queue.size(); }
+
+private:
+    static void notify(std::atomic<StreamListener*>& listener) noexcept {
+        StreamListener* l = listener.load(std::memory_order_acquire);
+        if (l != nullptr) {
+            l->notify();
+        }
+    }
+
+    concurrent::LockFreeBoundedQueue<T> _queue;
+    std::atomic<bool> _is_closed{false};
+    std::atomic<bool> _is_abandoned{false};
+    std::atomic<bool> _is_producer_waiting{false};
+    std::atomic<StreamListener*> _consumer{nullptr};
+    std::atomic<StreamListener*> _producer{nullptr};
+};
+
+} // namespace
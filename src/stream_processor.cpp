@@ -0,0 +1,55 @@
+#include "stream_processor.h"
+#include "closure.h"
+#include "graph_executor.h"
+
+namespace gflow {
+
+int StreamStageBase::start() {
+    _is_finished = false;
+    vertex().begin_async();
+    // 注册之前上游可能已经写入了元素
+    schedule();
+    return ASYNC_PROCESSING;
+}
+
+void StreamStageBase::schedule() {
+    if (_signals.fetch_add(1, std::memory_order_acq_rel) != 0) {
+        return;
+    }
+    // 调度中的任务也算一个执行中的任务，保证任务结束之前图不会结束
+    ClosureContext* closure_context = vertex().get_closure_context();
+    closure_context->add_pending();
+    auto task = [this, closure_context]() {
+        drain();
+        closure_context->done_pending();
+    };
+    if (vertex().get_executor()->submit(task) != 0) {
+        LOG(WARNING) << "stream stage[" << vertex().name() << "] submit failed, drain in place";
+        task();
+    }
+}
+
+void StreamStageBase::drain() {
+    int64_t signals = _signals.load(std::memory_order_acquire);
+    do {
+        if (!_is_finished) {
+            bool finished = false;
+            int error_code = 0;
+            if (cancelled()) {
+                LOG(TRACE) << "stream stage[" << vertex().name() << "] is cancelled";
+                finished = true;
+            } else {
+                error_code = run_once(&finished);
+            }
+            if (error_code != 0 || finished) {
+                _is_finished = true;
+                close_streams();
+                vertex().finish_async(error_code);
+            }
+        }
+        // 处理期间来的通知在下一轮处理
+        signals = _signals.fetch_sub(signals, std::memory_order_acq_rel) - signals;
+    } while (signals != 0);
+}
+
+}  // namespace gflow
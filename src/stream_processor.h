@@ -0,0 +1,212 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include <type_traits>
+
+#include "processor.h"
+#include "stream.h"
+#include "vertex.h"
+#include "data.h"
+#include "dependency.h"
+
+namespace gflow {
+
+// 流水线模式的stage：vertex执行一次后常驻，随着上游写入不断处理元素，直到上游close。
+// 每当流上有新元素或者下游有空位，stage被调度到executor上处理当前能处理的元素，处理完就让出线程，
+// 同一个stage同一时刻只在一个线程上处理。所有stage都结束后vertex才结束(异步结束，见GraphVertex::finish_async)
+class StreamStageBase : public GraphProcessor, public StreamListener {
+   public:
+    void notify() override { schedule(); }
+
+   protected:
+    // 处理当前能处理的元素，返回非0表示出错，*finished设为true表示stage结束
+    virtual int run_once(bool* finished) = 0;
+    // stage结束(正常结束、出错或者图被取消)时关闭输出流、放弃输入流
+    virtual void close_streams() = 0;
+    // 在process中调用，开始调度，返回值作为process的返回值
+    int start();
+
+   private:
+    void schedule();
+    void drain();
+
+    // 还没处理的通知个数，从0变成1的通知负责提交任务
+    std::atomic<int64_t> _signals{0};
+    bool _is_finished = false;
+};
+
+// 输出流由vertex的第一个EMIT发布，容量由stream_capacity决定
+template <typename OUT>
+class StreamOutput {
+   public:
+    virtual size_t stream_capacity() { return DEFAULT_STREAM_CAPACITY; }
+
+    // 输出一个元素，下游满了先缓存下来，等下游有空位再写
+    template <typename U>
+    void emit(U&& item) {
+        _pending.emplace_back(std::forward<U>(item));
+    }
+
+   protected:
+    int open_output(GraphVertex& vertex, StreamListener* producer) {
+        if (vertex.get_emits().empty()) {
+            LOG(WARNING) << "stream stage[" << vertex.name() << "] has no output stream";
+            return -1;
+        }
+        GraphData* data = vertex.get_emits()[0];
+        _output = data->make<Stream<OUT>>()->template pointer<Stream<OUT>>();
+        _output->reset(stream_capacity());
+        _output->set_producer(producer);
+        _pending.clear();
+        _pending_pos = 0;
+        // 立即发布，下游stage随之开始
+        data->release();
+        return 0;
+    }
+    // 返回false表示下游满了
+    bool flush() {
+        while (_pending_pos < _pending.size()) {
+            if (!_output->try_push(_pending[_pending_pos])) {
+                return false;
+            }
+            ++_pending_pos;
+        }
+        _pending.clear();
+        _pending_pos = 0;
+        return true;
+    }
+
+    Stream<OUT>* _output = nullptr;
+    std::vector<OUT> _pending;
+    size_t _pending_pos = 0;
+};
+
+// 没有输出流的stage(sink)
+template <>
+class StreamOutput<void> {
+   protected:
+    int open_output(GraphVertex&, StreamListener*) { return 0; }
+    bool flush() { return true; }
+};
+
+// 从IN流读取元素处理，输出到OUT流。输入流是vertex的第一个依赖，OUT为void时没有输出流
+template <typename IN, typename OUT>
+class StreamStage : public StreamStageBase, public StreamOutput<OUT> {
+   public:
+    // 处理一个元素，通过emit输出
+    virtual int process_item(IN& item) = 0;
+    // 输入流结束后调用一次，可以输出汇总的结果或者发布普通的data
+    virtual int finish_stream() { return 0; }
+
+    int process() override {
+        const auto& dependencys = vertex().get_dependencys();
+        if (dependencys.empty() || (_input = dependencys[0]->template value<Stream<IN>>()) == nullptr) {
+            LOG(WARNING) << "stream stage[" << vertex().name() << "] has no input stream";
+            return -1;
+        }
+        if (this->open_output(vertex(), this) != 0) {
+            return -1;
+        }
+        _is_input_done = false;
+        _input->set_consumer(this);
+        return start();
+    }
+
+   protected:
+    int run_once(bool* finished) override {
+        if (!this->flush()) {
+            return 0;
+        }
+        if (_is_input_done) {
+            *finished = true;
+            return 0;
+        }
+        IN item;
+        while (true) {
+            if constexpr (!std::is_void_v<OUT>) {
+                if (this->_output->is_abandoned()) {
+                    *finished = true;
+                    return 0;
+                }
+            }
+            bool has_item = _input->try_pop(item);
+            if (!has_item && _input->is_closed()) {
+                // close之前写入的元素一定可见，再取一次确认流结束
+                has_item = _input->try_pop(item);
+                if (!has_item) {
+                    _is_input_done = true;
+                    int error_code = finish_stream();
+                    if (error_code != 0) {
+                        return error_code;
+                    }
+                    *finished = this->flush();
+                    return 0;
+                }
+            }
+            if (!has_item) {
+                return 0;
+            }
+            int error_code = process_item(item);
+            if (error_code != 0) {
+                return error_code;
+            }
+            if (!this->flush()) {
+                return 0;
+            }
+        }
+    }
+
+    void close_streams() override {
+        _input->abandon();
+        if constexpr (!std::is_void_v<OUT>) {
+            this->_output->close();
+        }
+    }
+
+   private:
+    Stream<IN>* _input = nullptr;
+    bool _is_input_done = false;
+};
+
+// 流的源头，不断调用next产出元素，直到next返回false
+template <typename OUT>
+class StreamSource : public StreamStageBase, public StreamOutput<OUT> {
+   public:
+    // 产出下一个元素，返回false表示流结束
+    virtual bool next(OUT& item) = 0;
+
+    int process() override {
+        if (this->open_output(vertex(), this) != 0) {
+            return -1;
+        }
+        _is_eos = false;
+        return start();
+    }
+
+   protected:
+    int run_once(bool* finished) override {
+        while (this->flush()) {
+            if (_is_eos || this->_output->is_abandoned()) {
+                *finished = true;
+                return 0;
+            }
+            OUT item;
+            if (!next(item)) {
+                _is_eos = true;
+                continue;
+            }
+            this->emit(std::move(item));
+        }
+        return 0;
+    }
+
+    void close_streams() override {
+        this->_output->close();
+    }
+
+   private:
+    bool _is_eos = false;
+};
+
+}  // namespace gflow
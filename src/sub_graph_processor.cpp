@@ -0,0 +1,111 @@
+#include "sub_graph_processor.h"
+#include "graph.h"
+#include "vertex.h"
+#include "data.h"
+#include "graph_executor.h"
+
+namespace gflow {
+
+REGISTER_PROCESSOR(SubGraphProcessor);
+
+GraphVertex *SubGraphProcessor::add_to(Graph &graph, SubGraphOption option) {
+    GraphVertex *vertex = graph.add_vertex("SubGraphProcessor");
+    if (vertex == nullptr) {
+        return nullptr;
+    }
+    for (auto& [outer_name, inner_name] : option.inputs) {
+        vertex->depend(outer_name);
+    }
+    for (auto& [outer_name, inner_name] : option.outputs) {
+        vertex->emit(outer_name);
+    }
+    vertex->set_option(std::move(option));
+    return vertex;
+}
+
+int SubGraphProcessor::setup() {
+    const SubGraphOption *option = std::any_cast<SubGraphOption>(&vertex().get_any_option());
+    if (option == nullptr || !option->graph_template) {
+        LOG(WARNING) << "SubGraphProcessor[" << vertex().name() << "] graph template is not set";
+        return -1;
+    }
+    if (option->outputs.empty()) {
+        LOG(WARNING) << "SubGraphProcessor[" << vertex().name() << "] has no output";
+        return -1;
+    }
+    _child.reset(option->graph_template->create_instance());
+    if (!_child) {
+        LOG(WARNING) << "SubGraphProcessor[" << vertex().name() << "] create graph instance failed";
+        return -1;
+    }
+    auto bind = [this](const std::vector<std::pair<std::string, std::string>>& mapping,
+                       std::vector<std::pair<GraphData *, GraphData *>> *datas) {
+        datas->clear();
+        for (auto& [outer_name, inner_name] : mapping) {
+            GraphData *outer = get_data(outer_name);
+            GraphData *inner = _child->get_data(inner_name);
+            if (outer == nullptr || inner == nullptr) {
+                LOG(WARNING) << "SubGraphProcessor[" << vertex().name() << "] invalid data mapping "
+                             << outer_name << " -> " << inner_name;
+                return -1;
+            }
+            datas->emplace_back(outer, inner);
+        }
+        return 0;
+    };
+    if (bind(option->inputs, &_inputs) != 0 || bind(option->outputs, &_outputs) != 0) {
+        return -1;
+    }
+    _target = option->target.empty() ? _outputs[0].second : _child->get_data(option->target);
+    if (_target == nullptr) {
+        LOG(WARNING) << "SubGraphProcessor[" << vertex().name() << "] invalid target:" << option->target;
+        return -1;
+    }
+    return 0;
+}
+
+int SubGraphProcessor::process() {
+    // 外层图切换了executor，子图跟着切换
+    if (_child->get_executor() != vertex().get_executor()) {
+        _child->set_executor(vertex().get_executor());
+    }
+    for (auto& [outer, inner] : _inputs) {
+        inner->any_data().share(outer->any_data());
+        inner->release();
+    }
+    vertex().begin_async();
+    _child->run(_target, [this](int32_t error_code) {
+        on_child_done(error_code);
+    });
+    return ASYNC_PROCESSING;
+}
+
+int SubGraphProcessor::process_batch(size_t) {
+    LOG(WARNING) << "SubGraphProcessor[" << vertex().name() << "] doesn't support batch";
+    return -1;
+}
+
+void SubGraphProcessor::on_child_done(int32_t error_code) {
+    if (error_code == 0) {
+        for (auto& [outer, inner] : _outputs) {
+            outer->any_data().share(inner->any_data());
+        }
+    }
+    // 回调之后子图不再被访问，可以reset，输出已经共享给外层data
+    _child->reset();
+    if (error_code != 0) {
+        LOG(WARNING) << "SubGraphProcessor[" << vertex().name() << "] sub graph failed error_code:"
+                     << error_code;
+        vertex().finish_async(error_code);
+        return;
+    }
+    {
+        InlineContinuation::TailScope tail_scope;
+        for (auto& [outer, inner] : _outputs) {
+            outer->release();
+        }
+    }
+    vertex().finish_async(0);
+}
+
+}  // namespace gflow
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <vector>
+#include <memory>
+#include <string>
+#include <utility>
+#include "processor.h"
+#include "graph_template.h"
+
+namespace gflow {
+
+// 子图的配置，inputs/outputs是外层data名到子图data名的映射
+struct SubGraphOption {
+    std::shared_ptr<const GraphTemplate> graph_template;
+    std::vector<std::pair<std::string, std::string>> inputs;
+    std::vector<std::pair<std::string, std::string>> outputs;
+    // 子图执行的目标data，为空时使用第一个输出
+    std::string target;
+};
+
+// 把一个编译好的图作为一个vertex嵌入到外层图中。
+// 子图的输入输出和外层data共享同一个对象(Any::share)，不拷贝；
+// 子图的vertex在外层图的executor上调度，执行期间不占用外层的worker线程等待(异步结束，见GraphVertex::finish_async)。
+// 用法:
+// SubGraphOption option;
+// option.graph_template = GraphTemplate::compile(sub_graph);
+// option.inputs = {{"QUERY", "SUB_QUERY"}};
+// option.outputs = {{"RESULT", "SUB_RESULT"}};
+// SubGraphProcessor::add_to(graph, std::move(option));
+class SubGraphProcessor : public GraphProcessor {
+   public:
+    // 添加子图vertex，并按照映射声明外层的依赖和输出
+    static GraphVertex *add_to(Graph &graph, SubGraphOption option);
+
+    int setup() override;
+    int process() override;
+    // 子图异步执行，不支持批量
+    int process_batch(size_t batch_size) override;
+
+   private:
+    void on_child_done(int32_t error_code);
+
+    std::unique_ptr<GraphInstance> _child;
+    // (外层data, 子图data)
+    std::vector<std::pair<GraphData *, GraphData *>> _inputs;
+    std::vector<std::pair<GraphData *, GraphData *>> _outputs;
+    GraphData *_target = nullptr;
+};
+
+}  // namespace gflow
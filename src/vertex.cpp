@@ -5,10 +5,19 @@
 #include "graph_executor.h"
 #include "closure.h"
 
+#include <chrono>
+#include <thread>
+#include <algorithm>
+
 namespace gflow {
 
 GraphVertex::GraphVertex(Graph *graph, std::shared_ptr<GraphProcessor> processor, std::string name)
-    : _graph(graph), _processor(processor), _name(std::move(name)) {
+    : GraphVertex(graph, processor, std::make_shared<VertexMeta>()) {
+    _meta->name = std::move(name);
+}
+
+GraphVertex::GraphVertex(Graph *graph, std::shared_ptr<GraphProcessor> processor, std::shared_ptr<VertexMeta> meta)
+    : _graph(graph), _processor(processor), _meta(std::move(meta)) {
     _processor->set_vertex(this);
 }
 
@@ -30,6 +39,14 @@ GraphDependency *GraphVertex::optional_depend(std::string name) {
     return dependency;
 }
 
+void GraphVertex::lazy_depend(GraphData *data) {
+    for (GraphDependency *dependency : _dependencys) {
+        if (dependency->get_depend_data() == data) {
+            dependency->lazy();
+        }
+    }
+}
+
 GraphData *GraphVertex::emit(std::string name) {
     GraphData *data = _graph->create_data(name);
     data->set_producer(this);
@@ -38,21 +55,29 @@ GraphData *GraphVertex::emit(std::string name) {
 }
 
 GraphDependency* GraphVertex::depend_and_bind(const std::string& data_name, const std::string& var_name) {
-    if (_data_binding_map.count(var_name)) {
+    if (_meta->data_binding_map.count(var_name)) {
         LOG(FATAL) << "depend duplicated var name:" << var_name;
         return nullptr;
     }
-    _data_binding_map.emplace(var_name, data_name);
+    mutable_meta()->data_binding_map.emplace(var_name, data_name);
     auto *dependency = depend(data_name);
     return dependency;
 }
 
+GraphDependency* GraphVertex::optional_depend_and_bind(const std::string& data_name, const std::string& var_name) {
+    auto *dependency = depend_and_bind(data_name, var_name);
+    if (dependency != nullptr) {
+        _optional_dependencys.emplace_back(dependency);
+    }
+    return dependency;
+}
+
 GraphData* GraphVertex::emit_and_bind(const std::string& data_name, const std::string& var_name) {
-    if (_data_binding_map.count(var_name)) {
+    if (_meta->data_binding_map.count(var_name)) {
         LOG(FATAL) << "emit duplicated var name:" << var_name;
         return nullptr;
     }
-    _data_binding_map.emplace(var_name, data_name);
+    mutable_meta()->data_binding_map.emplace(var_name, data_name);
     GraphData *data = emit(data_name);
     return data;
 }
@@ -63,20 +88,502 @@ int GraphVertex::run() {
     if (_closure_context->is_mark_finished()) {
         return 0;
     }
-    int error_code = _processor->process();
+    size_t batch_size = _graph->batch_size();
+    // 批量执行和降级之后不对冲
+    if (_hedge_processor && batch_size == 0 && !_is_fallback) {
+        return run_hedged();
+    }
+    auto begin = std::chrono::steady_clock::now();
+    GraphProcessor *processor = active_processor();
+    int error_code = batch_size > 0 ? processor->process_batch(batch_size) : processor->process();
+    int64_t cost_ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - begin).count();
+    int64_t avg_cost_ns = _avg_cost_ns.load(std::memory_order_relaxed);
+    // 滑动平均，新样本权重1/8
+    avg_cost_ns = (avg_cost_ns == 0 ? cost_ns : avg_cost_ns + (cost_ns - avg_cost_ns) / 8);
+    _avg_cost_ns.store(avg_cost_ns, std::memory_order_relaxed);
+    if (error_code == GraphProcessor::ASYNC_PROCESSING) {
+        return 0;
+    }
+    return finish(error_code);
+}
+
+int GraphVertex::process_by_row(size_t batch_size) {
+    int error_code = 0;
+    for (size_t row = 0; row < batch_size && error_code == 0; ++row) {
+        GraphData::set_batch_row(row);
+        error_code = active_processor()->process();
+    }
+    GraphData::set_batch_row(-1);
+    if (error_code == GraphProcessor::ASYNC_PROCESSING) {
+        LOG(WARNING) << "GraphVertex[" << name() << "] async processor can't run by row";
+        return -1;
+    }
     if (error_code != 0) {
+        return error_code;
+    }
+    InlineContinuation::TailScope tail_scope;
+    ReadyBatch ready_batch;
+    for (GraphData *data : _emits) {
+        if (data->take_deferred_release()) {
+            data->release();
+        }
+    }
+    return 0;
+}
+
+int GraphVertex::run_hedged() {
+    _hedge_state.store(1, std::memory_order_release);
+    int64_t delay_ns = _meta->hedge->delay_ns();
+    if (delay_ns > 0) {
+        ClosureContext *closure_context = _closure_context;
+        // 定时任务执行完或者被取消之前图不能结束
+        closure_context->add_pending();
+        auto deadline = concurrent::TimerThread::Clock::now() + std::chrono::nanoseconds(delay_ns);
+        _hedge_timer_id.store(concurrent::TimerThread::instance().schedule(deadline, [this, closure_context]() {
+            start_hedge();
+            closure_context->done_pending();
+        }), std::memory_order_release);
+    }
+    run_attempt(0);
+    return 0;
+}
+
+void GraphVertex::start_hedge() {
+    uint32_t state = _hedge_state.load(std::memory_order_acquire);
+    do {
+        // 已经有结果，或者第一次执行已经失败结束
+        if ((state & HEDGE_SETTLED) || state == 0) {
+            return;
+        }
+    } while (!_hedge_state.compare_exchange_weak(state, state + 1, std::memory_order_acq_rel));
+    LOG(TRACE) << "GraphVertex[" << name() << "] start hedged execution";
+    _meta->hedge->add_hedge();
+    ClosureContext *closure_context = _closure_context;
+    closure_context->add_pending();
+    int ret = _executor->submit([this, closure_context]() {
+        run_attempt(1);
+        closure_context->done_pending();
+    });
+    if (ret != 0) {
+        LOG(WARNING) << "GraphVertex[" << name() << "] submit hedged execution failed";
+        finish_attempt(1, -1);
+        closure_context->done_pending();
+    }
+}
+
+void GraphVertex::cancel_hedge_timer() {
+    uint64_t timer_id = _hedge_timer_id.exchange(concurrent::TimerThread::INVALID_TIMER_ID,
+                                                 std::memory_order_acq_rel);
+    if (timer_id != concurrent::TimerThread::INVALID_TIMER_ID
+            && concurrent::TimerThread::instance().cancel(timer_id)) {
+        // 定时任务不会再执行，替它释放
+        _closure_context->done_pending();
+    }
+}
+
+void GraphVertex::run_attempt(int attempt) {
+    GraphProcessor *processor = attempt == 0 ? _processor.get() : _hedge_processor.get();
+    auto begin = std::chrono::steady_clock::now();
+    GraphData::set_attempt(this, attempt);
+    int error_code = processor->process();
+    GraphData::set_attempt(nullptr, -1);
+    if (error_code == GraphProcessor::ASYNC_PROCESSING) {
+        LOG(WARNING) << "GraphVertex[" << name() << "] async processor can't hedge";
+        error_code = -1;
+    }
+    if (error_code == 0) {
+        _meta->hedge->add_latency(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                        std::chrono::steady_clock::now() - begin).count());
+    }
+    finish_attempt(attempt, error_code);
+}
+
+void GraphVertex::finish_attempt(int attempt, int error_code) {
+    // 第一个成功的执行胜出
+    bool is_winner = error_code == 0
+            && !(_hedge_state.fetch_or(HEDGE_SETTLED, std::memory_order_acq_rel) & HEDGE_SETTLED);
+    if (!is_winner) {
+        for (GraphData *data : _emits) {
+            data->finish_attempt(attempt, false);
+        }
+        uint32_t state = _hedge_state.fetch_sub(1, std::memory_order_acq_rel) - 1;
+        // 所有执行都失败了，按普通的出错处理。对冲可能还没有发起，不用再等定时任务
+        if (error_code != 0 && state == 0) {
+            cancel_hedge_timer();
+            finish(error_code);
+        }
+        return;
+    }
+    cancel_hedge_timer();
+    // 发布之后图可能马上结束，不能再访问vertex的状态
+    _hedge_state.fetch_sub(1, std::memory_order_acq_rel);
+    if (attempt != 0) {
+        _meta->hedge->add_hedge_win();
+    }
+    {
+        InlineContinuation::TailScope tail_scope;
+        ReadyBatch ready_batch;
+        for (GraphData *data : _emits) {
+            if (data->finish_attempt(attempt, true)) {
+                data->release();
+            }
+        }
+    }
+    finish(0);
+}
+
+void GraphVertex::begin_async() {
+    // 异步执行期间图不能结束，在finish_async里释放
+    _closure_context->add_pending();
+}
+
+void GraphVertex::finish_async(int error_code) {
+    ClosureContext *closure_context = _closure_context;
+    finish(error_code);
+    closure_context->done_pending();
+}
+
+int GraphVertex::finish(int error_code) {
+    if (error_code != 0) {
+        if (recover(error_code)) {
+            return 0;
+        }
         LOG(TRACE) << "GraphVertex[" << name() << "] run error! mark_finish error_code:"
                     << error_code;
         _closure_context->mark_finish(error_code);
         return error_code;
     }
+    if (_has_memo_key) {
+        save_to_cache();
+    }
+    release_datas();
     LOG(NOTICE) << "GraphVertex[" << name() << "] is finished";
     _closure_context->one_vertex_finished();
     return 0;
 }
 
+bool GraphVertex::recover(int error_code) {
+    const ErrorPolicy &policy = _meta->error_policy;
+    if (_closure_context->is_mark_finished()) {
+        return false;
+    }
+    bool is_published = false;
+    for (GraphData *data : _emits) {
+        is_published = is_published || data->is_released();
+    }
+    // 已经发布了部分数据，下游可能已经开始执行，不能再重新产出
+    if (!is_published) {
+        if (!_is_fallback && _retry_num < policy.max_retry_num) {
+            int64_t delay_ms = policy.retry_backoff_ms << _retry_num;
+            ++_retry_num;
+            LOG(WARNING) << "GraphVertex[" << name() << "] error_code:" << error_code
+                         << ", retry:" << _retry_num << " after " << delay_ms << "ms";
+            redispatch(delay_ms);
+            return true;
+        }
+        if (!_is_fallback && _fallback_processor) {
+            _is_fallback = true;
+            LOG(WARNING) << "GraphVertex[" << name() << "] error_code:" << error_code
+                         << ", run fallback processor:" << policy.fallback_processor;
+            redispatch(0);
+            return true;
+        }
+    }
+    if (policy.is_optional) {
+        LOG(WARNING) << "GraphVertex[" << name() << "] error_code:" << error_code
+                     << ", optional vertex publish empty value";
+        publish_empty();
+        return true;
+    }
+    return false;
+}
+
+void GraphVertex::redispatch(int64_t delay_ms) {
+    ClosureContext *closure_context = _closure_context;
+    // 重新执行之前图不能结束，executor执行完释放
+    closure_context->add_pending();
+    auto execute = [this]() {
+        if (acquire_concurrency()) {
+            submit_to_executor();
+        }
+    };
+    if (delay_ms <= 0) {
+        execute();
+        return;
+    }
+    auto deadline = concurrent::TimerThread::Clock::now() + std::chrono::milliseconds(delay_ms);
+    concurrent::TimerThread::instance().schedule(deadline, std::move(execute));
+}
+
+void GraphVertex::publish_empty() {
+    size_t batch_size = _graph->batch_size();
+    {
+        ReadyBatch ready_batch;
+        for (GraphData *data : _emits) {
+            if (data->is_released()) {
+                continue;
+            }
+            data->any_data().clear();
+            for (size_t row = 0; row < batch_size; ++row) {
+                data->any_data(row).clear();
+            }
+            data->release();
+        }
+    }
+    release_datas();
+    _closure_context->one_vertex_finished();
+}
+
+void GraphVertex::hedge(HedgeOption option) {
+    mutable_meta()->hedge = std::make_shared<HedgePolicy>(option);
+}
+
+void GraphVertex::cacheable(MemoCacheOption option) {
+    mutable_meta()->memo_cache = std::make_shared<MemoCache>(option);
+}
+
+bool GraphVertex::memo_key(uint64_t *key, MemoCache::Inputs *inputs) {
+    size_t seed = 0;
+    size_t declared_num = _declared_dependency_num < 0 ? _dependencys.size() : _declared_dependency_num;
+    inputs->clear();
+    for (size_t i = 0; i < declared_num; ++i) {
+        GraphDependency *dependency = _dependencys[i];
+        GraphData *data = dependency->get_depend_data();
+        // 还没有被读取的惰性数据没有值，为了不提前执行生产者，这次不缓存
+        if (data->is_lazy_pending()) {
+            return false;
+        }
+        // 没有等到的依赖(超时、条件不成立)和有值的依赖区分开
+        if (dependency->is_timeout() || dependency->is_discarded() || !data->is_released()) {
+            hash_combine(&seed, 1);
+            inputs->emplace_back(nullptr);
+            continue;
+        }
+        // 命中时要比较保存的依赖数据，不能拷贝的不缓存
+        if (!data->any_data().hash(&seed) || !data->any_data().is_copyable()) {
+            return false;
+        }
+        inputs->emplace_back(&data->any_data());
+    }
+    *key = seed;
+    return true;
+}
+
+bool GraphVertex::publish_cached() {
+    _has_memo_key = false;
+    const auto &memo_cache = _meta->memo_cache;
+    // 批量执行的数据按行保存，不缓存
+    if (_graph->batch_size() > 0 || _closure_context->is_mark_finished()) {
+        return false;
+    }
+    uint64_t key = 0;
+    if (!memo_key(&key, &_memo_inputs)) {
+        return false;
+    }
+    auto value = memo_cache->lookup(key, _memo_inputs);
+    if (!value) {
+        _memo_key = key;
+        _has_memo_key = true;
+        return false;
+    }
+    LOG(TRACE) << "GraphVertex[" << name() << "] hit memo cache, publish without dispatch";
+    for (size_t i = 0; i < _emits.size(); ++i) {
+        _emits[i]->any_data() = (*value)[i];
+    }
+    {
+        ReadyBatch ready_batch;
+        for (GraphData *data : _emits) {
+            data->release();
+        }
+    }
+    release_datas();
+    _closure_context->one_vertex_finished();
+    return true;
+}
+
+void GraphVertex::save_to_cache() {
+    _has_memo_key = false;
+    MemoCache::Value value;
+    value.reserve(_emits.size());
+    for (GraphData *data : _emits) {
+        // 只缓存所有产出都发布了并且有值的结果
+        if (!data->is_released() || !data->any_data() || !data->any_data().is_copyable()) {
+            return;
+        }
+        value.emplace_back(data->any_data());
+    }
+    _meta->memo_cache->insert(_memo_key, _memo_inputs, std::move(value));
+}
+
+void GraphVertex::release_datas() {
+    // 对冲执行时落选的执行可能还在读写数据，不提前回收
+    if (!_graph->is_data_recycle() || _hedge_processor) {
+        return;
+    }
+    for (GraphDependency *dependency : _dependencys) {
+        dependency->get_depend_data()->consumer_finished();
+    }
+    // 生产者也是产出的使用者：流式输出在发布之后还在写，结果也在发布之后写入缓存
+    for (GraphData *data : _emits) {
+        data->consumer_finished();
+    }
+}
+
 void GraphVertex::execute() { 
-    _executor->execute(this, _closure_context); 
+    if (_meta->memo_cache && publish_cached()) {
+        return;
+    }
+    if (unlikely(_meta->is_lazy) && park()) {
+        return;
+    }
+    // 融合的后继由上游的任务直接接着执行，不经过调度
+    if (_fused_prev != nullptr && InlineContinuation::claim_fused(this)) {
+        return;
+    }
+    if (ReadyBatch::collect(this)) {
+        return;
+    }
+    dispatch();
+}
+
+bool GraphVertex::park() {
+    // 下游在上游之前激活，没有激活的下游说明数据是run的目标，需要照常产出。
+    // 条件数据和不通过pull读取的下游需要数据ready时就有值
+    for (GraphData *data : _emits) {
+        if (data->is_condition()) {
+            return false;
+        }
+        bool has_activated = false;
+        for (GraphDependency *dependency : data->get_down_streams()) {
+            if (!dependency->get_attached_vertex()->is_activated()) {
+                continue;
+            }
+            if (!dependency->is_lazy()) {
+                return false;
+            }
+            has_activated = true;
+        }
+        if (!has_activated) {
+            return false;
+        }
+    }
+    ClosureContext *closure_context = _closure_context;
+    if (closure_context->is_mark_finished()) {
+        return true;
+    }
+    LOG(TRACE) << "GraphVertex[" << name() << "] is lazy, wait for pull";
+    _lazy_state.store(LAZY_PARKED, std::memory_order_release);
+    for (GraphData *data : _emits) {
+        data->notify_lazy();
+    }
+    // 对图来说惰性vertex已经结束，被读取时在读取者的执行过程中运行
+    closure_context->one_vertex_finished();
+    return true;
+}
+
+bool GraphVertex::pull() {
+    uint32_t state = LAZY_PARKED;
+    if (_lazy_state.compare_exchange_strong(state, LAZY_RUNNING, std::memory_order_acq_rel)) {
+        int error_code = -1;
+        if (!_closure_context->is_mark_finished()) {
+            size_t batch_size = _graph->batch_size();
+            GraphProcessor *processor = active_processor();
+            error_code = batch_size > 0 ? processor->process_batch(batch_size) : processor->process();
+            if (error_code == GraphProcessor::ASYNC_PROCESSING) {
+                LOG(WARNING) << "GraphVertex[" << name() << "] lazy vertex doesn't support async processor";
+                error_code = -1;
+            }
+        }
+        if (error_code == 0) {
+            if (_has_memo_key) {
+                save_to_cache();
+            }
+        } else if (!_meta->error_policy.is_optional) {
+            _closure_context->mark_finish(error_code);
+        }
+        LOG(TRACE) << "GraphVertex[" << name() << "] lazy pull finished error_code:" << error_code;
+        // 惰性vertex在被读取时才使用依赖，执行完再释放
+        release_datas();
+        state = (error_code == 0 ? LAZY_DONE : LAZY_FAILED);
+        _lazy_state.store(state, std::memory_order_release);
+        return state == LAZY_DONE;
+    }
+    // 并发的读取等第一个读取者执行完
+    while (state == LAZY_RUNNING) {
+        std::this_thread::yield();
+        state = _lazy_state.load(std::memory_order_acquire);
+    }
+    if (state != LAZY_DONE) {
+        LOG(WARNING) << "GraphVertex[" << name() << "] pull failed lazy_state:" << state;
+    }
+    return state == LAZY_DONE;
+}
+
+void GraphVertex::dispatch() {
+    ClosureContext *closure_context = _closure_context;
+    // 图已经出错或者超时，还没开始的vertex不再调度
+    if (closure_context->is_mark_finished()) {
+        LOG(TRACE) << "GraphVertex[" << name() << "] skip dispatch, graph is finished";
+        return;
+    }
+    closure_context->add_pending();
+    // 并发组的名额用完时在组内排队，不占用worker
+    if (!acquire_concurrency()) {
+        LOG(TRACE) << "GraphVertex[" << name() << "] wait in concurrency group:"
+                   << _meta->concurrency_group->name();
+        return;
+    }
+    if (InlineContinuation::offer(this)) {
+        return;
+    }
+    submit_to_executor();
+}
+
+void GraphVertex::submit_to_executor() {
+    ClosureContext *closure_context = _closure_context;
+    if (_executor->execute(this, closure_context) != 0) {
+        LOG(WARNING) << "GraphVertex[" << name() << "] execute failed";
+        closure_context->mark_finish(-1);
+        release_concurrency();
+        closure_context->done_pending();
+    }
+}
+
+void GraphVertex::release_concurrency() {
+    const auto &group = _meta->concurrency_group;
+    if (!group) {
+        return;
+    }
+    // 名额直接转给排队的vertex
+    GraphVertex *next = group->release();
+    if (next != nullptr) {
+        next->submit_to_executor();
+    }
+}
+
+int64_t GraphVertex::estimated_cost() const {
+    if (_meta->cost_hint_us > 0) {
+        return _meta->cost_hint_us * 1000;
+    }
+    int64_t avg_cost_ns = _avg_cost_ns.load(std::memory_order_relaxed);
+    return avg_cost_ns > 0 ? avg_cost_ns : 1;
+}
+
+bool GraphVertex::is_inline_continuation() {
+    return _graph->is_inline_continuation();
+}
+
+bool GraphVertex::is_abandoned() {
+    if (_emits.empty()) {
+        return false;
+    }
+    for (auto data : _emits) {
+        if (!data->is_abandoned()) {
+            return false;
+        }
+    }
+    return true;
 }
 
 bool GraphVertex::is_ready_before_run() { return is_ready(); }
@@ -97,6 +604,10 @@ void GraphVertex::add_waiting_num() {
     _waiting_num.fetch_add(1, std::memory_order_release);
 }
 
+void GraphVertex::add_waiting_num(int64_t num) {
+    _waiting_num.fetch_add(num, std::memory_order_release);
+}
+
 void GraphVertex::activate(std::vector<GraphVertex *> &vertexs,
                            ClosureContext *closure_context) {
     set_closure_context(closure_context);
@@ -132,12 +643,48 @@ void GraphVertex::reset() {
     */
     _waiting_num.store(0, std::memory_order_release);
     _is_activated.store(false, std::memory_order_relaxed);
+    _retry_num = 0;
+    _is_fallback = false;
+    _hedge_state.store(0, std::memory_order_relaxed);
+    _lazy_state.store(LAZY_IDLE, std::memory_order_relaxed);
 }
 
 GraphData *GraphVertex::get_data(std::string name) {
     return _graph->get_data(name);
 }
 
-void GraphVertex::build() { _processor->setup(); }
+void GraphVertex::build() {
+    if (_declared_dependency_num < 0) {
+        _declared_dependency_num = _dependencys.size();
+    }
+    _processor->setup();
+    if (_meta->hedge && !_hedge_processor) {
+        if (!_meta->processor_creator) {
+            LOG(WARNING) << "GraphVertex[" << name() << "] processor can't be recreated, disable hedge";
+        } else {
+            _hedge_processor = _meta->processor_creator();
+            _hedge_processor->set_vertex(this);
+            _hedge_processor->setup();
+            for (GraphData *data : _emits) {
+                data->set_attempt_num(2);
+            }
+        }
+    }
+    const std::string &fallback_name = _meta->error_policy.fallback_processor;
+    if (!fallback_name.empty() && !_fallback_processor) {
+        _fallback_processor = ProcessorFactory::instance().create(fallback_name);
+        if (_fallback_processor == nullptr) {
+            LOG(WARNING) << "GraphVertex[" << name() << "] fallback processor:"
+                         << fallback_name << " not found";
+            return;
+        }
+        _fallback_processor->set_vertex(this);
+        if (_fallback_processor->setup() != 0) {
+            LOG(WARNING) << "GraphVertex[" << name() << "] fallback processor:"
+                         << fallback_name << " setup failed";
+            _fallback_processor = nullptr;
+        }
+    }
+}
 
 }  // namespace
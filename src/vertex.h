@@ -7,6 +7,12 @@
 #include <atomic>
 #include <any>
 #include <memory>
+#include <functional>
+
+#include "processor.h"
+#include "memo_cache.h"
+#include "hedge.h"
+#include "concurrency_group.h"
 
 #include <boost/preprocessor/cat.hpp>
 #include <boost/preprocessor/control/if.hpp>
@@ -31,10 +37,47 @@ class GraphExecutor;
 
 class GraphVertex;
 class ClosureContext;
+class GraphTemplate;
+
+// vertex出错(process返回非0)时的处理策略，按顺序尝试：重试、降级、发布空值，都没有配置或者都失败时整个图出错结束。
+// 重试和降级要求processor出错时还没有发布数据
+struct ErrorPolicy {
+    // 最多重试的次数
+    int max_retry_num = 0;
+    // 第1次重试前等待的时间(毫秒)，之后每次翻倍，0表示立即重新调度
+    int64_t retry_backoff_ms = 0;
+    // 重试都失败后执行的降级processor(注册的名字)，和原processor使用相同的变量绑定，产出相同的数据
+    std::string fallback_processor;
+    // 最终还是失败时把没有发布的数据发布为空值，下游拿到nullptr，图继续执行
+    bool is_optional = false;
+};
+
+// vertex上只读的元数据，建图完成后不再修改，同一个GraphTemplate创建的所有图实例共享一份
+struct VertexMeta {
+    std::string name;
+    std::any option;
+    // var name和graph data name的绑定，key是var name
+    // 例如 var name为"response", data name为"RESPONSE"
+    std::unordered_map<std::string, std::string> data_binding_map;
+    // 用于在图实例上重新创建processor，为空表示该vertex无法从模板实例化
+    ProcessorCreator processor_creator;
+    // 预估的执行耗时(微秒)，用于计算调度优先级，0表示未设置
+    int64_t cost_hint_us = 0;
+    // 跨请求的结果缓存，多个图实例共享，为空表示不缓存
+    std::shared_ptr<MemoCache> memo_cache;
+    ErrorPolicy error_policy;
+    // 对冲策略和耗时统计，多个图实例共享，为空表示不对冲
+    std::shared_ptr<HedgePolicy> hedge;
+    // 所属的并发组，为空表示不限制
+    std::shared_ptr<ConcurrencyGroup> concurrency_group;
+    // 惰性执行，见GraphVertex::set_lazy
+    bool is_lazy = false;
+};
 
 class GraphVertex {
    public:
     explicit GraphVertex(Graph *graph, std::shared_ptr<GraphProcessor> processor, std::string name);
+    explicit GraphVertex(Graph *graph, std::shared_ptr<GraphProcessor> processor, std::shared_ptr<VertexMeta> meta);
     // 禁止拷贝和移动
     inline GraphVertex(GraphVertex &&) = delete;
     inline GraphVertex(const GraphVertex &) = delete;
@@ -46,29 +89,46 @@ class GraphVertex {
     bool is_ready();
     bool decr_waiting_num();
     void add_waiting_num();
+    void add_waiting_num(int64_t num);
+    // ActivationPlan激活时使用，计划保证每个vertex只激活一次
+    void mark_activated() { _is_activated.store(true, std::memory_order_relaxed); }
+    bool is_activated() const { return _is_activated.load(std::memory_order_relaxed); }
     GraphData *get_data(std::string name);
     void activate(std::vector<GraphVertex *> &vertexs,
                   ClosureContext *closure_context);
     void reset();
     int run();
+    // 异步执行的processor(process返回GraphProcessor::ASYNC_PROCESSING)在真正结束时调用，
+    // 调用前需要先在process里调用begin_async
+    void begin_async();
+    void finish_async(int error_code);
+    // 逐行调用process，每行的读写都作用在data的对应行上，发布的数据在所有行执行完之后统一发布
+    int process_by_row(size_t batch_size);
+    // vertex ready之后调用，和同一批ready的vertex按优先级排序后再调度，见ReadyBatch
     void execute();
+    // 立即交给executor调度
+    void dispatch();
+    // 执行结束后归还并发组的名额，由InlineContinuation::run调用
+    void release_concurrency();
+    bool is_inline_continuation();
     void set_closure_context(ClosureContext *closure_context) {
         _closure_context = closure_context;
     }
     ClosureContext *get_closure_context() { return _closure_context; }
     void set_executor(GraphExecutor *executor) { _executor = executor; }
+    GraphExecutor *get_executor() { return _executor; }
     
     template<typename T>
     const T& get_option() {
-        return std::any_cast<const T&>(_option);
+        return std::any_cast<const T&>(_meta->option);
     }
     std::any& get_any_option() {
-        return _option;
+        return _meta->option;
     }
 
     template<typename T>
     void set_option(T&& option) {
-        _option = std::move(option);
+        mutable_meta()->option = std::move(option);
     }
     
     template <typename T>
@@ -77,7 +137,7 @@ class GraphVertex {
         return get_context<T>();
     }
 
-    const std::string& name() { return _name; }
+    const std::string& name() { return _meta->name; }
 
     template <typename T>
     T &get_context() {
@@ -89,36 +149,185 @@ class GraphVertex {
     }
 
     std::string get_binding_data_name(std::string var_name) {
-        if (_data_binding_map.count(var_name) == 0) {
+        auto iter = _meta->data_binding_map.find(var_name);
+        if (iter == _meta->data_binding_map.end()) {
             throw std::runtime_error("can't find graph data for var name[" + var_name + "]");
         }
-        return _data_binding_map[var_name];
+        return iter->second;
     }
 
+    void set_processor_creator(ProcessorCreator creator) {
+        mutable_meta()->processor_creator = std::move(creator);
+    }
+
+    // 设置预估耗时，优先于实测的平均耗时参与优先级计算
+    void set_cost_hint(int64_t cost_us) {
+        mutable_meta()->cost_hint_us = cost_us;
+    }
+    // 预估耗时(纳秒)：cost hint，其次是实测的平均耗时，都没有返回1
+    int64_t estimated_cost() const;
+    // 调度优先级，越大越先调度，由Graph::update_priority计算
+    int64_t priority() const { return _priority; }
+    void set_priority(int64_t priority) { _priority = priority; }
+    // 融合在当前vertex后面的下游(见Graph::fuse_vertexes)，当前vertex结束时让它ready的话直接在上游的任务里接着执行
+    GraphVertex *fused_next() const { return _fused_next; }
+    // 当前vertex融合在哪个上游的后面
+    GraphVertex *fused_prev() const { return _fused_prev; }
+    void set_fused_next(GraphVertex *next) {
+        if (_fused_next != nullptr) {
+            _fused_next->_fused_prev = nullptr;
+        }
+        _fused_next = next;
+        if (next != nullptr) {
+            next->_fused_prev = this;
+        }
+    }
+    // 在图中的下标，见GraphTopology
+    uint32_t idx() const { return _idx; }
+    void set_idx(uint32_t idx) { _idx = idx; }
+
+    // 纯函数的vertex开启跨请求的结果缓存，key是所有依赖数据的hash，命中时直接发布缓存的结果，不再调度执行。
+    // 依赖的类型需要支持std::hash，产出的类型需要可以拷贝，否则照常执行
+    void cacheable(MemoCacheOption option = MemoCacheOption());
+    const std::shared_ptr<MemoCache>& get_memo_cache() { return _meta->memo_cache; }
+
+    // 加入并发组，默认使用REGISTER_PROCESSOR_WITH_GROUP注册时指定的组
+    void set_concurrency_group(const std::string &group_name) {
+        mutable_meta()->concurrency_group = ConcurrencyGroupRegistry::instance().get_or_create(group_name);
+    }
+    const std::shared_ptr<ConcurrencyGroup>& get_concurrency_group() { return _meta->concurrency_group; }
+
+    // 出错时的重试、降级策略，见ErrorPolicy
+    void set_error_policy(ErrorPolicy policy) {
+        mutable_meta()->error_policy = std::move(policy);
+    }
+    const ErrorPolicy& get_error_policy() { return _meta->error_policy; }
+    // 本次执行已经重试的次数
+    int retry_num() const { return _retry_num; }
+    // 本次执行是否由降级processor产出
+    bool is_fallback() const { return _is_fallback; }
+
+    // 耗时长尾的vertex开启对冲：执行超过最近耗时的分位数还没结束时，用另一个processor实例再执行一次，
+    // 先成功的执行发布数据，另一个的结果丢弃。processor需要是同步的，并且可以通过processor_creator重新创建
+    void hedge(HedgeOption option = HedgeOption());
+    const std::shared_ptr<HedgePolicy>& get_hedge_policy() { return _meta->hedge; }
+    // 对冲的执行已经有结果了，落后的执行可以通过GraphProcessor::cancelled提前退出
+    bool is_hedge_settled() const {
+        return _hedge_state.load(std::memory_order_acquire) & HEDGE_SETTLED;
+    }
+
+    // 惰性执行：ready之后先不执行，直接通知下游数据可用，下游第一次读取(LAZY_DEPEND_VAR、
+    // GraphDependency::value)时才在读取的线程上同步执行，并发的读取只执行一次，没人读取就不执行。
+    // 只有产出的data都有激活的下游、并且激活的下游依赖都通过pull读取(见GraphDependency::lazy)时才推迟，
+    // 否则照常执行，例如data是run的目标、被DEPEND_VAR或子图直接读取、是条件数据。processor需要是同步的
+    void set_lazy(bool is_lazy) {
+        mutable_meta()->is_lazy = is_lazy;
+    }
+    bool is_lazy() const { return _meta->is_lazy; }
+    // 惰性vertex被读取时执行，返回产出的data是否可用
+    bool pull();
+
+    const std::vector<GraphDependency *>& get_dependencys() { return _dependencys; }
+    const std::vector<GraphData *>& get_emits() { return _emits; }
+    // 发布的数据都被下游放弃了(依赖超时)，继续执行也没有意义
+    bool is_abandoned();
+
     // 建图相关
     GraphDependency* depend_and_bind(const std::string& data_name, const std::string& var_name);
+    GraphDependency* optional_depend_and_bind(const std::string& data_name, const std::string& var_name);
     GraphData* emit_and_bind(const std::string& data_name, const std::string& var_name);
     GraphDependency *depend(std::string name);
     GraphDependency *optional_depend(std::string name);
+    // LAZY_DEPEND_VAR在setup时调用，标记依赖data的声明通过pull读取
+    void lazy_depend(GraphData *data);
     GraphData *emit(std::string name);
     void build();
 
    private:
+    friend class GraphTemplate;
+
+    int finish(int error_code);
+    // 按ErrorPolicy处理错误，返回true表示已经安排重试、降级或者发布了空值
+    bool recover(int error_code);
+    // 等待delay_ms之后重新交给executor执行
+    void redispatch(int64_t delay_ms);
+    // 占用并发组的名额，返回false表示已经在组内排队，归还名额时再交给executor
+    bool acquire_concurrency() {
+        return !_meta->concurrency_group || _meta->concurrency_group->acquire_or_enqueue(this);
+    }
+    void submit_to_executor();
+    void publish_empty();
+    int run_hedged();
+    // timer线程上发起对冲的执行
+    void start_hedge();
+    void run_attempt(int attempt);
+    void finish_attempt(int attempt, int error_code);
+    // 取消还没有触发的对冲定时任务
+    void cancel_hedge_timer();
+    // 降级之后执行降级processor
+    GraphProcessor *active_processor() {
+        return _is_fallback ? _fallback_processor.get() : _processor.get();
+    }
+    // 惰性vertex ready时通知下游，返回false表示需要照常执行
+    bool park();
+    // 命中缓存时发布缓存的结果并返回true
+    bool publish_cached();
+    // 只用声明的依赖计算key，build时添加的依赖不计入
+    bool memo_key(uint64_t *key, MemoCache::Inputs *inputs);
+    void save_to_cache();
+    // 执行结束、不会再读写依赖和产出的数据时调用，没有其他vertex在使用的中间数据提前回收
+    void release_datas();
+
+    // 元数据被多个图实例共享时先拷贝一份再修改(copy on write)
+    VertexMeta *mutable_meta() {
+        if (_meta.use_count() > 1) {
+            _meta = std::make_shared<VertexMeta>(*_meta);
+        }
+        return _meta.get();
+    }
+
+    // 调度时访问的字段放在前面，尽量落在同一条cache line上；名字、option、绑定关系等放在共享的VertexMeta里
+    std::atomic<int64_t> _waiting_num = 0;
+    ClosureContext *_closure_context = nullptr;
+    GraphExecutor *_executor = nullptr;
+    Graph *_graph = nullptr;
+    std::shared_ptr<GraphProcessor> _processor;
+    std::shared_ptr<VertexMeta> _meta;
+    int64_t _priority = 0;
+    GraphVertex *_fused_next = nullptr;
+    GraphVertex *_fused_prev = nullptr;
+    std::atomic<bool> _is_activated{false};
+    uint32_t _idx = 0;
+    // 实测耗时的滑动平均(纳秒)
+    std::atomic<int64_t> _avg_cost_ns{0};
+
     std::vector<GraphDependency *> _dependencys;
     std::vector<GraphDependency *> _optional_dependencys;
     std::vector<GraphData *> _emits;
-    Graph *_graph = nullptr;
-    std::any _option;
     std::any _any_ctx;
-    std::shared_ptr<GraphProcessor> _processor;
-    std::atomic<int64_t> _waiting_num = 0;
-    GraphExecutor *_executor = nullptr;
-    ClosureContext *_closure_context = nullptr;
-    std::string _name;
-    std::atomic<bool> _is_activated{false};
-    // var name和graph data name的绑定，key是var name
-    // 例如 var name为"response", data name为"RESPONSE"
-    std::unordered_map<std::string, std::string> _data_binding_map;
+    // build之前声明的依赖个数，build阶段processor自己添加的依赖(例如表达式的变量)不计入
+    int64_t _declared_dependency_num = -1;
+    // 本次执行的缓存key和依赖数据，没有命中时执行结束后写入缓存
+    uint64_t _memo_key = 0;
+    MemoCache::Inputs _memo_inputs;
+    bool _has_memo_key = false;
+    // ErrorPolicy::fallback_processor创建的实例，build时创建
+    std::shared_ptr<GraphProcessor> _fallback_processor;
+    int _retry_num = 0;
+    bool _is_fallback = false;
+    // 对冲执行的processor实例，build时创建
+    std::shared_ptr<GraphProcessor> _hedge_processor;
+    // 低位是执行中的次数，HEDGE_SETTLED表示已经有执行胜出或者全部失败
+    static constexpr uint32_t HEDGE_SETTLED = 1u << 31;
+    std::atomic<uint32_t> _hedge_state{0};
+    std::atomic<uint64_t> _hedge_timer_id{0};
+    // 惰性执行的状态
+    static constexpr uint32_t LAZY_IDLE = 0;
+    static constexpr uint32_t LAZY_PARKED = 1;
+    static constexpr uint32_t LAZY_RUNNING = 2;
+    static constexpr uint32_t LAZY_DONE = 3;
+    static constexpr uint32_t LAZY_FAILED = 4;
+    std::atomic<uint32_t> _lazy_state{LAZY_IDLE};
 };
 
 }  // namespace
@@ -200,7 +409,11 @@ class GraphVertex {
 #define DEPEND_VAR(type, var_name) ((0, type, var_name))
 #define EMIT_VAR(type, var_name) ((1, type, var_name))
 
+// 惰性的依赖，变量是LazyData<type>，第一次访问时才执行数据的生产者(见GraphVertex::set_lazy)
+#define LAZY_DEPEND_VAR(type, var_name) ((2, type, var_name))
+
 #define IS_EMIT_V2(args) BOOST_PP_EQUAL(BOOST_PP_TUPLE_ELEM(0, args), 1)
+#define IS_LAZY_V2(args) BOOST_PP_EQUAL(BOOST_PP_TUPLE_ELEM(0, args), 2)
 
 // EMIT(std::vector<std::string>, response)
 // 相当于std::vector<std::string>
@@ -215,29 +428,39 @@ class GraphVertex {
 #define GRAPH_DATA_VAR_V2(args) BOOST_PP_CAT(RAW_VAR_V2(args), _graph_data__)
 
 // DEPEND(std::vector<std::string>, response)，生成如下代码：
-// std::vector<std::string>* response = nullptr;
+// std::vector<std::string>* response{};
 // GraphData* response_graph_data__ = nullptr;
+// LAZY_DEPEND_VAR的变量类型是LazyData<std::vector<std::string>>
 #define DECLARE_V2(r, data, args) \
-    DATA_TYPE_V2(args)* RAW_VAR_V2(args) = nullptr;\
+    BOOST_PP_IF(IS_LAZY_V2(args), LazyData<DATA_TYPE_V2(args)>, DATA_TYPE_V2(args)*) RAW_VAR_V2(args){};\
     GraphData* GRAPH_DATA_VAR_V2(args) = nullptr;
 
 // response_graph_data__ = get_data(_vertex->get_binding_data_name("response"));
+// 如果是LAZY_DEPEND_VAR，还会标记依赖通过pull读取：
+// _vertex->lazy_depend(response_graph_data__);
 #define SETUP_V2(r, data, args) \
-    GRAPH_DATA_VAR_V2(args) = get_data(_vertex->get_binding_data_name(BOOST_PP_STRINGIZE(RAW_VAR_V2(args))));
+    GRAPH_DATA_VAR_V2(args) = get_data(_vertex->get_binding_data_name(BOOST_PP_STRINGIZE(RAW_VAR_V2(args)))); \
+    BOOST_PP_IF(IS_LAZY_V2(args), _vertex->lazy_depend(GRAPH_DATA_VAR_V2(args));, DO_NOTHING())
 
 // 如果是EMIT，生成如下代码：
 // response = response_graph_data__->make<std::vector<std::string>>()->pointer<std::vector<std::string>>();
 // 如果是DEPEND，生成如下代码: 
 // response = response_graph_data__->pointer<std::vector<std::string>>();
 // response_graph_data__->any_data().require_same_type<std::vector<std::string>>("RESPONSE");
+// 如果是LAZY_DEPEND_VAR，只创建句柄，不访问数据：
+// response = LazyData<std::vector<std::string>>(response_graph_data__);
 #define INIT_V2(r, data, args) \
     BOOST_PP_IF( \
-        IS_EMIT_V2(args), \
-        RAW_VAR_V2(args) = GRAPH_DATA_VAR_V2(args)->make<DATA_TYPE_V2(args)>()->pointer<DATA_TYPE_V2(args)>();, \
-        RAW_VAR_V2(args) = GRAPH_DATA_VAR_V2(args)->pointer<DATA_TYPE_V2(args)>();  \
-        GRAPH_DATA_VAR_V2(args)->any_data().require_same_type<DATA_TYPE_V2(args)>( \
-                        _vertex->get_binding_data_name(BOOST_PP_STRINGIZE(RAW_VAR_V2(args))) \
-        ); \
+        IS_LAZY_V2(args), \
+        RAW_VAR_V2(args) = LazyData<DATA_TYPE_V2(args)>(GRAPH_DATA_VAR_V2(args));, \
+        BOOST_PP_IF( \
+            IS_EMIT_V2(args), \
+            RAW_VAR_V2(args) = GRAPH_DATA_VAR_V2(args)->make<DATA_TYPE_V2(args)>()->pointer<DATA_TYPE_V2(args)>();, \
+            RAW_VAR_V2(args) = GRAPH_DATA_VAR_V2(args)->pointer<DATA_TYPE_V2(args)>();  \
+            GRAPH_DATA_VAR_V2(args)->any_data().require_same_type<DATA_TYPE_V2(args)>( \
+                            _vertex->get_binding_data_name(BOOST_PP_STRINGIZE(RAW_VAR_V2(args))) \
+            ); \
+        ) \
     )
 
 #define AUTO_RELEASE_V2(r, data, args) \
@@ -0,0 +1,95 @@
+#include <thread>
+#include <atomic>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "concurrent/epoch.h"
+
+using gflow::concurrent::EpochManager;
+
+class EpochManagerTest : public ::testing::Test {
+private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+protected:
+};
+
+TEST_F(EpochManagerTest, test_is_safe) {
+    EpochManager manager;
+    ASSERT_EQ(manager.min_active_epoch(), EpochManager::QUIESCENT);
+    uint64_t retire_epoch = 0;
+    {
+        EpochManager::Guard guard(manager);
+        {
+            // 嵌套的临界区不改变宣告的epoch
+            EpochManager::Guard nested(manager);
+        }
+        retire_epoch = manager.advance();
+        // 推进之前进入的读者还可能看到旧对象
+        ASSERT_FALSE(manager.is_safe(retire_epoch));
+        std::thread([&] {
+            // 推进之后进入的读者不影响回收
+            EpochManager::Guard other(manager);
+            ASSERT_EQ(manager.min_active_epoch(), retire_epoch);
+        }).join();
+    }
+    ASSERT_TRUE(manager.is_safe(retire_epoch));
+}
+
+TEST_F(EpochManagerTest, test_slot_reuse) {
+    // 退出的线程归还槽位，先后创建的线程数超过MAX_THREAD_NUM也都有槽位
+    EpochManager manager;
+    for (size_t i = 0; i < EpochManager::MAX_THREAD_NUM * 2; ++i) {
+        std::thread([&] {
+            EpochManager::Guard guard(manager);
+            // 没有槽位的读者不宣告epoch
+            ASSERT_EQ(manager.min_active_epoch(), manager.epoch());
+        }).join();
+    }
+    uint64_t retire_epoch = manager.advance();
+    ASSERT_TRUE(manager.is_safe(retire_epoch));
+}
+
+TEST_F(EpochManagerTest, test_reclaim_concurrently) {
+    // 读者在临界区内读取指针，写者替换之后安全时才回收，读者不会读到已经回收的对象
+    EpochManager manager;
+    std::atomic<int*> current{new int(0)};
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> readers;
+    for (int i = 0; i < 4; ++i) {
+        readers.emplace_back([&] {
+            while (!stop.load()) {
+                EpochManager::Guard guard(manager);
+                int* value = current.load();
+                ASSERT_GE(*value, 0);
+            }
+        });
+    }
+    std::vector<std::pair<uint64_t, int*>> retired;
+    for (int i = 1; i <= 10000; ++i) {
+        int* old = current.exchange(new int(i));
+        retired.emplace_back(manager.advance(), old);
+        for (size_t j = 0; j < retired.size();) {
+            if (manager.is_safe(retired[j].first)) {
+                // 回收前改成非法值，如果还有读者会检查失败
+                *retired[j].second = -1;
+                delete retired[j].second;
+                retired[j] = retired.back();
+                retired.pop_back();
+            } else {
+                ++j;
+            }
+        }
+    }
+    stop = true;
+    for (auto& th : readers) {
+        th.join();
+    }
+    for (auto& [epoch, value] : retired) {
+        ASSERT_TRUE(manager.is_safe(epoch));
+        delete value;
+    }
+    delete current.load();
+}
@@ -0,0 +1,80 @@
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "gtest/gtest.h"
+
+#include "concurrent/lock_free_bounded_queue.h"
+
+using gflow::concurrent::LockFreeBoundedQueue;
+
+class LockFreeBoundedQueueTest : public ::testing::Test {
+private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+protected:
+};
+
+TEST_F(LockFreeBoundedQueueTest, test_push_pop) {
+    // 容量向上取2的幂
+    LockFreeBoundedQueue<std::unique_ptr<int>> queue(3);
+    ASSERT_EQ(queue.capacity(), 4);
+    for (int i = 0; i < 4; ++i) {
+        auto value = std::make_unique<int>(i);
+        ASSERT_TRUE(queue.try_push(value));
+        ASSERT_EQ(value, nullptr);
+    }
+    // 满了，失败时元素保持不变
+    auto value = std::make_unique<int>(4);
+    ASSERT_FALSE(queue.try_push(value));
+    ASSERT_EQ(*value, 4);
+    ASSERT_EQ(queue.size(), 4);
+    for (int i = 0; i < 4; ++i) {
+        std::unique_ptr<int> out;
+        ASSERT_TRUE(queue.try_pop(out));
+        ASSERT_EQ(*out, i);
+    }
+    std::unique_ptr<int> out;
+    ASSERT_FALSE(queue.try_pop(out));
+}
+
+TEST_F(LockFreeBoundedQueueTest, test_concurrent) {
+    // 多生产者多消费者，每个元素恰好被取走一次
+    constexpr int producer_num = 3;
+    constexpr int item_num = 100000;
+    LockFreeBoundedQueue<int> queue(64);
+    std::vector<std::atomic<int>> taken(producer_num * item_num);
+    std::atomic<int> popped{0};
+    std::vector<std::thread> threads;
+    for (int p = 0; p < producer_num; ++p) {
+        threads.emplace_back([&queue, p] {
+            for (int i = 0; i < item_num; ++i) {
+                int value = p * item_num + i;
+                while (!queue.try_push(value)) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (int c = 0; c < 2; ++c) {
+        threads.emplace_back([&] {
+            while (popped.load() < producer_num * item_num) {
+                int value = 0;
+                if (queue.try_pop(value)) {
+                    taken[value]++;
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    for (int i = 0; i < producer_num * item_num; ++i) {
+        ASSERT_EQ(taken[i].load(), 1) << "item " << i;
+    }
+}
@@ -0,0 +1,62 @@
+#include <iostream>
+#include <vector>
+#include <mutex>
+#include <future>
+#include "gtest/gtest.h"
+
+#include "concurrent/timer.h"
+
+using gflow::concurrent::TimerThread;
+
+class TimerThreadTest : public ::testing::Test {
+private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+protected:
+};
+
+TEST_F(TimerThreadTest, test_schedule_and_cancel) {
+    TimerThread timer;
+    auto now = TimerThread::Clock::now();
+    std::mutex mutex;
+    std::vector<int> fired;
+    std::promise<void> done;
+    // 按deadline先后执行，和schedule的顺序无关
+    timer.schedule(now + std::chrono::milliseconds(30), [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        fired.emplace_back(3);
+        done.set_value();
+    });
+    timer.schedule(now + std::chrono::milliseconds(10), [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        fired.emplace_back(1);
+    });
+    auto timer_id = timer.schedule(now + std::chrono::milliseconds(20), [&] {
+        std::lock_guard<std::mutex> lock(mutex);
+        fired.emplace_back(2);
+    });
+    ASSERT_TRUE(timer.cancel(timer_id));
+    ASSERT_FALSE(timer.cancel(timer_id));
+    done.get_future().get();
+    std::lock_guard<std::mutex> lock(mutex);
+    ASSERT_EQ(fired, std::vector<int>({1, 3}));
+}
+
+TEST_F(TimerThreadTest, test_cancel_wait_running) {
+    // 任务正在执行时cancel会等它执行完
+    TimerThread timer;
+    std::atomic<bool> started{false};
+    std::atomic<bool> finished{false};
+    auto timer_id = timer.schedule(TimerThread::Clock::now(), [&] {
+        started = true;
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        finished = true;
+    });
+    while (!started.load()) {
+        std::this_thread::yield();
+    }
+    ASSERT_FALSE(timer.cancel(timer_id));
+    ASSERT_TRUE(finished.load());
+}
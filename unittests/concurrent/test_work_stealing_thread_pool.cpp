@@ -0,0 +1,145 @@
+#include <iostream>
+#include <memory>
+#include <set>
+#include <mutex>
+#include "gtest/gtest.h"
+
+#include "concurrent/work_stealing_thread_pool.h"
+
+using gflow::concurrent::WorkStealingThreadPool;
+using gflow::concurrent::WorkStealingDeque;
+using gflow::concurrent::work_stealing_async;
+
+class WorkStealingThreadPoolTest : public ::testing::Test {
+private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+protected:
+};
+
+TEST_F(WorkStealingThreadPoolTest, test_deque) {
+    WorkStealingDeque<int> deque(4);
+    int items[5] = {0, 1, 2, 3, 4};
+    for (int i = 0; i < 4; ++i) {
+        ASSERT_TRUE(deque.push(&items[i]));
+    }
+    // 满了
+    ASSERT_FALSE(deque.push(&items[4]));
+    ASSERT_EQ(deque.size(), 4);
+    // owner后进先出，窃取先进先出
+    ASSERT_EQ(deque.pop(), &items[3]);
+    ASSERT_EQ(deque.steal(), &items[0]);
+    ASSERT_EQ(deque.pop(), &items[2]);
+    ASSERT_EQ(deque.steal(), &items[1]);
+    ASSERT_EQ(deque.pop(), nullptr);
+    ASSERT_EQ(deque.steal(), nullptr);
+}
+
+TEST_F(WorkStealingThreadPoolTest, test_deque_concurrent_steal) {
+    // owner不停push/pop，其他线程窃取，每个元素恰好被取走一次
+    constexpr int item_num = 100000;
+    WorkStealingDeque<int> deque(64);
+    std::vector<int> items(item_num);
+    std::vector<std::atomic<int>> taken(item_num);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> thieves;
+    for (int i = 0; i < 3; ++i) {
+        thieves.emplace_back([&] {
+            while (!done.load() || deque.size() > 0) {
+                int* item = deque.steal();
+                if (item != nullptr) {
+                    taken[item - items.data()]++;
+                }
+            }
+        });
+    }
+    for (int i = 0; i < item_num; ++i) {
+        while (!deque.push(&items[i])) {
+            int* item = deque.pop();
+            if (item != nullptr) {
+                taken[item - items.data()]++;
+            }
+        }
+    }
+    done = true;
+    for (auto& th : thieves) {
+        th.join();
+    }
+    for (int i = 0; i < item_num; ++i) {
+        ASSERT_EQ(taken[i].load(), 1) << "item " << i;
+    }
+}
+
+TEST_F(WorkStealingThreadPoolTest, test_enqueue) {
+    auto thread_pool = std::make_shared<WorkStealingThreadPool>(4);
+    auto future = thread_pool->enqueue([](int a, std::string b) {
+        return b + std::to_string(a);
+    }, 3, "hello");
+    ASSERT_EQ(future.get(), "hello3");
+
+    auto p_cnt = std::make_unique<int>(100);
+    auto future2 = work_stealing_async([](std::unique_ptr<int> p) {
+        return *p + 1;
+    }, std::move(p_cnt));
+    ASSERT_EQ(future2.get(), 101);
+}
+
+TEST_F(WorkStealingThreadPoolTest, test_nested_spawn) {
+    // worker内部提交的任务进入本地队列，空闲worker窃取执行
+    auto thread_pool = std::make_shared<WorkStealingThreadPool>(4, 16);
+    std::atomic<int> counter{0};
+    std::mutex mutex;
+    std::set<std::thread::id> thread_ids;
+    std::function<void(int)> spawn = [&](int depth) {
+        counter++;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            thread_ids.insert(std::this_thread::get_id());
+        }
+        if (depth == 0) {
+            return;
+        }
+        for (int i = 0; i < 2; ++i) {
+            thread_pool->enqueue([&spawn, depth]() {
+                spawn(depth - 1);
+            });
+        }
+    };
+    thread_pool->enqueue([&spawn]() {
+        spawn(12);
+    });
+    while (counter.load() < (1 << 13) - 1) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    thread_pool->stop_and_wait();
+    ASSERT_EQ(counter.load(), (1 << 13) - 1);
+    LOG(NOTICE) << "nested spawn run on thread num:" << thread_ids.size();
+}
+
+TEST_F(WorkStealingThreadPoolTest, test_graceful_stop) {
+    // 测试优雅退出，等所有任务处理完才退出
+    std::atomic<int> counter{0};
+    {
+        auto thread_pool = std::make_shared<WorkStealingThreadPool>(2);
+        for (int i = 0; i < 1000; ++i) {
+            thread_pool->enqueue([&counter]() {
+                counter++;
+            });
+        }
+    }
+    ASSERT_EQ(counter.load(), 1000);
+}
+
+TEST_F(WorkStealingThreadPoolTest, test_stop_concurrently) {
+    // 测试多线程多次调用stop_and_wait，程序正常不出core
+    auto thread_pool = std::make_shared<WorkStealingThreadPool>(5);
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < 10; ++i) {
+        threads.emplace_back([&] { thread_pool->stop_and_wait(); });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+}
@@ -4,6 +4,7 @@
 #include <iostream>
 #include <string>
 #include <vector>
+#include <set>
 #include <chrono>
 #include <thread>
 #include <any>
@@ -15,6 +16,8 @@
 #include "vertex.h"
 #include "graph.h"
 #include "expr_processor.h"
+#include "graph_template.h"
+#include "graph_loader.h"
 
 DEFINE_int32(round, 2, "round");
 
@@ -557,4 +560,1643 @@ TEST_F(GraphTest, test_wrong_data_type) {
     std::cout << "response -> " << response->raw<int32_t>() << std::endl;
     g->reset();
     delete g;
-}
\ No newline at end of file
+}
+
+class ChainProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *output = *input + 1;
+        thread_ids->emplace_back(std::this_thread::get_id());
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        DEPEND_VAR(std::vector<std::thread::id>, thread_ids)
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR(ChainProcessor);
+
+TEST_F(GraphTest, test_inline_continuation) {
+    constexpr int chain_length = 8;
+    auto create_graph = [](bool inline_continuation) -> Graph *{
+        Graph *g = new Graph;
+        g->set_inline_continuation(inline_continuation);
+        for (int i = 0; i < chain_length; ++i) {
+            GraphVertex *v = g->add_vertex("ChainProcessor");
+            v->depend_and_bind("CHAIN_" + std::to_string(i), "input");
+            v->depend_and_bind("THREAD_IDS", "thread_ids");
+            v->emit_and_bind("CHAIN_" + std::to_string(i + 1), "output");
+        }
+        g->build();
+        return g;
+    };
+    for (bool inline_continuation : {true, false}) {
+        Graph *g = create_graph(inline_continuation);
+        for (int round = 0; round < 2; ++round) {
+            auto* thread_ids = g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>()
+                                ->pointer<std::vector<std::thread::id>>();
+            thread_ids->clear();
+            g->get_data("THREAD_IDS")->release();
+            g->get_data("CHAIN_0")->emit_value<int32_t>(int32_t(0));
+            GraphData *response = g->get_data("CHAIN_" + std::to_string(chain_length));
+            auto *closure_context = g->run(response);
+            ASSERT_EQ(closure_context->wait_finish(), 0);
+            delete closure_context;
+            ASSERT_EQ(response->raw<int32_t>(), chain_length);
+            ASSERT_EQ(thread_ids->size(), chain_length);
+            if (inline_continuation) {
+                // 整条链都在第一个vertex所在的worker上执行
+                for (auto& id : *thread_ids) {
+                    ASSERT_EQ(id, thread_ids->front());
+                }
+            }
+            g->reset();
+        }
+        delete g;
+    }
+}
+
+TEST_F(GraphTest, test_work_stealing_executor) {
+    constexpr int chain_length = 8;
+    Graph *g = new Graph;
+    g->set_executor(AsyncGraphExecutor::instance(concurrent::ThreadPoolBackend::WORK_STEALING));
+    for (int i = 0; i < chain_length; ++i) {
+        GraphVertex *v = g->add_vertex("ChainProcessor");
+        v->depend_and_bind("CHAIN_" + std::to_string(i), "input");
+        v->depend_and_bind("THREAD_IDS", "thread_ids");
+        v->emit_and_bind("CHAIN_" + std::to_string(i + 1), "output");
+    }
+    g->build();
+    for (int round = 0; round < 10; ++round) {
+        auto* thread_ids = g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>()
+                            ->pointer<std::vector<std::thread::id>>();
+        thread_ids->clear();
+        g->get_data("THREAD_IDS")->release();
+        g->get_data("CHAIN_0")->emit_value<int32_t>(int32_t(round));
+        GraphData *response = g->get_data("CHAIN_" + std::to_string(chain_length));
+        auto *closure_context = g->run(response);
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(response->raw<int32_t>(), round + chain_length);
+        ASSERT_EQ(thread_ids->size(), chain_length);
+        g->reset();
+    }
+    delete g;
+}
+
+// 只记录调度顺序，不真正执行vertex
+class RecordExecutor : public GraphExecutor {
+   public:
+    int32_t execute(GraphVertex* vertex, ClosureContext*) override {
+        vertexes.emplace_back(vertex);
+        return 0;
+    }
+    std::vector<GraphVertex*> vertexes;
+};
+
+TEST_F(GraphTest, test_critical_path_priority) {
+    Graph *g = new Graph;
+    // 记录每一次调度，不融合
+    g->set_vertex_fusion(false);
+    auto add_chain_vertex = [g](const std::string& input, const std::string& output, int64_t cost_us) {
+        GraphVertex *v = g->add_vertex("ChainProcessor");
+        v->depend_and_bind(input, "input");
+        v->depend_and_bind("THREAD_IDS", "thread_ids");
+        v->emit_and_bind(output, "output");
+        v->set_cost_hint(cost_us);
+        return v;
+    };
+    GraphVertex *short_vertex = add_chain_vertex("S_IN", "S_OUT", 1);
+    GraphVertex *long_vertex1 = add_chain_vertex("L_IN", "L_MID", 10);
+    GraphVertex *long_vertex2 = add_chain_vertex("L_MID", "L_OUT", 10);
+    GraphVertex *mid_vertex = add_chain_vertex("M_IN", "M_OUT", 15);
+    GraphVertex *join_vertex = add_chain_vertex("L_OUT", "RESULT", 0);
+    join_vertex->depend("S_OUT");
+    join_vertex->depend("M_OUT");
+    g->build();
+
+    // 优先级是到终点的最长路径耗时
+    ASSERT_EQ(join_vertex->priority(), 1);
+    ASSERT_EQ(long_vertex2->priority(), 10000 + 1);
+    ASSERT_EQ(long_vertex1->priority(), 10000 + 10000 + 1);
+    ASSERT_EQ(mid_vertex->priority(), 15000 + 1);
+    ASSERT_EQ(short_vertex->priority(), 1000 + 1);
+
+    RecordExecutor executor;
+    g->set_executor(&executor);
+    g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>();
+    g->get_data("THREAD_IDS")->release();
+    for (auto name : {"S_IN", "M_IN", "L_IN"}) {
+        g->get_data(name)->emit_value<int32_t>(int32_t(0));
+    }
+    auto *closure_context = g->run(g->get_data("RESULT"));
+    // 同时ready的vertex按关键路径从长到短调度
+    ASSERT_EQ(executor.vertexes.size(), 3);
+    ASSERT_EQ(executor.vertexes[0], long_vertex1);
+    ASSERT_EQ(executor.vertexes[1], mid_vertex);
+    ASSERT_EQ(executor.vertexes[2], short_vertex);
+    // 在当前线程依次执行，让图跑完
+    for (size_t i = 0; i < executor.vertexes.size(); ++i) {
+        InlineContinuation::run(executor.vertexes[i]);
+    }
+    ASSERT_EQ(executor.vertexes.size(), 5);
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    g->reset();
+    delete g;
+}
+
+class FailedProcessor : public GraphProcessor {
+   public:
+    int process() {
+        return 3;
+    }
+};
+REGISTER_PROCESSOR(FailedProcessor);
+
+TEST_F(GraphTest, test_run_with_callback) {
+    constexpr int chain_length = 8;
+    Graph *g = new Graph;
+    g->set_inline_continuation(true);
+    for (int i = 0; i < chain_length; ++i) {
+        GraphVertex *v = g->add_vertex("ChainProcessor");
+        v->depend_and_bind("CHAIN_" + std::to_string(i), "input");
+        v->depend_and_bind("THREAD_IDS", "thread_ids");
+        v->emit_and_bind("CHAIN_" + std::to_string(i + 1), "output");
+    }
+    g->build();
+    for (int round = 0; round < 10; ++round) {
+        auto* thread_ids = g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>()
+                            ->pointer<std::vector<std::thread::id>>();
+        thread_ids->clear();
+        g->get_data("THREAD_IDS")->release();
+        g->get_data("CHAIN_0")->emit_value<int32_t>(int32_t(round));
+        GraphData *response = g->get_data("CHAIN_" + std::to_string(chain_length));
+        std::promise<int32_t> done;
+        std::thread::id callback_thread_id;
+        // 回调在执行最后一个vertex的线程上，回调里直接reset图
+        g->run(response, [&](int32_t error_code) {
+            callback_thread_id = std::this_thread::get_id();
+            g->reset();
+            done.set_value(error_code);
+        });
+        ASSERT_EQ(done.get_future().get(), 0);
+        ASSERT_EQ(response->raw<int32_t>(), round + chain_length);
+        ASSERT_EQ(callback_thread_id, thread_ids->back());
+        ASSERT_NE(callback_thread_id, std::this_thread::get_id());
+    }
+    delete g;
+
+    // 算子出错时回调返回错误码
+    g = new Graph;
+    g->add_vertex("FailedProcessor")->emit("FAILED_RESULT");
+    g->build();
+    std::promise<int32_t> done;
+    g->run(g->get_data("FAILED_RESULT"), [&](int32_t error_code) {
+        done.set_value(error_code);
+    });
+    ASSERT_EQ(done.get_future().get(), 3);
+    g->reset();
+    delete g;
+}
+
+class CancellableProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        auto begin = Clock::now();
+        while (!cancelled() && Clock::now() - begin < std::chrono::seconds(5)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        *output = 1;
+        return 0;
+    }
+    VAR_DECLARE(
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR(CancellableProcessor);
+
+TEST_F(GraphTest, test_deadline) {
+    Graph *g = new Graph;
+    g->add_vertex("CancellableProcessor")->emit_and_bind("SLOW_RESULT", "output");
+    GraphVertex *v = g->add_vertex("ChainProcessor");
+    v->depend_and_bind("SLOW_RESULT", "input");
+    v->depend_and_bind("THREAD_IDS", "thread_ids");
+    v->emit_and_bind("RESULT", "output");
+    g->build();
+
+    auto* thread_ids = g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>()
+                        ->pointer<std::vector<std::thread::id>>();
+    g->get_data("THREAD_IDS")->release();
+    auto begin = Clock::now();
+    auto *closure_context = g->run(g->get_data("RESULT"), std::chrono::milliseconds(50));
+    ASSERT_EQ(closure_context->wait_finish(), GraphTimeoutError);
+    // 等正在执行的processor感知到超时退出
+    delete closure_context;
+    ASSERT_LT(Clock::now() - begin, std::chrono::seconds(2));
+    // 超时后下游vertex不再执行
+    ASSERT_TRUE(thread_ids->empty());
+    g->reset();
+
+    // 非阻塞执行时，超时也会回调，即使图在等永远不会发布的外部输入
+    g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>();
+    std::promise<int32_t> done;
+    g->run(g->get_data("RESULT"), [&](int32_t error_code) {
+        done.set_value(error_code);
+    }, std::chrono::milliseconds(20));
+    ASSERT_EQ(done.get_future().get(), GraphTimeoutError);
+    g->reset();
+
+    // 没有超时的情况
+    g->get_data("THREAD_IDS")->release();
+    g->get_data("SLOW_RESULT")->emit_value<int32_t>(int32_t(5));
+    closure_context = g->run(g->get_data("RESULT"), std::chrono::milliseconds(5000));
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(g->get_data("RESULT")->raw<int32_t>(), 6);
+    g->reset();
+    delete g;
+}
+
+class SlowRecallProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        // 结果被下游放弃后提前退出
+        auto begin = Clock::now();
+        while (!cancelled() && Clock::now() - begin < std::chrono::seconds(5)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        mids->clear();
+        mids->emplace_back("SLOW_001");
+        return 0;
+    }
+    VAR_DECLARE(
+        EMIT_VAR(std::vector<std::string>, mids)
+    );
+};
+REGISTER_PROCESSOR(SlowRecallProcessor);
+
+class FastRecallProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        mids->clear();
+        mids->emplace_back("FAST_001");
+        return 0;
+    }
+    VAR_DECLARE(
+        EMIT_VAR(std::vector<std::string>, mids)
+    );
+};
+REGISTER_PROCESSOR(FastRecallProcessor);
+
+class FanInProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        merged->clear();
+        for (GraphDependency *dep : vertex().get_optional_dependencys()) {
+            auto* depend_mids = dep->value<std::vector<std::string>>();
+            if (depend_mids != nullptr) {
+                merged->insert(merged->end(), depend_mids->begin(), depend_mids->end());
+            }
+        }
+        return 0;
+    }
+    VAR_DECLARE(
+        EMIT_VAR(std::vector<std::string>, merged)
+    );
+};
+REGISTER_PROCESSOR(FanInProcessor);
+
+TEST_F(GraphTest, test_dependency_timeout) {
+    Graph *g = new Graph;
+    g->add_vertex("SlowRecallProcessor")->emit_and_bind("SLOW_RESULT", "mids");
+    g->add_vertex("FastRecallProcessor")->emit_and_bind("FAST_RESULT", "mids");
+    GraphVertex *fan_in = g->add_vertex("FanInProcessor");
+    GraphDependency *slow_dep = fan_in->optional_depend("SLOW_RESULT")->timeout(30);
+    GraphDependency *fast_dep = fan_in->optional_depend("FAST_RESULT");
+    fan_in->emit_and_bind("MERGED", "merged");
+    // 非optional依赖不支持超时
+    ASSERT_EQ(fan_in->depend("FAST_RESULT")->timeout(30)->get_timeout(), 0);
+    g->build();
+    ASSERT_EQ(slow_dep->get_timeout(), 30);
+    ASSERT_EQ(fast_dep->get_timeout(), 0);
+
+    auto tpl = GraphTemplate::compile(*g);
+    ASSERT_TRUE(tpl != nullptr);
+    Graph *instance = tpl->create_instance();
+    for (Graph *graph : {g, instance}) {
+        for (int round = 0; round < 2; ++round) {
+            auto begin = Clock::now();
+            GraphData *merged = graph->get_data("MERGED");
+            auto *closure_context = graph->run(merged);
+            ASSERT_EQ(closure_context->wait_finish(), 0);
+            delete closure_context;
+            // 慢的召回超时后被放弃，感知到cancelled()提前退出
+            ASSERT_LT(Clock::now() - begin, std::chrono::seconds(2));
+            ASSERT_EQ(merged->raw<std::vector<std::string>>(), std::vector<std::string>({"FAST_001"}));
+            graph->reset();
+        }
+    }
+    delete instance;
+    delete g;
+}
+
+TEST_F(GraphTest, test_activation_plan) {
+    // 很长的链路，激活计划不会递归
+    constexpr int chain_length = 2000;
+    Graph *g = new Graph;
+    g->set_inline_continuation(true);
+    for (int i = 0; i < chain_length; ++i) {
+        GraphVertex *v = g->add_vertex("ChainProcessor");
+        v->depend_and_bind("CHAIN_" + std::to_string(i), "input");
+        v->depend_and_bind("THREAD_IDS", "thread_ids");
+        v->emit_and_bind("CHAIN_" + std::to_string(i + 1), "output");
+    }
+    g->build();
+    GraphData *response = g->get_data("CHAIN_" + std::to_string(chain_length));
+    const ActivationPlan *plan = g->get_activation_plan(response);
+    ASSERT_EQ(plan->vertexes().size(), chain_length);
+    for (int round = 0; round < 3; ++round) {
+        g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>()
+            ->pointer<std::vector<std::thread::id>>()->clear();
+        g->get_data("THREAD_IDS")->release();
+        g->get_data("CHAIN_0")->emit_value<int32_t>(int32_t(round));
+        ASSERT_TRUE(plan->is_applicable());
+        auto *closure_context = g->run(response);
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(response->raw<int32_t>(), round + chain_length);
+        g->reset();
+    }
+
+    // 中间的data提前发布，回退到递归激活，上游不再执行
+    GraphData *short_response = g->get_data("CHAIN_10");
+    ASSERT_EQ(g->get_activation_plan(short_response)->vertexes().size(), 10);
+    auto* thread_ids = g->create_data("THREAD_IDS")->make<std::vector<std::thread::id>>()
+                        ->pointer<std::vector<std::thread::id>>();
+    thread_ids->clear();
+    g->get_data("THREAD_IDS")->release();
+    g->get_data("CHAIN_5")->emit_value<int32_t>(int32_t(100));
+    ASSERT_FALSE(g->get_activation_plan(short_response)->is_applicable());
+    auto *closure_context = g->run(short_response);
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(short_response->raw<int32_t>(), 105);
+    ASSERT_EQ(thread_ids->size(), 5);
+    g->reset();
+    delete g;
+}
+
+std::atomic<int> g_row_process_num{0};
+std::atomic<int> g_batch_process_num{0};
+
+// 没有实现process_batch，批量执行时逐行调用
+class RowAddOneProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        g_row_process_num++;
+        *output = *input + 1;
+        return 0;
+    }
+    GRAPH_DECLARE(
+        DEPEND(int32_t, BATCH_IN, input)
+        EMIT(int32_t, BATCH_MID, output)
+    );
+};
+REGISTER_PROCESSOR(RowAddOneProcessor);
+
+// 实现了process_batch，一次处理整批
+class BatchSquareProcessor : public GraphProcessor {
+   public:
+    int process() {
+        int32_t input = get_data("BATCH_MID")->raw<int32_t>();
+        get_data("BATCH_OUT")->make<int32_t>()->raw<int32_t>() = input * input;
+        get_data("BATCH_OUT")->release();
+        return 0;
+    }
+    int process_batch(size_t batch_size) {
+        g_batch_process_num++;
+        GraphData* input = get_data("BATCH_MID");
+        GraphData* output = get_data("BATCH_OUT");
+        for (size_t row = 0; row < batch_size; ++row) {
+            int32_t value = input->raw<int32_t>(row);
+            output->make<int32_t>(row)->raw<int32_t>(row) = value * value;
+        }
+        output->release();
+        return 0;
+    }
+};
+REGISTER_PROCESSOR(BatchSquareProcessor);
+
+TEST_F(GraphTest, test_batch_run) {
+    constexpr size_t batch_size = 64;
+    Graph g;
+    GraphVertex* add_one = g.add_vertex("RowAddOneProcessor");
+    add_one->depend("BATCH_IN");
+    add_one->emit("BATCH_MID");
+    GraphVertex* square = g.add_vertex("BatchSquareProcessor");
+    square->depend("BATCH_MID");
+    square->emit("BATCH_OUT");
+    g.build();
+
+    g.set_batch_size(batch_size);
+    for (int round = 0; round < 3; ++round) {
+        g_row_process_num = 0;
+        g_batch_process_num = 0;
+        GraphData* input = g.get_data("BATCH_IN");
+        for (size_t row = 0; row < batch_size; ++row) {
+            input->set_value<int32_t>(row, row + round);
+        }
+        input->release();
+        GraphData* output = g.get_data("BATCH_OUT");
+        auto* closure_context = g.run(output);
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        // 整个批次只调度一次
+        ASSERT_EQ(g_row_process_num.load(), (int)batch_size);
+        ASSERT_EQ(g_batch_process_num.load(), 1);
+        for (size_t row = 0; row < batch_size; ++row) {
+            int32_t expect = (row + round + 1) * (row + round + 1);
+            ASSERT_EQ(output->raw<int32_t>(row), expect);
+        }
+        g.reset();
+    }
+
+    // 条件data各行一致时按它选择分支，不一致时执行失败
+    Graph cond_graph;
+    GraphVertex* cond_vertex = cond_graph.add_vertex("RowAddOneProcessor");
+    cond_vertex->depend("BATCH_IN")->when("BATCH_FLAG");
+    cond_vertex->emit("BATCH_MID");
+    cond_graph.build();
+    cond_graph.set_batch_size(2);
+    auto run_cond = [&cond_graph](int flag0, int flag1) {
+        GraphData* flag = cond_graph.get_data("BATCH_FLAG");
+        flag->set_value<int>(0, std::move(flag0));
+        flag->set_value<int>(1, std::move(flag1));
+        flag->release();
+        GraphData* input = cond_graph.get_data("BATCH_IN");
+        input->set_value<int32_t>(0, 1);
+        input->set_value<int32_t>(1, 2);
+        input->release();
+        auto* closure_context = cond_graph.run(cond_graph.get_data("BATCH_MID"));
+        int error_code = closure_context->wait_finish();
+        delete closure_context;
+        cond_graph.reset();
+        return error_code;
+    };
+    g_row_process_num = 0;
+    ASSERT_EQ(run_cond(1, 1), 0);
+    ASSERT_EQ(g_row_process_num.load(), 2);
+    ASSERT_NE(run_cond(1, 0), 0);
+    ASSERT_EQ(g_row_process_num.load(), 2);
+
+    // 切换回普通执行
+    g.set_batch_size(0);
+    g.get_data("BATCH_IN")->emit_value<int32_t>(int32_t(2));
+    auto* closure_context = g.run(g.get_data("BATCH_OUT"));
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(g.get_data("BATCH_OUT")->raw<int32_t>(), 9);
+}
+
+// 记录条件结束和分支开始的先后顺序
+std::atomic<int> g_speculate_seq{0};
+std::atomic<int> g_speculate_flag_done_seq{0};
+std::atomic<int> g_speculate_branch_start_seq{0};
+
+class SlowFlagProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        *flag = vertex().get_option<int>();
+        g_speculate_flag_done_seq = ++g_speculate_seq;
+        return 0;
+    }
+    GRAPH_DECLARE(
+        EMIT(int, SPECULATE_FLAG, flag)
+    );
+};
+REGISTER_PROCESSOR(SlowFlagProcessor);
+
+class SlowBranchProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        g_speculate_branch_start_seq = ++g_speculate_seq;
+        // 结果被丢弃后提前退出
+        for (int i = 0; i < 20 && !cancelled(); ++i) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        *branch = 42;
+        return 0;
+    }
+    GRAPH_DECLARE(
+        EMIT(int32_t, SPECULATE_BRANCH, branch)
+    );
+};
+REGISTER_PROCESSOR(SlowBranchProcessor);
+
+class SpeculateMergeProcessor : public GraphProcessor {
+   public:
+    int process() {
+        auto* branch = vertex().get_optional_dependencys()[0]->value<int32_t>();
+        get_data("SPECULATE_MERGED")->make<int32_t>()->raw<int32_t>() = (branch == nullptr ? -1 : *branch);
+        get_data("SPECULATE_MERGED")->release();
+        return 0;
+    }
+};
+REGISTER_PROCESSOR(SpeculateMergeProcessor);
+
+TEST_F(GraphTest, test_speculate) {
+    // 返回分支是否在条件结束之前开始执行
+    auto run = [](int flag, bool speculate, int32_t* merged) {
+        g_speculate_seq = 0;
+        g_speculate_flag_done_seq = 0;
+        g_speculate_branch_start_seq = 0;
+        Graph g;
+        g.add_vertex("SlowFlagProcessor")->emit("SPECULATE_FLAG");
+        g.get_data("SPECULATE_FLAG")->get_producer()->set_option<int>(std::move(flag));
+        g.add_vertex("SlowBranchProcessor")->emit("SPECULATE_BRANCH");
+        GraphVertex* merge = g.add_vertex("SpeculateMergeProcessor");
+        GraphDependency* dep = merge->optional_depend("SPECULATE_BRANCH")->when("SPECULATE_FLAG");
+        if (speculate) {
+            dep->speculate();
+        }
+        merge->emit("SPECULATE_MERGED");
+        g.build();
+        auto* closure_context = g.run(g.get_data("SPECULATE_MERGED"));
+        EXPECT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        *merged = g.get_data("SPECULATE_MERGED")->raw<int32_t>();
+        return g_speculate_branch_start_seq < g_speculate_flag_done_seq;
+    };
+    int32_t merged = 0;
+    // 不推测执行时分支等条件结束才开始
+    ASSERT_FALSE(run(1, false, &merged));
+    ASSERT_EQ(merged, 42);
+    // 条件和分支并行执行
+    ASSERT_TRUE(run(1, true, &merged));
+    ASSERT_EQ(merged, 42);
+    // 条件为false，推测执行的结果被丢弃
+    run(0, true, &merged);
+    ASSERT_EQ(merged, -1);
+    run(0, false, &merged);
+    ASSERT_EQ(merged, -1);
+}
+
+std::atomic<int> g_memo_process_num{0};
+
+class MemoSquareProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        g_memo_process_num++;
+        output->assign({*input, *input * *input});
+        return 0;
+    }
+    GRAPH_DECLARE(
+        DEPEND(int32_t, MEMO_IN, input)
+        EMIT(std::vector<int32_t>, MEMO_OUT, output)
+    );
+};
+REGISTER_PROCESSOR(MemoSquareProcessor);
+
+TEST_F(GraphTest, test_memo_cache) {
+    auto build = [](Graph* g, MemoCacheOption option) {
+        GraphVertex* v = g->add_vertex("MemoSquareProcessor");
+        v->depend("MEMO_IN");
+        v->emit("MEMO_OUT");
+        v->cacheable(option);
+        g->build();
+    };
+    auto run = [](Graph* g, int32_t input) -> std::vector<int32_t> {
+        g->get_data("MEMO_IN")->emit_value<int32_t>(std::move(input));
+        auto* closure_context = g->run(g->get_data("MEMO_OUT"));
+        EXPECT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        std::vector<int32_t> result = g->get_data("MEMO_OUT")->raw<std::vector<int32_t>>();
+        g->reset();
+        return result;
+    };
+
+    Graph prototype;
+    build(&prototype, MemoCacheOption());
+    g_memo_process_num = 0;
+    for (int32_t input : {1, 2, 1, 2, 3, 1}) {
+        ASSERT_EQ(run(&prototype, input), std::vector<int32_t>({input, input * input}));
+    }
+    // 命中的请求不再执行processor
+    ASSERT_EQ(g_memo_process_num.load(), 3);
+    auto& memo_cache = prototype.get_data("MEMO_OUT")->get_producer()->get_memo_cache();
+    auto stats = memo_cache->stats();
+    ASSERT_EQ(stats.hit_num, 3);
+    ASSERT_EQ(stats.miss_num, 3);
+    ASSERT_EQ(stats.entry_num, 3);
+    ASSERT_GT(stats.memory_bytes, 0);
+
+    // hash相同时比较依赖数据，不会返回别的输入的结果
+    MemoCache collision_cache{MemoCacheOption()};
+    Any one(int32_t(1));
+    Any two(int32_t(2));
+    collision_cache.insert(7, {&one}, {Any(std::string("one"))});
+    ASSERT_EQ(collision_cache.lookup(7, {&two}), nullptr);
+    ASSERT_EQ(collision_cache.lookup(7, {nullptr}), nullptr);
+    ASSERT_NE(collision_cache.lookup(7, {&one}), nullptr);
+
+    // 模板的实例共享同一个缓存
+    auto tpl = GraphTemplate::compile(prototype);
+    std::unique_ptr<GraphInstance> instance(tpl->create_instance());
+    ASSERT_EQ(run(instance.get(), 3), std::vector<int32_t>({3, 9}));
+    ASSERT_EQ(g_memo_process_num.load(), 3);
+
+    // 过期
+    MemoCacheOption ttl_option;
+    ttl_option.ttl = std::chrono::milliseconds(50);
+    Graph ttl_graph;
+    build(&ttl_graph, ttl_option);
+    g_memo_process_num = 0;
+    run(&ttl_graph, 5);
+    run(&ttl_graph, 5);
+    ASSERT_EQ(g_memo_process_num.load(), 1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(80));
+    run(&ttl_graph, 5);
+    ASSERT_EQ(g_memo_process_num.load(), 2);
+    ASSERT_EQ(ttl_graph.get_data("MEMO_OUT")->get_producer()->get_memo_cache()->stats().eviction_num, 1);
+
+    // 超过内存上限淘汰最久没有使用的
+    MemoCacheOption small_option;
+    small_option.shard_num = 1;
+    small_option.max_memory_bytes = 1024;
+    Graph small_graph;
+    build(&small_graph, small_option);
+    for (int32_t input = 0; input < 100; ++input) {
+        run(&small_graph, input);
+    }
+    auto small_stats = small_graph.get_data("MEMO_OUT")->get_producer()->get_memo_cache()->stats();
+    ASSERT_LE(small_stats.memory_bytes, 1024);
+    ASSERT_GT(small_stats.eviction_num, 0);
+    ASSERT_EQ(small_stats.entry_num + small_stats.eviction_num, 100);
+}
+
+class FusionChainProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *output = *input;
+        output->emplace_back(std::this_thread::get_id());
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(std::vector<std::thread::id>, input)
+        EMIT_VAR(std::vector<std::thread::id>, output)
+    );
+};
+REGISTER_PROCESSOR(FusionChainProcessor);
+
+class CountExecutor : public AsyncGraphExecutor {
+   public:
+    int32_t execute(GraphVertex* vertex, ClosureContext* closure_context) override {
+        execute_num++;
+        return AsyncGraphExecutor::execute(vertex, closure_context);
+    }
+    std::atomic<int> execute_num{0};
+};
+
+TEST_F(GraphTest, test_vertex_fusion) {
+    constexpr int chain_length = 6;
+    Graph g;
+    g.set_vertex_fusion(true);
+    CountExecutor executor;
+    std::vector<GraphVertex*> chain;
+    for (int i = 0; i < chain_length; ++i) {
+        GraphVertex* v = g.add_vertex("FusionChainProcessor");
+        v->depend_and_bind("FUSION_" + std::to_string(i), "input");
+        v->emit_and_bind("FUSION_" + std::to_string(i + 1), "output");
+        chain.emplace_back(v);
+    }
+    // 下游还依赖条件表达式的vertex，有两个上游，都不融合
+    GraphVertex* guarded = g.add_vertex("FusionChainProcessor");
+    guarded->depend_and_bind("FUSION_" + std::to_string(chain_length), "input")->when("FUSION_FLAG");
+    guarded->emit_and_bind("FUSION_GUARDED", "output");
+    g.build();
+    for (int i = 0; i + 1 < chain_length; ++i) {
+        ASSERT_EQ(chain[i]->fused_next(), chain[i + 1]);
+    }
+    ASSERT_EQ(chain[chain_length - 1]->fused_next(), nullptr);
+    GraphVertex* expr_vertex = g.get_data("FUSION_FLAG")->get_down_streams()[0]->get_attached_vertex();
+    ASSERT_EQ(expr_vertex->get_emits()[0]->get_down_streams()[0]->get_attached_vertex(), guarded);
+    ASSERT_EQ(expr_vertex->fused_next(), nullptr);
+    ASSERT_EQ(chain[1]->fused_prev(), chain[0]);
+    ASSERT_EQ(chain[0]->fused_prev(), nullptr);
+
+    g.set_executor(&executor);
+    for (int round = 0; round < 3; ++round) {
+        executor.execute_num = 0;
+        g.get_data("FUSION_0")->emit_value(std::vector<std::thread::id>());
+        auto* closure_context = g.run(g.get_data("FUSION_" + std::to_string(chain_length)));
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        // 没有开启inline continuation，融合的链也在同一个线程上执行，整条链只调度一次
+        auto& thread_ids = g.get_data("FUSION_" + std::to_string(chain_length))->raw<std::vector<std::thread::id>>();
+        ASSERT_EQ(thread_ids.size(), chain_length);
+        ASSERT_EQ(std::set<std::thread::id>(thread_ids.begin(), thread_ids.end()).size(), 1);
+        ASSERT_EQ(executor.execute_num.load(), 1);
+        g.reset();
+    }
+
+    // 设置了on_done时，整条链结束后回调
+    for (int round = 0; round < 3; ++round) {
+        std::promise<int32_t> done;
+        g.get_data("FUSION_0")->emit_value(std::vector<std::thread::id>());
+        g.run(g.get_data("FUSION_" + std::to_string(chain_length)), [&done](int32_t error_code) {
+            done.set_value(error_code);
+        });
+        ASSERT_EQ(done.get_future().get(), 0);
+        ASSERT_EQ(g.get_data("FUSION_" + std::to_string(chain_length))->raw<std::vector<std::thread::id>>().size(),
+                  chain_length);
+        g.reset();
+    }
+
+    // 有并发组的下游照常调度
+    chain[3]->set_concurrency_group("fusion_test_group");
+    executor.execute_num = 0;
+    g.get_data("FUSION_0")->emit_value(std::vector<std::thread::id>());
+    auto* closure_context = g.run(g.get_data("FUSION_" + std::to_string(chain_length)));
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(g.get_data("FUSION_" + std::to_string(chain_length))->raw<std::vector<std::thread::id>>().size(),
+              chain_length);
+    ASSERT_EQ(executor.execute_num.load(), 2);
+    g.reset();
+
+    // 默认不融合
+    Graph unfused;
+    GraphVertex* v = unfused.add_vertex("FusionChainProcessor");
+    v->depend_and_bind("FUSION_0", "input");
+    v->emit_and_bind("FUSION_1", "output");
+    GraphVertex* next = unfused.add_vertex("FusionChainProcessor");
+    next->depend_and_bind("FUSION_1", "input");
+    next->emit_and_bind("FUSION_2", "output");
+    unfused.build();
+    ASSERT_EQ(v->fused_next(), nullptr);
+}
+
+std::atomic<int> g_flaky_fail_num{0};
+
+class FlakyRecallProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        if (g_flaky_fail_num.fetch_sub(1) > 0) {
+            return 5;
+        }
+        *output = "primary:" + std::to_string(*input);
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(std::string, output)
+    );
+};
+REGISTER_PROCESSOR(FlakyRecallProcessor);
+
+class StaticRecallProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *output = "fallback:" + std::to_string(*input);
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(std::string, output)
+    );
+};
+REGISTER_PROCESSOR(StaticRecallProcessor);
+
+TEST_F(GraphTest, test_error_policy) {
+    auto run = [](ErrorPolicy policy, int fail_num, int32_t* error_code) {
+        auto g = std::make_unique<Graph>();
+        GraphVertex* v = g->add_vertex("FlakyRecallProcessor");
+        v->depend_and_bind("RECALL_IN", "input");
+        v->emit_and_bind("RECALL_OUT", "output");
+        v->set_error_policy(policy);
+        g->build();
+        g_flaky_fail_num = fail_num;
+        g->get_data("RECALL_IN")->emit_value<int32_t>(7);
+        auto* closure_context = g->run(g->get_data("RECALL_OUT"));
+        *error_code = closure_context->wait_finish();
+        delete closure_context;
+        return g;
+    };
+    auto output = [](GraphVertex* v) {
+        return v->get_emits()[0]->pointer<std::string>();
+    };
+    int32_t error_code = 0;
+
+    // 没有策略时整个图出错
+    auto g = run(ErrorPolicy(), 1, &error_code);
+    ASSERT_EQ(error_code, 5);
+    GraphVertex* v = nullptr;
+
+    // 重试成功
+    ErrorPolicy retry_policy;
+    retry_policy.max_retry_num = 3;
+    retry_policy.retry_backoff_ms = 5;
+    auto begin = std::chrono::steady_clock::now();
+    g = run(retry_policy, 2, &error_code);
+    v = g->get_data("RECALL_OUT")->get_producer();
+    ASSERT_EQ(error_code, 0);
+    ASSERT_EQ(v->retry_num(), 2);
+    ASSERT_FALSE(v->is_fallback());
+    ASSERT_EQ(*output(v), "primary:7");
+    // 退避5ms + 10ms
+    ASSERT_GE(std::chrono::steady_clock::now() - begin, std::chrono::milliseconds(15));
+
+    // 重试次数用完后降级
+    ErrorPolicy fallback_policy;
+    fallback_policy.max_retry_num = 2;
+    fallback_policy.fallback_processor = "StaticRecallProcessor";
+    g = run(fallback_policy, 10, &error_code);
+    v = g->get_data("RECALL_OUT")->get_producer();
+    ASSERT_EQ(error_code, 0);
+    ASSERT_EQ(v->retry_num(), 2);
+    ASSERT_TRUE(v->is_fallback());
+    ASSERT_EQ(*output(v), "fallback:7");
+
+    // 可选的vertex发布空值，图正常结束
+    ErrorPolicy optional_policy;
+    optional_policy.max_retry_num = 1;
+    optional_policy.is_optional = true;
+    g = run(optional_policy, 10, &error_code);
+    v = g->get_data("RECALL_OUT")->get_producer();
+    ASSERT_EQ(error_code, 0);
+    ASSERT_TRUE(v->get_emits()[0]->is_released());
+    ASSERT_EQ(output(v), nullptr);
+}
+
+std::atomic<bool> g_hedge_slow_once{false};
+
+class HedgeRecallProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        if (g_hedge_slow_once.exchange(false)) {
+            // 落后的执行在对冲胜出后提前退出
+            for (int i = 0; i < 1000 && !cancelled(); ++i) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            *output = "slow:" + std::to_string(*input);
+            return 0;
+        }
+        *output = "fast:" + std::to_string(*input);
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(std::string, output)
+    );
+};
+REGISTER_PROCESSOR(HedgeRecallProcessor);
+
+TEST_F(GraphTest, test_hedge) {
+    Graph g;
+    GraphVertex* v = g.add_vertex("HedgeRecallProcessor");
+    v->depend_and_bind("HEDGE_IN", "input");
+    v->emit_and_bind("HEDGE_OUT", "output");
+    HedgeOption option;
+    option.min_sample_num = 8;
+    option.min_delay_us = 5000;
+    v->hedge(option);
+    g.build();
+    auto run = [&g](int32_t input) {
+        g.get_data("HEDGE_IN")->emit_value<int32_t>(std::move(input));
+        auto* closure_context = g.run(g.get_data("HEDGE_OUT"));
+        EXPECT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        EXPECT_EQ(g.get_data("HEDGE_OUT")->raw<std::string>(), "fast:" + std::to_string(input));
+        g.reset();
+    };
+    // 样本不够时不对冲
+    for (int32_t i = 0; i < 8; ++i) {
+        run(i);
+    }
+    ASSERT_EQ(v->get_hedge_policy()->stats().hedge_num, 0);
+
+    // 第一次执行很慢，超过等待时间后发起对冲，对冲的执行先发布
+    g_hedge_slow_once = true;
+    run(100);
+    auto stats = v->get_hedge_policy()->stats();
+    ASSERT_EQ(stats.hedge_num, 1);
+    ASSERT_EQ(stats.hedge_win_num, 1);
+
+    // 没有变慢时不会发起对冲
+    for (int32_t i = 0; i < 5; ++i) {
+        run(i);
+    }
+    ASSERT_EQ(v->get_hedge_policy()->stats().hedge_num, 1);
+}
+
+std::atomic<int> g_bulkhead_running{0};
+std::atomic<int> g_bulkhead_max_running{0};
+std::atomic<size_t> g_bulkhead_max_queue{0};
+std::atomic<size_t> g_bulkhead_max_group_running{0};
+
+class BulkheadProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        int running = ++g_bulkhead_running;
+        int max_running = g_bulkhead_max_running.load();
+        while (running > max_running && !g_bulkhead_max_running.compare_exchange_weak(max_running, running)) {}
+        size_t queue_size = vertex().get_concurrency_group()->queue_size();
+        size_t max_queue = g_bulkhead_max_queue.load();
+        while (queue_size > max_queue && !g_bulkhead_max_queue.compare_exchange_weak(max_queue, queue_size)) {}
+        size_t group_running = vertex().get_concurrency_group()->running_num();
+        size_t max_group_running = g_bulkhead_max_group_running.load();
+        while (group_running > max_group_running
+                && !g_bulkhead_max_group_running.compare_exchange_weak(max_group_running, group_running)) {}
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        *output = *input + 1;
+        --g_bulkhead_running;
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR_WITH_GROUP(BulkheadProcessor, "TEST_BULKHEAD");
+
+TEST_F(GraphTest, test_concurrency_group) {
+    gflow::ConcurrencyGroupRegistry::instance().set_max_concurrency("TEST_BULKHEAD", 2);
+    auto group = gflow::ConcurrencyGroupRegistry::instance().get("TEST_BULKHEAD");
+    ASSERT_NE(group, nullptr);
+
+    constexpr int graph_num = 6;
+    std::vector<std::unique_ptr<Graph>> graphs;
+    std::vector<ClosureContext*> closure_contexts;
+    for (int i = 0; i < graph_num; ++i) {
+        auto g = std::make_unique<Graph>();
+        GraphVertex* v = g->add_vertex("BulkheadProcessor");
+        v->depend_and_bind("BULKHEAD_IN", "input");
+        v->emit_and_bind("BULKHEAD_OUT", "output");
+        ASSERT_EQ(v->get_concurrency_group(), group);
+        g->build();
+        g->get_data("BULKHEAD_IN")->emit_value<int32_t>(int32_t(i));
+        graphs.emplace_back(std::move(g));
+    }
+    for (auto& g : graphs) {
+        closure_contexts.emplace_back(g->run(g->get_data("BULKHEAD_OUT")));
+    }
+
+    // 并发组排满时，其他processor的图不受影响
+    Graph other;
+    GraphVertex* v = other.add_vertex("FusionChainProcessor");
+    v->depend_and_bind("OTHER_IN", "input");
+    v->emit_and_bind("OTHER_OUT", "output");
+    other.build();
+    ASSERT_EQ(v->get_concurrency_group(), nullptr);
+    other.get_data("OTHER_IN")->emit_value(std::vector<std::thread::id>());
+    auto* other_context = other.run(other.get_data("OTHER_OUT"));
+    ASSERT_EQ(other_context->wait_finish(), 0);
+    delete other_context;
+
+    for (int i = 0; i < graph_num; ++i) {
+        ASSERT_EQ(closure_contexts[i]->wait_finish(), 0);
+        delete closure_contexts[i];
+        ASSERT_EQ(graphs[i]->get_data("BULKHEAD_OUT")->raw<int32_t>(), i + 1);
+    }
+    // 同时执行的processor和组内同时占用的名额都不超过上限
+    ASSERT_LE(g_bulkhead_max_running.load(), 2);
+    ASSERT_GT(g_bulkhead_max_group_running.load(), 0);
+    ASSERT_LE(g_bulkhead_max_group_running.load(), 2);
+    ASSERT_GT(g_bulkhead_max_queue.load(), 0);
+    ASSERT_EQ(group->running_num(), 0);
+    ASSERT_EQ(group->queue_size(), 0);
+}
+
+TEST_F(GraphTest, test_topology) {
+    Graph g;
+    GraphVertex* a = g.add_vertex("DummyProcessor");
+    a->emit("TOPO_A");
+    GraphVertex* b = g.add_vertex("DummyProcessor");
+    b->depend("TOPO_A");
+    b->emit("TOPO_B");
+    GraphVertex* c = g.add_vertex("DummyProcessor");
+    c->depend("TOPO_A");
+    c->depend("TOPO_B")->when("TOPO_FLAG");
+    c->emit("TOPO_C");
+    g.build();
+
+    const GraphTopology& topology = g.get_topology();
+    // 3个vertex加上条件表达式的vertex
+    ASSERT_EQ(topology.vertex_size(), 4);
+    // TOPO_A/B/C，TOPO_FLAG和条件表达式的结果
+    ASSERT_EQ(topology.data_size(), 5);
+    for (uint32_t i = 0; i < topology.vertex_size(); ++i) {
+        ASSERT_EQ(topology.vertex(i)->idx(), i);
+    }
+    GraphData* data_a = g.get_data("TOPO_A");
+    ASSERT_EQ(topology.data(data_a->idx()), data_a);
+    // data的下游和建图时的一致，按vertex的顺序存放
+    auto consumers = topology.consumers(data_a->idx());
+    ASSERT_EQ(consumers.size(), 2);
+    ASSERT_EQ(consumers[0]->get_attached_vertex(), b);
+    ASSERT_EQ(consumers[1]->get_attached_vertex(), c);
+    ASSERT_EQ(topology.emits(a->idx()).size(), 1);
+    ASSERT_EQ(topology.emits(a->idx())[0], data_a->idx());
+    // 下游vertex去重
+    auto downstreams = topology.downstreams(a->idx());
+    ASSERT_EQ(downstreams.size(), 2);
+    ASSERT_EQ(downstreams[0], b->idx());
+    ASSERT_EQ(downstreams[1], c->idx());
+    ASSERT_EQ(topology.downstreams(b->idx()).size(), 1);
+    ASSERT_TRUE(topology.downstreams(c->idx()).empty());
+    // 条件表达式的vertex是c的上游
+    GraphVertex* expr_vertex = g.get_data("TOPO_FLAG")->get_down_streams()[0]->get_attached_vertex();
+    ASSERT_EQ(topology.downstreams(expr_vertex->idx())[0], c->idx());
+    // 关键路径上的vertex优先级更高
+    ASSERT_GT(a->priority(), b->priority());
+    ASSERT_GT(b->priority(), c->priority());
+}
+
+class LoaderScaleProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        auto& option = vertex().get_option<GraphLoader::VertexOption>();
+        *output = *input * std::stoi(option.at("scale"));
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR(LoaderScaleProcessor);
+
+class LoaderSumProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *sum = *left + *right;
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, left)
+        DEPEND_VAR(int32_t, right)
+        EMIT_VAR(int32_t, sum)
+    );
+};
+REGISTER_PROCESSOR(LoaderSumProcessor);
+
+TEST_F(GraphTest, test_graph_loader) {
+    const std::string config = R"({
+        "inputs" = {
+            "LOADER_IN" = "input"
+            "LOADER_FLAG" = "flag"
+        }
+        "options" = {
+            "inline_continuation" = "true"
+            "data_recycle" = "true"
+        }
+        "vertexes" = {
+            "double" = {
+                "processor" = "LoaderScaleProcessor"
+                "depends" = { "input" = "LOADER_IN" }
+                "emits" = { "output" = "LOADER_DOUBLE" }
+                "option" = { "scale" = "2" }
+            }
+            "triple" = {
+                "processor" = "LoaderScaleProcessor"
+                "depends" = {
+                    "input" = {
+                        "data" = "LOADER_IN"
+                        "when" = "LOADER_FLAG"
+                    }
+                }
+                "emits" = { "output" = "LOADER_TRIPLE" }
+                "option" = { "scale" = "3" }
+            }
+            "sum" = {
+                "processor" = "LoaderSumProcessor"
+                "depends" = {
+                    "left" = "LOADER_DOUBLE"
+                    "right" = "LOADER_TRIPLE"
+                }
+                "emits" = { "sum" = "LOADER_SUM" }
+            }
+        }
+    })";
+    auto& loader = GraphLoader::instance();
+    loader.clear();
+    auto tpl = loader.load(config);
+    ASSERT_NE(tpl, nullptr);
+    ASSERT_EQ(tpl->vertex_size(), 4);
+    // 同一份配置只编译一次
+    ASSERT_EQ(loader.load(config), tpl);
+    ASSERT_EQ(loader.cache_size(), 1);
+
+    for (int32_t input = 1; input <= 3; ++input) {
+        std::unique_ptr<GraphInstance> instance(tpl->create_instance());
+        ASSERT_TRUE(instance->is_data_recycle());
+        instance->get_data("LOADER_IN")->emit_value<int32_t>(std::move(input));
+        instance->get_data("LOADER_FLAG")->emit_value<int32_t>(1);
+        auto* closure_context = instance->run(instance->get_data("LOADER_SUM"));
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(instance->get_data("LOADER_SUM")->raw<int32_t>(), input * 5);
+    }
+
+    // 校验失败返回nullptr，也不缓存
+    const std::vector<std::string> invalid_configs = {
+        // 语法错误
+        R"({ "vertexes" = { "a" = { "processor" = "LoaderSumProcessor" } })",
+        // 未知的字段
+        R"({ "vertexes" = { "a" = { "processor" = "LoaderScaleProcessor" "unknown" = "1" } } })",
+        // 未注册的processor
+        R"({ "vertexes" = { "a" = { "processor" = "LoaderNotExistProcessor" } } })",
+        // 依赖的data既不是输入也没有生产者
+        R"({ "vertexes" = { "a" = { "processor" = "LoaderScaleProcessor"
+            "depends" = { "input" = "LOADER_MISSING" } "emits" = { "output" = "LOADER_A" } } } })",
+        // data有两个生产者
+        R"({ "inputs" = { "LOADER_IN" = "" } "vertexes" = {
+            "a" = { "processor" = "LoaderScaleProcessor"
+                "depends" = { "input" = "LOADER_IN" } "emits" = { "output" = "LOADER_A" } }
+            "b" = { "processor" = "LoaderScaleProcessor"
+                "depends" = { "input" = "LOADER_IN" } "emits" = { "output" = "LOADER_A" } } } })",
+        // 环
+        R"({ "vertexes" = {
+            "a" = { "processor" = "LoaderScaleProcessor"
+                "depends" = { "input" = "LOADER_B" } "emits" = { "output" = "LOADER_A" } }
+            "b" = { "processor" = "LoaderScaleProcessor"
+                "depends" = { "input" = "LOADER_A" } "emits" = { "output" = "LOADER_B" } } } })",
+        // 条件表达式错误
+        R"({ "inputs" = { "LOADER_IN" = "" } "vertexes" = { "a" = { "processor" = "LoaderScaleProcessor"
+            "depends" = { "input" = { "data" = "LOADER_IN" "when" = "LOADER_IN &&" } }
+            "emits" = { "output" = "LOADER_A" } } } })",
+        // timeout_ms只能用于optional依赖
+        R"({ "inputs" = { "LOADER_IN" = "" } "vertexes" = { "a" = { "processor" = "LoaderScaleProcessor"
+            "depends" = { "input" = { "data" = "LOADER_IN" "timeout_ms" = "10" } }
+            "emits" = { "output" = "LOADER_A" } } } })",
+        // 变量名和processor声明的不一致
+        R"({ "inputs" = { "LOADER_IN" = "" } "vertexes" = { "a" = { "processor" = "LoaderScaleProcessor"
+            "depends" = { "inputs" = "LOADER_IN" } "emits" = { "output" = "LOADER_A" } } } })",
+    };
+    for (const std::string& invalid_config : invalid_configs) {
+        ASSERT_EQ(loader.load(invalid_config), nullptr) << invalid_config;
+    }
+    ASSERT_EQ(loader.cache_size(), 1);
+
+    // optional依赖也绑定变量
+    auto optional_tpl = loader.load(R"({ "inputs" = { "LOADER_IN" = "" } "vertexes" = {
+        "a" = { "processor" = "LoaderScaleProcessor"
+            "depends" = { "input" = { "data" = "LOADER_IN" "optional" = "true" } }
+            "emits" = { "output" = "LOADER_A" } "option" = { "scale" = "4" } } } })");
+    ASSERT_NE(optional_tpl, nullptr);
+    std::unique_ptr<GraphInstance> instance(optional_tpl->create_instance());
+    instance->get_data("LOADER_IN")->emit_value<int32_t>(3);
+    auto* closure_context = instance->run(instance->get_data("LOADER_A"));
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(instance->get_data("LOADER_A")->raw<int32_t>(), 12);
+    ASSERT_EQ(loader.cache_size(), 2);
+
+    // 缓存不持有模板，没有人使用之后不再占用内存
+    instance.reset();
+    optional_tpl.reset();
+    ASSERT_EQ(loader.cache_size(), 1);
+    tpl.reset();
+    ASSERT_EQ(loader.cache_size(), 0);
+}
+
+std::atomic<int> g_multi_target_process_num{0};
+
+class MultiTargetProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        g_multi_target_process_num++;
+        *output = *input + 1;
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR(MultiTargetProcessor);
+
+TEST_F(GraphTest, test_multi_target_run) {
+    Graph g;
+    auto add_vertex = [&g](const std::string& input, const std::string& output) {
+        GraphVertex* v = g.add_vertex("MultiTargetProcessor");
+        v->depend_and_bind(input, "input");
+        v->emit_and_bind(output, "output");
+    };
+    add_vertex("MT_IN", "MT_SHARED");
+    add_vertex("MT_SHARED", "MT_RESPONSE");
+    add_vertex("MT_SHARED", "MT_DEBUG");
+    add_vertex("MT_IN", "MT_OTHER");
+    g.build();
+    GraphData* response = g.get_data("MT_RESPONSE");
+    GraphData* debug = g.get_data("MT_DEBUG");
+
+    // 重复的目标只算一次，共享的上游只执行一次，不相关的vertex不执行
+    g_multi_target_process_num = 0;
+    g.get_data("MT_IN")->emit_value<int32_t>(1);
+    auto* closure_context = g.run({response, debug, response});
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(g_multi_target_process_num.load(), 3);
+    ASSERT_EQ(response->raw<int32_t>(), 3);
+    ASSERT_EQ(debug->raw<int32_t>(), 3);
+    ASSERT_FALSE(g.get_data("MT_OTHER")->is_released());
+    ASSERT_EQ(g.get_activation_plan({debug, response})->vertexes().size(), 3);
+    g.reset();
+
+    // 共享的中间结果已经发布时回退到递归激活
+    g_multi_target_process_num = 0;
+    g.get_data("MT_SHARED")->emit_value<int32_t>(10);
+    closure_context = g.run({response, debug});
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(g_multi_target_process_num.load(), 2);
+    ASSERT_EQ(response->raw<int32_t>(), 11);
+    ASSERT_EQ(debug->raw<int32_t>(), 11);
+    g.reset();
+
+    // 非阻塞执行，所有目标都发布之后回调
+    g_multi_target_process_num = 0;
+    g.get_data("MT_IN")->emit_value<int32_t>(5);
+    std::promise<int32_t> done;
+    g.run({response, debug, g.get_data("MT_OTHER")}, [&done](int32_t error_code) {
+        done.set_value(error_code);
+    });
+    ASSERT_EQ(done.get_future().get(), 0);
+    ASSERT_EQ(g_multi_target_process_num.load(), 4);
+    ASSERT_EQ(response->raw<int32_t>(), 7);
+    ASSERT_EQ(debug->raw<int32_t>(), 7);
+    ASSERT_EQ(g.get_data("MT_OTHER")->raw<int32_t>(), 6);
+    g.reset();
+
+    // 没有目标时直接以-1结束
+    ASSERT_EQ(g.get_activation_plan(std::vector<GraphData*>()), nullptr);
+    closure_context = g.run(std::vector<GraphData*>());
+    ASSERT_EQ(closure_context->wait_finish(), -1);
+    delete closure_context;
+    std::promise<int32_t> empty_done;
+    g.run(std::vector<GraphData*>(), [&empty_done](int32_t error_code) {
+        empty_done.set_value(error_code);
+    });
+    ASSERT_EQ(empty_done.get_future().get(), -1);
+}
+
+TEST_F(GraphTest, test_reset_incremental) {
+    Graph g;
+    auto add_vertex = [&g](const std::string& input, const std::string& output) {
+        GraphVertex* v = g.add_vertex("MultiTargetProcessor");
+        GraphDependency* dependency = v->depend_and_bind(input, "input");
+        v->emit_and_bind(output, "output");
+        return dependency;
+    };
+    add_vertex("INC_A", "INC_X");
+    add_vertex("INC_B", "INC_Y");
+    GraphVertex* sum = g.add_vertex("LoaderSumProcessor");
+    sum->depend_and_bind("INC_X", "left");
+    sum->depend_and_bind("INC_Y", "right");
+    sum->emit_and_bind("INC_SUM", "sum");
+    add_vertex("INC_SUM", "INC_OUT");
+    add_vertex("INC_Y", "INC_GUARDED")->when("INC_FLAG");
+    g.build();
+
+    auto run = [&g](int expect_process_num) {
+        g_multi_target_process_num = 0;
+        auto* closure_context = g.run({g.get_data("INC_OUT"), g.get_data("INC_GUARDED")});
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(g_multi_target_process_num.load(), expect_process_num);
+    };
+    g.get_data("INC_A")->emit_value<int32_t>(1);
+    g.get_data("INC_B")->emit_value<int32_t>(10);
+    g.get_data("INC_FLAG")->emit_value<int>(1);
+    run(4);
+    ASSERT_EQ(g.get_data("INC_OUT")->raw<int32_t>(), 14);
+    ASSERT_EQ(g.get_data("INC_GUARDED")->raw<int32_t>(), 12);
+
+    // 只有INC_A的下游重新执行，INC_Y保留上一轮的值
+    g.reset_incremental({g.get_data("INC_A")});
+    ASSERT_TRUE(g.get_data("INC_Y")->is_released());
+    ASSERT_FALSE(g.get_data("INC_X")->is_released());
+    g.get_data("INC_A")->emit_value<int32_t>(5);
+    run(2);
+    ASSERT_EQ(g.get_data("INC_OUT")->raw<int32_t>(), 18);
+
+    // 没有变化时什么都不执行
+    g.reset_incremental({});
+    run(0);
+    ASSERT_EQ(g.get_data("INC_OUT")->raw<int32_t>(), 18);
+
+    g.reset_incremental({g.get_data("INC_B")});
+    g.get_data("INC_B")->emit_value<int32_t>(20);
+    run(3);
+    ASSERT_EQ(g.get_data("INC_OUT")->raw<int32_t>(), 28);
+    ASSERT_EQ(g.get_data("INC_GUARDED")->raw<int32_t>(), 22);
+
+    // 条件变化时重新求值，条件依赖的数据保留
+    g.reset_incremental({g.get_data("INC_FLAG")});
+    g.get_data("INC_FLAG")->emit_value<int>(1);
+    run(1);
+    ASSERT_EQ(g.get_data("INC_GUARDED")->raw<int32_t>(), 22);
+
+    // 完整reset之后全部重新执行
+    g.reset();
+    g.get_data("INC_A")->emit_value<int32_t>(1);
+    g.get_data("INC_B")->emit_value<int32_t>(10);
+    g.get_data("INC_FLAG")->emit_value<int>(1);
+    run(4);
+    ASSERT_EQ(g.get_data("INC_OUT")->raw<int32_t>(), 14);
+}
+
+std::atomic<int> g_lazy_process_num{0};
+
+class LazyExpensiveProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        g_lazy_process_num++;
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        *output = *input * 100;
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR(LazyExpensiveProcessor);
+
+class LazyConsumerProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        // 只有flag为真时才读取惰性数据
+        *output = *flag ? *lazy_input : -1;
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, flag)
+        LAZY_DEPEND_VAR(int32_t, lazy_input)
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR(LazyConsumerProcessor);
+
+TEST_F(GraphTest, test_lazy_data) {
+    Graph g;
+    GraphVertex* expensive = g.add_vertex("LazyExpensiveProcessor");
+    expensive->depend_and_bind("LAZY_IN", "input");
+    expensive->emit_and_bind("LAZY_VALUE", "output");
+    expensive->set_lazy(true);
+    for (std::string output : {"LAZY_OUT_1", "LAZY_OUT_2"}) {
+        GraphVertex* consumer = g.add_vertex("LazyConsumerProcessor");
+        consumer->depend_and_bind("LAZY_FLAG", "flag");
+        consumer->depend_and_bind("LAZY_VALUE", "lazy_input");
+        consumer->emit_and_bind(output, "output");
+    }
+    g.build();
+    ASSERT_TRUE(expensive->is_lazy());
+
+    auto run = [&g](int32_t flag, std::vector<GraphData*> targets) {
+        g_lazy_process_num = 0;
+        g.get_data("LAZY_IN")->emit_value<int32_t>(3);
+        g.get_data("LAZY_FLAG")->emit_value<int32_t>(std::move(flag));
+        auto* closure_context = g.run(targets);
+        EXPECT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+    };
+    std::vector<GraphData*> outputs = {g.get_data("LAZY_OUT_1"), g.get_data("LAZY_OUT_2")};
+    // 没有人读取，生产者不执行
+    run(0, outputs);
+    ASSERT_EQ(g_lazy_process_num.load(), 0);
+    ASSERT_EQ(g.get_data("LAZY_OUT_1")->raw<int32_t>(), -1);
+    ASSERT_FALSE(g.get_data("LAZY_VALUE")->is_released());
+    g.reset();
+
+    // 两个下游并发读取，生产者只执行一次
+    for (int round = 0; round < 10; ++round) {
+        run(1, outputs);
+        ASSERT_EQ(g_lazy_process_num.load(), 1);
+        ASSERT_EQ(g.get_data("LAZY_OUT_1")->raw<int32_t>(), 300);
+        ASSERT_EQ(g.get_data("LAZY_OUT_2")->raw<int32_t>(), 300);
+        g.reset();
+    }
+
+    // 惰性数据是run的目标时照常执行
+    run(0, {g.get_data("LAZY_VALUE")});
+    ASSERT_EQ(g_lazy_process_num.load(), 1);
+    ASSERT_EQ(g.get_data("LAZY_VALUE")->raw<int32_t>(), 300);
+
+    g.reset();
+
+    // 有直接读取数据(DEPEND_VAR)的下游时照常执行
+    Graph shared_graph;
+    GraphVertex* shared = shared_graph.add_vertex("LazyExpensiveProcessor");
+    shared->depend_and_bind("LAZY_IN", "input");
+    shared->emit_and_bind("LAZY_VALUE", "output");
+    shared->set_lazy(true);
+    GraphVertex* lazy_consumer = shared_graph.add_vertex("LazyConsumerProcessor");
+    lazy_consumer->depend_and_bind("LAZY_FLAG", "flag");
+    lazy_consumer->depend_and_bind("LAZY_VALUE", "lazy_input");
+    lazy_consumer->emit_and_bind("LAZY_OUT", "output");
+    GraphVertex* plain_consumer = shared_graph.add_vertex("LazyExpensiveProcessor");
+    plain_consumer->depend_and_bind("LAZY_VALUE", "input");
+    plain_consumer->emit_and_bind("PLAIN_OUT", "output");
+    shared_graph.build();
+    g_lazy_process_num = 0;
+    shared_graph.get_data("LAZY_IN")->emit_value<int32_t>(3);
+    shared_graph.get_data("LAZY_FLAG")->emit_value<int32_t>(0);
+    auto* closure_context = shared_graph.run(
+            {shared_graph.get_data("LAZY_OUT"), shared_graph.get_data("PLAIN_OUT")});
+    ASSERT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    ASSERT_EQ(g_lazy_process_num.load(), 2);
+    ASSERT_EQ(shared_graph.get_data("PLAIN_OUT")->raw<int32_t>(), 30000);
+
+    // 缓存结果的下游不能把没有读取的惰性数据当作缺失的依赖
+    Graph memo_graph;
+    GraphVertex* memo_lazy = memo_graph.add_vertex("LazyExpensiveProcessor");
+    memo_lazy->depend_and_bind("LAZY_IN", "input");
+    memo_lazy->emit_and_bind("LAZY_VALUE", "output");
+    memo_lazy->set_lazy(true);
+    GraphVertex* memo_consumer = memo_graph.add_vertex("LazyConsumerProcessor");
+    memo_consumer->depend_and_bind("LAZY_FLAG", "flag");
+    memo_consumer->depend_and_bind("LAZY_VALUE", "lazy_input");
+    memo_consumer->emit_and_bind("LAZY_OUT", "output");
+    memo_consumer->cacheable();
+    memo_graph.build();
+    for (int32_t input : {3, 3, 4}) {
+        g_lazy_process_num = 0;
+        memo_graph.get_data("LAZY_IN")->emit_value<int32_t>(int32_t(input));
+        memo_graph.get_data("LAZY_FLAG")->emit_value<int32_t>(1);
+        closure_context = memo_graph.run(memo_graph.get_data("LAZY_OUT"));
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(g_lazy_process_num.load(), 1);
+        ASSERT_EQ(memo_graph.get_data("LAZY_OUT")->raw<int32_t>(), input * 100);
+        memo_graph.reset();
+    }
+}
+
+std::atomic<int> g_recycle_process_num{0};
+
+class RecycleVectorProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        g_recycle_process_num++;
+        // 复用的对象保留之前的内容，需要覆盖
+        output->clear();
+        for (int32_t value : *input) {
+            output->emplace_back(value + 1);
+        }
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(std::vector<int32_t>, input)
+        EMIT_VAR(std::vector<int32_t>, output)
+    );
+};
+REGISTER_PROCESSOR(RecycleVectorProcessor);
+
+TEST_F(GraphTest, test_data_recycle) {
+    Graph g;
+    g.set_data_recycle(true);
+    auto add_vertex = [&g](const std::string& input, const std::string& output) {
+        GraphVertex* v = g.add_vertex("RecycleVectorProcessor");
+        v->depend_and_bind(input, "input");
+        v->emit_and_bind(output, "output");
+    };
+    add_vertex("RC_IN", "RC_X");
+    add_vertex("RC_X", "RC_Y");
+    add_vertex("RC_Y", "RC_Z");
+    g.build();
+    GraphData* x = g.get_data("RC_X");
+    GraphData* y = g.get_data("RC_Y");
+    GraphData* z = g.get_data("RC_Z");
+    auto run = [&g, z](int expect_process_num) {
+        g_recycle_process_num = 0;
+        auto* closure_context = g.run(z);
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(g_recycle_process_num.load(), expect_process_num);
+        ASSERT_EQ(z->raw<std::vector<int32_t>>(), std::vector<int32_t>({4, 5, 6}));
+    };
+
+    g.get_data("RC_IN")->emit_value(std::vector<int32_t>{1, 2, 3});
+    run(3);
+    // 中间数据在最后一个下游执行完时回收，RC_Z产出时RC_X已经回收的话会复用它的对象
+    ASSERT_TRUE(x->is_recycled());
+    ASSERT_TRUE(y->is_recycled());
+    ASSERT_FALSE(x->any_data());
+    ASSERT_FALSE(z->is_recycled());
+    ASSERT_FALSE(g.get_data("RC_IN")->is_recycled());
+    ASSERT_GE(g.get_data_recycler()->size(), 1);
+    ASSERT_LE(g.get_data_recycler()->size(), 2);
+
+    // 被回收的中间数据在增量执行时和生产者一起重新计算
+    g.reset_incremental({});
+    run(3);
+
+    // retain的中间数据保留到reset
+    g.reset();
+    g.get_data("RC_IN")->emit_value(std::vector<int32_t>{1, 2, 3});
+    y->retain();
+    run(3);
+    ASSERT_TRUE(x->is_recycled());
+    ASSERT_FALSE(y->is_recycled());
+    ASSERT_EQ(y->raw<std::vector<int32_t>>(), std::vector<int32_t>({3, 4, 5}));
+    ASSERT_LE(g.get_data_recycler()->size(), 4);
+
+    // 缓存结果的生产者写完缓存之后才回收
+    Graph memo_graph;
+    memo_graph.set_data_recycle(true);
+    GraphVertex* memo_x = memo_graph.add_vertex("RecycleVectorProcessor");
+    memo_x->depend_and_bind("RC_IN", "input");
+    memo_x->emit_and_bind("RC_X", "output");
+    memo_x->cacheable();
+    GraphVertex* memo_y = memo_graph.add_vertex("RecycleVectorProcessor");
+    memo_y->depend_and_bind("RC_X", "input");
+    memo_y->emit_and_bind("RC_Y", "output");
+    memo_graph.build();
+    for (int round = 0; round < 20; ++round) {
+        g_recycle_process_num = 0;
+        memo_graph.get_data("RC_IN")->emit_value(std::vector<int32_t>{1, 2, 3});
+        auto* closure_context = memo_graph.run(memo_graph.get_data("RC_Y"));
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(g_recycle_process_num.load(), round == 0 ? 2 : 1);
+        ASSERT_TRUE(memo_graph.get_data("RC_X")->is_recycled());
+        ASSERT_EQ(memo_graph.get_data("RC_Y")->raw<std::vector<int32_t>>(), std::vector<int32_t>({3, 4, 5}));
+        memo_graph.reset();
+    }
+
+    // 关闭时不回收
+    g.set_data_recycle(false);
+    g.build();
+    g.reset();
+    g.get_data("RC_IN")->emit_value(std::vector<int32_t>{1, 2, 3});
+    run(3);
+    ASSERT_FALSE(x->is_recycled());
+    ASSERT_EQ(x->raw<std::vector<int32_t>>(), std::vector<int32_t>({2, 3, 4}));
+    ASSERT_EQ(g.get_data_recycler(), nullptr);
+}
@@ -0,0 +1,135 @@
+#include <gtest/gtest.h>
+#include "gflags/gflags.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <set>
+#include <any>
+
+#define DCHECK_IS_ON 1
+
+#include "data.h"
+#include "vertex.h"
+#include "graph.h"
+#include "graph_template.h"
+#include "graph_pool.h"
+
+namespace graph_pool {
+
+using namespace gflow;
+
+class GraphPoolTest : public ::testing::Test {
+   private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+
+   protected:
+};
+
+class DoubleProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *output = *input * 2;
+        return 0;
+    }
+    GRAPH_DECLARE(
+        DEPEND(int32_t, INPUT, input)
+        EMIT(int32_t, OUTPUT, output)
+    );
+};
+REGISTER_PROCESSOR(DoubleProcessor);
+
+std::shared_ptr<GraphTemplate> create_template() {
+    Graph prototype;
+    GraphVertex* v = prototype.add_vertex("DoubleProcessor");
+    v->depend("INPUT");
+    v->emit("OUTPUT");
+    prototype.build();
+    return GraphTemplate::compile(prototype);
+}
+
+TEST_F(GraphPoolTest, test_acquire_release) {
+    GraphPool pool(create_template(), 4);
+    ASSERT_EQ(pool.stats().size, 4);
+
+    std::set<GraphInstance*> graphs;
+    for (int i = 0; i < 6; ++i) {
+        graphs.insert(pool.acquire());
+    }
+    // 预热了4个，突发多要了2个
+    ASSERT_EQ(graphs.size(), 6);
+    auto stats = pool.stats();
+    ASSERT_EQ(stats.size, 6);
+    ASSERT_EQ(stats.miss_num, 2);
+    ASSERT_EQ(stats.acquire_num, 6);
+
+    for (auto* g : graphs) {
+        pool.release(g);
+    }
+    // 归还之后再拿不会再创建新的实例，并且优先命中线程本地缓存
+    for (int i = 0; i < 6; ++i) {
+        ASSERT_EQ(graphs.count(pool.acquire()), 1);
+    }
+    stats = pool.stats();
+    ASSERT_EQ(stats.size, 6);
+    ASSERT_EQ(stats.miss_num, 2);
+    ASSERT_EQ(stats.thread_cache_hit_num, GraphPool::THREAD_CACHE_SIZE > 6 ? 6 : GraphPool::THREAD_CACHE_SIZE);
+    for (auto* g : graphs) {
+        pool.release(g);
+    }
+}
+
+TEST_F(GraphPoolTest, test_concurrent_run) {
+    GraphPool pool(create_template(), 2);
+    constexpr int concurrent = 8;
+    std::atomic<int> failed{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < concurrent; ++i) {
+        threads.emplace_back([&, i] {
+            for (int k = 0; k < 50; ++k) {
+                GraphInstance* g = pool.acquire();
+                int32_t input = i * 1000 + k;
+                g->create_data("INPUT")->emit_value<int32_t>(int32_t(input));
+                GraphData* output = g->get_data("OUTPUT");
+                auto* closure_context = g->run(output);
+                if (closure_context->wait_finish() != 0 || output->raw<int32_t>() != input * 2) {
+                    failed++;
+                }
+                delete closure_context;
+                pool.release(g);
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    ASSERT_EQ(failed.load(), 0);
+    auto stats = pool.stats();
+    ASSERT_EQ(stats.acquire_num, concurrent * 50);
+    ASSERT_LE(stats.size, concurrent + 2);
+}
+
+TEST_F(GraphPoolTest, test_thread_exit) {
+    GraphPool pool(create_template(), 1);
+    // 退出的线程把本地缓存的实例还给共享的栈，下标给之后的线程复用，
+    // 先后创建的线程数超过MAX_THREAD_CACHE_NUM也不会一直创建新实例
+    for (size_t i = 0; i < GraphPool::MAX_THREAD_CACHE_NUM * 2; ++i) {
+        std::thread([&pool] {
+            GraphInstance* g = pool.acquire();
+            pool.release(g);
+        }).join();
+    }
+    auto stats = pool.stats();
+    ASSERT_EQ(stats.size, 1);
+    ASSERT_EQ(stats.miss_num, 0);
+    ASSERT_EQ(stats.acquire_num, GraphPool::MAX_THREAD_CACHE_NUM * 2);
+}
+
+} // namespace
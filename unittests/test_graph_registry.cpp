@@ -0,0 +1,175 @@
+#include <gtest/gtest.h>
+#include "gflags/gflags.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <any>
+
+#include "data.h"
+#include "vertex.h"
+#include "graph.h"
+#include "graph_loader.h"
+#include "graph_registry.h"
+
+namespace graph_registry {
+
+using namespace gflow;
+
+class GraphRegistryTest : public ::testing::Test {
+   private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+
+   protected:
+};
+
+class RegistryScaleProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        auto& option = vertex().get_option<GraphLoader::VertexOption>();
+        *output = *input * std::stoi(option.at("scale"));
+        return 0;
+    }
+    VAR_DECLARE(
+        DEPEND_VAR(int32_t, input)
+        EMIT_VAR(int32_t, output)
+    );
+};
+REGISTER_PROCESSOR(RegistryScaleProcessor);
+
+std::string make_config(int32_t scale) {
+    return R"({
+        "inputs" = { "REGISTRY_IN" = "input" }
+        "vertexes" = {
+            "scale" = {
+                "processor" = "RegistryScaleProcessor"
+                "depends" = { "input" = "REGISTRY_IN" }
+                "emits" = { "output" = "REGISTRY_OUT" }
+                "option" = { "scale" = ")" + std::to_string(scale) + R"(" }
+            }
+        }
+    })";
+}
+
+int32_t run(const GraphHandle& g, int32_t input) {
+    g->get_data("REGISTRY_IN")->emit_value<int32_t>(std::move(input));
+    auto* closure_context = g->run(g->get_data("REGISTRY_OUT"));
+    EXPECT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    return g->get_data("REGISTRY_OUT")->raw<int32_t>();
+}
+
+TEST_F(GraphRegistryTest, test_reload) {
+    auto& registry = GraphRegistry::instance();
+    VersionedGraph* graph = registry.get_or_create("test_reload");
+    ASSERT_EQ(registry.get("test_reload"), graph);
+    ASSERT_EQ(registry.get("test_reload_not_exist"), nullptr);
+    // 多次运行时从已经发布的版本继续
+    uint64_t base = graph->version();
+    if (base == 0) {
+        // 还没有发布过
+        ASSERT_FALSE(graph->acquire());
+    }
+
+    ASSERT_EQ(registry.reload("test_reload", make_config(2), 2), base + 1);
+    // 配置没有变化不发布新版本
+    ASSERT_EQ(registry.reload("test_reload", make_config(2), 2), base + 1);
+    // 加载失败保留当前版本
+    ASSERT_EQ(registry.reload("test_reload", "{", 2), 0);
+    ASSERT_EQ(graph->version(), base + 1);
+
+    GraphHandle in_flight = graph->acquire();
+    ASSERT_EQ(in_flight.version(), base + 1);
+    ASSERT_EQ(registry.reload("test_reload", make_config(3), 2), base + 2);
+    // 还有请求在使用旧版本，不能回收
+    ASSERT_EQ(graph->retired_size(), 1);
+    ASSERT_EQ(graph->reclaim(), 0);
+
+    // 新请求拿到新版本，旧请求继续使用旧版本
+    GraphHandle g = graph->acquire();
+    ASSERT_EQ(g.version(), base + 2);
+    ASSERT_EQ(run(g, 5), 15);
+    ASSERT_EQ(run(in_flight, 5), 10);
+
+    // 最后一个使用旧版本的请求结束时回收
+    in_flight.reset();
+    ASSERT_FALSE(in_flight);
+    ASSERT_EQ(graph->retired_size(), 0);
+}
+
+TEST_F(GraphRegistryTest, test_reload_concurrently) {
+    // 不停发布新版本的同时并发执行请求，每个请求看到的都是完整的某个版本
+    VersionedGraph* graph = GraphRegistry::instance().get_or_create("test_reload_concurrently");
+    uint64_t base = graph->version();
+    ASSERT_EQ(graph->publish(GraphLoader::instance().load(make_config(1)), 4), base + 1);
+    std::atomic<bool> stop{false};
+    std::atomic<int> request_num{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 4; ++i) {
+        threads.emplace_back([&, i] {
+            int32_t input = i + 1;
+            while (!stop.load()) {
+                GraphHandle g = graph->acquire();
+                // 第n个版本的scale是n
+                ASSERT_EQ(run(g, input), input * static_cast<int32_t>(g.version() - base));
+                request_num++;
+            }
+        });
+    }
+    constexpr int version_num = 20;
+    for (int32_t scale = 2; scale <= version_num; ++scale) {
+        ASSERT_EQ(graph->publish(GraphLoader::instance().load(make_config(scale)), 4), base + scale);
+        std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    }
+    stop = true;
+    for (auto& th : threads) {
+        th.join();
+    }
+    ASSERT_GT(request_num.load(), 0);
+    graph->reclaim();
+    ASSERT_EQ(graph->retired_size(), 0);
+    ASSERT_EQ(graph->version(), base + version_num);
+}
+
+TEST_F(GraphRegistryTest, test_release_concurrently) {
+    // 请求归还实例和发布新版本并发，最后一个请求归还时版本可能马上被其他线程回收
+    VersionedGraph* graph = GraphRegistry::instance().get_or_create("test_release_concurrently");
+    ASSERT_GT(graph->publish(GraphLoader::instance().load(make_config(1)), 1), 0);
+    std::atomic<bool> stop{false};
+    std::atomic<int> acquire_num{0};
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&] {
+            while (!stop.load()) {
+                GraphHandle g = graph->acquire();
+                ASSERT_TRUE(g);
+                g.reset();
+                acquire_num++;
+            }
+        });
+    }
+    for (int32_t scale = 2; scale <= 200; ++scale) {
+        // 每次发布之间都有请求在归还
+        int begin_num = acquire_num.load();
+        while (acquire_num.load() < begin_num + 8) {
+            std::this_thread::yield();
+        }
+        ASSERT_GT(graph->publish(GraphLoader::instance().load(make_config(scale % 3 + 1)), 1), 0);
+    }
+    stop = true;
+    for (auto& th : threads) {
+        th.join();
+    }
+    graph->reclaim();
+    ASSERT_EQ(graph->retired_size(), 0);
+}
+
+}  // namespace graph_registry
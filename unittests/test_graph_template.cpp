@@ -0,0 +1,191 @@
+#include <gtest/gtest.h>
+#include "gflags/gflags.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <any>
+
+#define DCHECK_IS_ON 1
+
+#include "data.h"
+#include "dependency.h"
+#include "vertex.h"
+#include "graph.h"
+#include "graph_template.h"
+#include "expr_processor.h"
+
+namespace graph_template {
+
+using namespace gflow;
+
+class GraphTemplateTest : public ::testing::Test {
+   private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+
+   protected:
+};
+
+class SourceProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *value = vertex().get_option<int32_t>();
+        return 0;
+    }
+    GRAPH_DECLARE(
+        EMIT(int32_t, SOURCE, value)
+    );
+};
+REGISTER_PROCESSOR(SourceProcessor);
+
+class AddProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *sum = *source + *input;
+        for (GraphDependency *dep : vertex().get_optional_dependencys()) {
+            auto* extra = dep->value<int32_t>();
+            if (extra != nullptr) {
+                *sum += *extra;
+            }
+        }
+        return 0;
+    }
+    GRAPH_DECLARE(
+        DEPEND(int32_t, SOURCE, source)
+        DEPEND(int32_t, INPUT, input)
+        EMIT(int32_t, SUM, sum)
+    );
+};
+REGISTER_PROCESSOR(AddProcessor);
+
+class ExtraProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *extra = 1000;
+        return 0;
+    }
+    GRAPH_DECLARE(
+        EMIT(int32_t, EXTRA, extra)
+    );
+};
+REGISTER_PROCESSOR(ExtraProcessor);
+
+int32_t run_sum(Graph* g, int32_t input, bool a) {
+    g->create_data("INPUT")->emit_value<int32_t>(int32_t(input));
+    g->create_data("A")->emit_value<int>(int(a));
+    g->create_data("B")->emit_value<int>(true);
+    GraphData* sum = g->get_data("SUM");
+    auto* closure_context = g->run(sum);
+    EXPECT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    int32_t result = sum->raw<int32_t>();
+    g->reset();
+    return result;
+}
+
+TEST_F(GraphTemplateTest, test_instances_share_meta) {
+    Graph prototype;
+    GraphVertex* source = prototype.add_vertex("SourceProcessor");
+    source->set_option<int32_t>(7);
+    source->emit("SOURCE");
+    prototype.add_vertex("ExtraProcessor")->emit("EXTRA");
+    GraphVertex* add = prototype.add_vertex("AddProcessor");
+    add->depend("SOURCE");
+    add->depend("INPUT");
+    add->optional_depend("EXTRA")->when("A && B");
+    add->emit("SUM");
+    prototype.build();
+
+    auto tpl = GraphTemplate::compile(prototype);
+    ASSERT_TRUE(tpl != nullptr);
+    // 表达式vertex也在模板里
+    ASSERT_EQ(tpl->vertex_size(), 4);
+    ASSERT_GE(tpl->data_idx("SUM"), 0);
+
+    std::unique_ptr<GraphInstance> g1(tpl->create_instance());
+    std::unique_ptr<GraphInstance> g2(tpl->create_instance());
+    ASSERT_EQ(g1->get_template(), tpl);
+
+    // 名字和option在实例之间共享同一份存储
+    GraphData* sum1 = g1->get_data("SUM");
+    GraphData* sum2 = g2->get_data("SUM");
+    ASSERT_NE(sum1, sum2);
+    ASSERT_EQ(&sum1->get_name(), &sum2->get_name());
+
+    ASSERT_EQ(run_sum(&prototype, 1, true), 1008);
+    ASSERT_EQ(run_sum(g1.get(), 2, true), 1009);
+    ASSERT_EQ(run_sum(g2.get(), 3, false), 10);
+    // 同一个实例跑多轮结果一致
+    ASSERT_EQ(run_sum(g1.get(), 2, true), 1009);
+}
+
+TEST_F(GraphTemplateTest, test_concurrent_instances) {
+    Graph prototype;
+    GraphVertex* source = prototype.add_vertex("SourceProcessor");
+    source->set_option<int32_t>(5);
+    source->emit("SOURCE");
+    GraphVertex* add = prototype.add_vertex("AddProcessor");
+    add->depend("SOURCE");
+    add->depend("INPUT");
+    add->emit("SUM");
+    prototype.build();
+    auto tpl = GraphTemplate::compile(prototype);
+    ASSERT_TRUE(tpl != nullptr);
+
+    constexpr int concurrent = 8;
+    std::vector<std::thread> threads;
+    std::atomic<int> failed{0};
+    for (int i = 0; i < concurrent; ++i) {
+        threads.emplace_back([&, i] {
+            std::unique_ptr<GraphInstance> g(tpl->create_instance());
+            for (int k = 0; k < 20; ++k) {
+                if (run_sum(g.get(), i * 100 + k, false) != i * 100 + k + 5) {
+                    failed++;
+                }
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    ASSERT_EQ(failed.load(), 0);
+}
+
+TEST_F(GraphTemplateTest, test_option_copy_on_write) {
+    Graph prototype;
+    GraphVertex* source = prototype.add_vertex("SourceProcessor");
+    source->set_option<int32_t>(5);
+    source->emit("SOURCE");
+    prototype.build();
+    auto tpl = GraphTemplate::compile(prototype);
+    std::unique_ptr<GraphInstance> g(tpl->create_instance());
+
+    // 修改实例上的option不影响模板和其他实例
+    g->get_data("SOURCE")->get_producer()->set_option<int32_t>(6);
+    ASSERT_EQ(source->get_option<int32_t>(), 5);
+    std::unique_ptr<GraphInstance> g2(tpl->create_instance());
+    ASSERT_EQ(g2->get_data("SOURCE")->get_producer()->get_option<int32_t>(), 5);
+}
+
+TEST_F(GraphTemplateTest, test_compile_unregistered_processor) {
+    Graph prototype;
+    auto processor = std::make_shared<ExtraProcessor>();
+    prototype.add_vertex(processor, "ExtraProcessor_custom")->emit("EXTRA");
+    prototype.build();
+    ASSERT_TRUE(GraphTemplate::compile(prototype) == nullptr);
+}
+
+} // namespace
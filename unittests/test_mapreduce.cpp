@@ -99,4 +99,34 @@ TEST_F(MapReduceTest, test_no_reduce) {
         }
         return result;
     }).run();
-}
\ No newline at end of file
+}
+
+TEST_F(MapReduceTest, test_work_stealing_backend) {
+    Channel<Item*> queue; 
+    std::vector<Item*> items(100);
+    for (int i = 0; i < items.size(); ++i) {
+        items[i] = new Item;
+        items[i]->id = i+1;
+    }
+    queue.push_n(items.begin(), items.end());
+    queue.close();
+
+    using MR = MapReducer<Item*, Forward*, Channel>;
+    using InputBatchPtr = MR::InputBatchPtr;
+    using OutputBatchPtr = MR::OutputBatchPtr;
+    MR mr;
+    int forward_num = 0;
+    mr.input(queue).batch_size(10).backend(ThreadPoolBackend::WORK_STEALING)
+      .parallel_map([&](InputBatchPtr batch) -> OutputBatchPtr {
+        OutputBatchPtr result = mr.make_output_batch();
+        for (auto item : *batch) {
+            auto* fwd = new Forward;
+            fwd->title = "title_" + std::to_string(item->id);
+            result->push_back(fwd);
+        }
+        return result;
+    }).reduce([&](MR::OutputBatchPtr batch) {
+        forward_num += batch->size();
+    }).run();
+    ASSERT_EQ(forward_num, 100);
+}
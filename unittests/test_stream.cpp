@@ -0,0 +1,137 @@
+#include <gtest/gtest.h>
+#include "gflags/gflags.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <any>
+
+#define DCHECK_IS_ON 1
+
+#include "data.h"
+#include "dependency.h"
+#include "vertex.h"
+#include "graph.h"
+#include "graph_executor.h"
+#include "stream_processor.h"
+
+namespace stream {
+
+using namespace gflow;
+
+class StreamTest : public ::testing::Test {
+   private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+
+   protected:
+};
+
+// 产出1..N，N由option指定
+class NumberSource : public StreamSource<int> {
+   public:
+    size_t stream_capacity() override { return 8; }
+    int setup() override {
+        _num = vertex().get_option<int>();
+        return 0;
+    }
+    bool next(int& item) override {
+        if (_count >= _num) {
+            _count = 0;
+            return false;
+        }
+        item = ++_count;
+        return true;
+    }
+
+   private:
+    int _num = 0;
+    int _count = 0;
+};
+REGISTER_PROCESSOR(NumberSource);
+
+class DoubleStage : public StreamStage<int, int> {
+   public:
+    size_t stream_capacity() override { return 4; }
+    int process_item(int& item) override {
+        emit(item * 2);
+        return 0;
+    }
+};
+REGISTER_PROCESSOR(DoubleStage);
+
+// 第100个元素出错
+class FailedStage : public StreamStage<int, int> {
+   public:
+    int process_item(int& item) override {
+        if (item == 100) {
+            return 7;
+        }
+        emit(item);
+        return 0;
+    }
+};
+REGISTER_PROCESSOR(FailedStage);
+
+class SumSink : public StreamStage<int, void> {
+   public:
+    int process_item(int& item) override {
+        _sum += item;
+        return 0;
+    }
+    int finish_stream() override {
+        GraphData* data = get_data("STREAM_SUM");
+        data->make<int64_t>()->raw<int64_t>() = _sum;
+        _sum = 0;
+        data->release();
+        return 0;
+    }
+
+   private:
+    int64_t _sum = 0;
+};
+REGISTER_PROCESSOR(SumSink);
+
+Graph* create_pipeline(const std::string& stage_name, int num) {
+    Graph* g = new Graph;
+    GraphVertex* source = g->add_vertex("NumberSource");
+    source->set_option<int>(std::move(num));
+    source->emit("NUMS_STREAM");
+    GraphVertex* stage = g->add_vertex(stage_name);
+    stage->depend("NUMS_STREAM");
+    stage->emit("STAGE_STREAM");
+    GraphVertex* sink = g->add_vertex("SumSink");
+    sink->depend("STAGE_STREAM");
+    sink->emit("STREAM_SUM");
+    g->build();
+    return g;
+}
+
+TEST_F(StreamTest, test_pipeline) {
+    constexpr int num = 10000;
+    std::unique_ptr<Graph> g(create_pipeline("DoubleStage", num));
+    for (int round = 0; round < 5; ++round) {
+        if (round == 3) {
+            g->set_executor(AsyncGraphExecutor::instance(concurrent::ThreadPoolBackend::WORK_STEALING));
+        }
+        GraphData* sum = g->get_data("STREAM_SUM");
+        auto* closure_context = g->run(sum);
+        ASSERT_EQ(closure_context->wait_finish(), 0);
+        delete closure_context;
+        ASSERT_EQ(sum->raw<int64_t>(), (int64_t)num * (num + 1));
+        g->reset();
+    }
+}
+
+TEST_F(StreamTest, test_pipeline_error) {
+    // 中间stage出错，上游放弃继续产出，图以stage的错误码结束
+    std::unique_ptr<Graph> g(create_pipeline("FailedStage", 1000000));
+    auto* closure_context = g->run(g->get_data("STREAM_SUM"));
+    ASSERT_EQ(closure_context->wait_finish(), 7);
+    delete closure_context;
+}
+
+}  // namespace stream
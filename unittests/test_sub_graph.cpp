@@ -0,0 +1,180 @@
+#include <gtest/gtest.h>
+#include "gflags/gflags.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <any>
+
+#define DCHECK_IS_ON 1
+
+#include "data.h"
+#include "dependency.h"
+#include "vertex.h"
+#include "graph.h"
+#include "graph_template.h"
+#include "graph_executor.h"
+#include "sub_graph_processor.h"
+
+namespace sub_graph {
+
+using namespace gflow;
+
+class SubGraphTest : public ::testing::Test {
+   private:
+    virtual void SetUp() {
+    }
+    virtual void TearDown() {
+    }
+
+   protected:
+};
+
+// 子图收到的输入对象地址，用来检查没有拷贝
+std::atomic<const void*> g_sub_input{nullptr};
+
+class SubScaleProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        g_sub_input = input;
+        output->clear();
+        for (int v : *input) {
+            output->emplace_back(v * 2);
+        }
+        return 0;
+    }
+    GRAPH_DECLARE(
+        DEPEND(std::vector<int>, SUB_IN, input)
+        EMIT(std::vector<int>, SUB_OUT, output)
+    );
+};
+REGISTER_PROCESSOR(SubScaleProcessor);
+
+class SubSumProcessor : public GraphFunction {
+   public:
+    int setup(std::any&) {
+        return 0;
+    }
+    int operator()() {
+        *total = 0;
+        for (int v : *input) {
+            *total += v;
+        }
+        return 0;
+    }
+    GRAPH_DECLARE(
+        DEPEND(std::vector<int>, SCALED, input)
+        EMIT(int64_t, TOTAL, total)
+    );
+};
+REGISTER_PROCESSOR(SubSumProcessor);
+
+class SubFailedProcessor : public GraphProcessor {
+   public:
+    int process() {
+        return 5;
+    }
+};
+REGISTER_PROCESSOR(SubFailedProcessor);
+
+std::shared_ptr<GraphTemplate> compile_scale_graph() {
+    Graph prototype;
+    GraphVertex* v = prototype.add_vertex("SubScaleProcessor");
+    v->depend("SUB_IN");
+    v->emit("SUB_OUT");
+    prototype.build();
+    return GraphTemplate::compile(prototype);
+}
+
+void build_outer_graph(Graph* g, std::shared_ptr<const GraphTemplate> sub_template) {
+    SubGraphOption option;
+    option.graph_template = std::move(sub_template);
+    option.inputs = {{"NUMS", "SUB_IN"}};
+    option.outputs = {{"SCALED", "SUB_OUT"}};
+    ASSERT_TRUE(SubGraphProcessor::add_to(*g, std::move(option)) != nullptr);
+    GraphVertex* sum = g->add_vertex("SubSumProcessor");
+    sum->depend("SCALED");
+    sum->emit("TOTAL");
+    g->build();
+}
+
+int64_t run_total(Graph* g, std::vector<int> nums) {
+    g->get_data("NUMS")->emit_value<std::vector<int>>(std::move(nums));
+    g->get_data("NUMS")->release();
+    GraphData* total = g->get_data("TOTAL");
+    auto* closure_context = g->run(total);
+    EXPECT_EQ(closure_context->wait_finish(), 0);
+    delete closure_context;
+    EXPECT_EQ(g_sub_input.load(), g->get_data("NUMS")->pointer<std::vector<int>>());
+    int64_t result = total->raw<int64_t>();
+    g->reset();
+    return result;
+}
+
+TEST_F(SubGraphTest, test_sub_graph) {
+    auto sub_template = compile_scale_graph();
+    ASSERT_TRUE(sub_template != nullptr);
+    Graph g;
+    build_outer_graph(&g, sub_template);
+    // 子图实例可以reset之后复用
+    for (int i = 0; i < 10; ++i) {
+        ASSERT_EQ(run_total(&g, {1, 2, 3, i}), (6 + i) * 2);
+    }
+    // 子图跟随外层图的executor
+    g.set_executor(AsyncGraphExecutor::instance(concurrent::ThreadPoolBackend::WORK_STEALING));
+    g.set_inline_continuation(true);
+    ASSERT_EQ(run_total(&g, {10, 20}), 60);
+}
+
+TEST_F(SubGraphTest, test_sub_graph_in_template) {
+    // 子图vertex本身也可以编译进模板，每个实例有自己的子图实例
+    Graph prototype;
+    build_outer_graph(&prototype, compile_scale_graph());
+    auto tpl = GraphTemplate::compile(prototype);
+    ASSERT_TRUE(tpl != nullptr);
+    std::vector<std::thread> threads;
+    std::atomic<int> failed{0};
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&tpl, &failed, t] {
+            std::unique_ptr<GraphInstance> g(tpl->create_instance());
+            for (int i = 0; i < 20; ++i) {
+                g->get_data("NUMS")->emit_value<std::vector<int>>(std::vector<int>{t, i});
+                g->get_data("NUMS")->release();
+                auto* closure_context = g->run(g->get_data("TOTAL"));
+                if (closure_context->wait_finish() != 0
+                        || g->get_data("TOTAL")->raw<int64_t>() != (t + i) * 2) {
+                    failed++;
+                }
+                delete closure_context;
+                g->reset();
+            }
+        });
+    }
+    for (auto& th : threads) {
+        th.join();
+    }
+    ASSERT_EQ(failed.load(), 0);
+}
+
+TEST_F(SubGraphTest, test_sub_graph_error) {
+    Graph prototype;
+    GraphVertex* v = prototype.add_vertex("SubFailedProcessor");
+    v->depend("SUB_IN");
+    v->emit("SUB_OUT");
+    prototype.build();
+
+    Graph g;
+    build_outer_graph(&g, GraphTemplate::compile(prototype));
+    g.get_data("NUMS")->emit_value<std::vector<int>>(std::vector<int>{1});
+    g.get_data("NUMS")->release();
+    auto* closure_context = g.run(g.get_data("TOTAL"));
+    // 子图的错误码传给外层图
+    ASSERT_EQ(closure_context->wait_finish(), 5);
+    delete closure_context;
+}
+
+}  // namespace sub_graph